@@ -0,0 +1,386 @@
+#include "../../src/Utils/Loaders/AssetPackFormat.h"
+#include "../../src/Utils/Loaders/CompressedImageLoader.h"
+
+#include <stb_image.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//Offline asset cooker - converts source images into a single pack file of GPU-ready blobs (see src/Utils/Loaders/AssetPackFormat.h) that AssetPackReader maps at runtime
+//Usage: AssetCooker [--rgba8] [--root <directory>] -o <output pack> <source images...>
+//Decodable images (PNG, JPEG, ...) are flipped to match ImageLoader, given a full mip chain, and compressed to BC3 (or left as RGBA8 with --rgba8)
+//KTX2 and DDS files are already GPU-ready and are packed as-is
+//Entries are named by their path relative to --root (or the working directory) with forward slashes - e.g.: "garfield.png"
+namespace
+{
+	struct SourceImage
+	{
+		std::string name;
+		std::filesystem::path path;
+		bool isPrebuilt; //KTX2/DDS
+		VkFormat format;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::vector<std::uint64_t> levelSizes;
+	};
+
+
+
+	std::uint64_t AlignUp(std::uint64_t _value, std::uint64_t _alignment)
+	{
+		return ((_value + _alignment - 1) / _alignment) * _alignment;
+	}
+
+
+
+	std::uint64_t GetLevelSize(VkFormat _format, std::uint32_t _width, std::uint32_t _height)
+	{
+		if (_format == VK_FORMAT_BC3_SRGB_BLOCK) { return static_cast<std::uint64_t>((_width + 3) / 4) * ((_height + 3) / 4) * 16; }
+		return static_cast<std::uint64_t>(_width) * _height * 4;
+	}
+
+
+
+	//----MIP GENERATION----//
+
+	float SRGBToLinear(unsigned char _value)
+	{
+		const float c{ _value / 255.0f };
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+
+
+	unsigned char LinearToSRGB(float _value)
+	{
+		const float c{ _value <= 0.0031308f ? _value * 12.92f : 1.055f * std::pow(_value, 1.0f / 2.4f) - 0.055f };
+		return static_cast<unsigned char>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+
+
+	//2x2 box filter in linear space (alpha is already linear) - odd edges reuse the last row/column
+	std::vector<unsigned char> Downsample(const std::vector<unsigned char>& _src, std::uint32_t _srcWidth, std::uint32_t _srcHeight, std::uint32_t _dstWidth, std::uint32_t _dstHeight)
+	{
+		static float srgbToLinear[256];
+		static bool tableBuilt{ false };
+		if (!tableBuilt)
+		{
+			for (std::uint32_t i{ 0 }; i<256; ++i) { srgbToLinear[i] = SRGBToLinear(static_cast<unsigned char>(i)); }
+			tableBuilt = true;
+		}
+
+		std::vector<unsigned char> dst(static_cast<std::size_t>(_dstWidth) * _dstHeight * 4);
+		for (std::uint32_t y{ 0 }; y<_dstHeight; ++y)
+		{
+			for (std::uint32_t x{ 0 }; x<_dstWidth; ++x)
+			{
+				const std::uint32_t x0{ std::min(x * 2, _srcWidth - 1) }, x1{ std::min(x * 2 + 1, _srcWidth - 1) };
+				const std::uint32_t y0{ std::min(y * 2, _srcHeight - 1) }, y1{ std::min(y * 2 + 1, _srcHeight - 1) };
+				const unsigned char* texels[4]{ &_src[(static_cast<std::size_t>(y0) * _srcWidth + x0) * 4], &_src[(static_cast<std::size_t>(y0) * _srcWidth + x1) * 4],
+												&_src[(static_cast<std::size_t>(y1) * _srcWidth + x0) * 4], &_src[(static_cast<std::size_t>(y1) * _srcWidth + x1) * 4] };
+				unsigned char* out{ &dst[(static_cast<std::size_t>(y) * _dstWidth + x) * 4] };
+				for (std::uint32_t c{ 0 }; c<3; ++c)
+				{
+					out[c] = LinearToSRGB((srgbToLinear[texels[0][c]] + srgbToLinear[texels[1][c]] + srgbToLinear[texels[2][c]] + srgbToLinear[texels[3][c]]) * 0.25f);
+				}
+				out[3] = static_cast<unsigned char>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			}
+		}
+		return dst;
+	}
+
+	//--------//
+
+
+
+	//----BC3 ENCODING----//
+
+	std::uint16_t PackRGB565(const unsigned char* _rgb)
+	{
+		return static_cast<std::uint16_t>(((_rgb[0] >> 3) << 11) | ((_rgb[1] >> 2) << 5) | (_rgb[2] >> 3));
+	}
+
+
+
+	void UnpackRGB565(std::uint16_t _colour, int* _out_rgb)
+	{
+		_out_rgb[0] = ((_colour >> 11) & 31) * 255 / 31;
+		_out_rgb[1] = ((_colour >> 5) & 63) * 255 / 63;
+		_out_rgb[2] = (_colour & 31) * 255 / 31;
+	}
+
+
+
+	//Fast bounding-box fit - endpoints are the per-channel min/max inset by 1/16 of the range, each texel takes the nearest palette entry
+	void EncodeBC3Block(const unsigned char _texels[16][4], unsigned char* _out_block)
+	{
+		//Alpha (8 interpolated levels between max and min)
+		unsigned char alphaMax{ 0 }, alphaMin{ 255 };
+		for (std::uint32_t i{ 0 }; i<16; ++i)
+		{
+			alphaMax = std::max(alphaMax, _texels[i][3]);
+			alphaMin = std::min(alphaMin, _texels[i][3]);
+		}
+		int alphaPalette[8]{ alphaMax, alphaMin };
+		for (int i{ 1 }; i<7; ++i) { alphaPalette[i + 1] = ((7 - i) * alphaMax + i * alphaMin) / 7; }
+		std::uint64_t alphaIndices{ 0 };
+		for (std::uint32_t i{ 0 }; i<16 && alphaMax != alphaMin; ++i)
+		{
+			std::uint64_t best{ 0 };
+			for (std::uint32_t p{ 1 }; p<8; ++p)
+			{
+				if (std::abs(alphaPalette[p] - _texels[i][3]) < std::abs(alphaPalette[best] - _texels[i][3])) { best = p; }
+			}
+			alphaIndices |= best << (3 * i);
+		}
+		_out_block[0] = alphaMax;
+		_out_block[1] = alphaMin;
+		for (std::uint32_t i{ 0 }; i<6; ++i) { _out_block[2 + i] = static_cast<unsigned char>(alphaIndices >> (8 * i)); }
+
+		//Colour (4-colour BC1 block - requires colour0 > colour1)
+		unsigned char minColour[3]{ 255, 255, 255 }, maxColour[3]{ 0, 0, 0 };
+		for (std::uint32_t i{ 0 }; i<16; ++i)
+		{
+			for (std::uint32_t c{ 0 }; c<3; ++c)
+			{
+				minColour[c] = std::min(minColour[c], _texels[i][c]);
+				maxColour[c] = std::max(maxColour[c], _texels[i][c]);
+			}
+		}
+		for (std::uint32_t c{ 0 }; c<3; ++c)
+		{
+			const int inset{ (maxColour[c] - minColour[c]) / 16 };
+			minColour[c] = static_cast<unsigned char>(minColour[c] + inset);
+			maxColour[c] = static_cast<unsigned char>(maxColour[c] - inset);
+		}
+		std::uint16_t colour0{ PackRGB565(maxColour) }, colour1{ PackRGB565(minColour) };
+		if (colour0 < colour1) { std::swap(colour0, colour1); }
+		std::uint32_t colourIndices{ 0 };
+		if (colour0 != colour1)
+		{
+			int palette[4][3];
+			UnpackRGB565(colour0, palette[0]);
+			UnpackRGB565(colour1, palette[1]);
+			for (std::uint32_t c{ 0 }; c<3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (std::uint32_t i{ 0 }; i<16; ++i)
+			{
+				std::uint32_t best{ 0 };
+				int bestDistance{ INT32_MAX };
+				for (std::uint32_t p{ 0 }; p<4; ++p)
+				{
+					const int dr{ palette[p][0] - _texels[i][0] }, dg{ palette[p][1] - _texels[i][1] }, db{ palette[p][2] - _texels[i][2] };
+					const int distance{ dr * dr + dg * dg + db * db };
+					if (distance < bestDistance) { best = p; bestDistance = distance; }
+				}
+				colourIndices |= best << (2 * i);
+			}
+		}
+		memcpy(_out_block + 8, &colour0, 2);
+		memcpy(_out_block + 10, &colour1, 2);
+		memcpy(_out_block + 12, &colourIndices, 4);
+	}
+
+
+
+	std::vector<unsigned char> EncodeBC3(const std::vector<unsigned char>& _rgba, std::uint32_t _width, std::uint32_t _height)
+	{
+		const std::uint32_t blocksX{ (_width + 3) / 4 }, blocksY{ (_height + 3) / 4 };
+		std::vector<unsigned char> blocks(static_cast<std::size_t>(blocksX) * blocksY * 16);
+		for (std::uint32_t by{ 0 }; by<blocksY; ++by)
+		{
+			for (std::uint32_t bx{ 0 }; bx<blocksX; ++bx)
+			{
+				//Blocks hanging off the edge repeat the last row/column
+				unsigned char texels[16][4];
+				for (std::uint32_t i{ 0 }; i<16; ++i)
+				{
+					const std::uint32_t x{ std::min(bx * 4 + i % 4, _width - 1) }, y{ std::min(by * 4 + i / 4, _height - 1) };
+					memcpy(texels[i], &_rgba[(static_cast<std::size_t>(y) * _width + x) * 4], 4);
+				}
+				EncodeBC3Block(texels, &blocks[(static_cast<std::size_t>(by) * blocksX + bx) * 16]);
+			}
+		}
+		return blocks;
+	}
+
+	//--------//
+
+
+
+	//Read the source's header to find the size of every level it will be cooked to
+	SourceImage InspectSource(const std::filesystem::path& _path, const std::filesystem::path& _root, bool _compress)
+	{
+		SourceImage source{};
+		source.path = _path;
+		source.name = std::filesystem::relative(_path, _root).generic_string();
+		source.isPrebuilt = CompressedImageLoader::IsCompressedImageFile(_path.string());
+		if (source.isPrebuilt)
+		{
+			CompressedImageFile file{ CompressedImageLoader::Open(_path.string()) };
+			source.format = file.format;
+			source.width = file.width;
+			source.height = file.height;
+			for (const CompressedImageLevel& level : file.levels) { source.levelSizes.push_back(level.size); }
+			CompressedImageLoader::Close(file);
+			return source;
+		}
+
+		int width, height, channels;
+		if (!stbi_info(_path.string().c_str(), &width, &height, &channels)) { throw std::runtime_error("Failed to read image header: " + _path.string() + " (" + stbi_failure_reason() + ")"); }
+		source.format = _compress ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+		source.width = static_cast<std::uint32_t>(width);
+		source.height = static_cast<std::uint32_t>(height);
+		const std::uint32_t levelCount{ static_cast<std::uint32_t>(std::bit_width(std::max(source.width, source.height))) };
+		for (std::uint32_t level{ 0 }; level<levelCount; ++level)
+		{
+			source.levelSizes.push_back(GetLevelSize(source.format, std::max(source.width >> level, 1u), std::max(source.height >> level, 1u)));
+		}
+		return source;
+	}
+
+
+
+	//Produce the GPU-ready blob of every level of _source, in order
+	std::vector<std::vector<unsigned char>> CookSource(const SourceImage& _source)
+	{
+		std::vector<std::vector<unsigned char>> blobs;
+		if (_source.isPrebuilt)
+		{
+			CompressedImageFile file{ CompressedImageLoader::Open(_source.path.string()) };
+			for (const CompressedImageLevel& level : file.levels) { blobs.emplace_back(file.mappedFile.data + level.offset, file.mappedFile.data + level.offset + level.size); }
+			CompressedImageLoader::Close(file);
+			return blobs;
+		}
+
+		//Flipped to match ImageLoader so that cooked and uncooked textures are sampled the same way up
+		stbi_set_flip_vertically_on_load(true);
+		int width, height, channels;
+		stbi_uc* pixels{ stbi_load(_source.path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha) };
+		if (!pixels) { throw std::runtime_error("Failed to load image: " + _source.path.string() + " (" + stbi_failure_reason() + ")"); }
+		std::vector<unsigned char> level(pixels, pixels + static_cast<std::size_t>(width) * height * 4);
+		stbi_image_free(pixels);
+
+		std::uint32_t levelWidth{ _source.width }, levelHeight{ _source.height };
+		for (std::size_t i{ 0 }; i<_source.levelSizes.size(); ++i)
+		{
+			if (i != 0)
+			{
+				const std::uint32_t nextWidth{ std::max(levelWidth / 2, 1u) }, nextHeight{ std::max(levelHeight / 2, 1u) };
+				level = Downsample(level, levelWidth, levelHeight, nextWidth, nextHeight);
+				levelWidth = nextWidth;
+				levelHeight = nextHeight;
+			}
+			blobs.push_back(_source.format == VK_FORMAT_BC3_SRGB_BLOCK ? EncodeBC3(level, levelWidth, levelHeight) : level);
+		}
+		return blobs;
+	}
+}
+
+
+
+int main(int _argc, char** _argv)
+{
+	bool compress{ true };
+	std::filesystem::path root{ std::filesystem::current_path() };
+	std::filesystem::path outputPath;
+	std::vector<std::filesystem::path> inputPaths;
+	for (int i{ 1 }; i<_argc; ++i)
+	{
+		const std::string argument{ _argv[i] };
+		if (argument == "--rgba8") { compress = false; }
+		else if (argument == "--root" && i + 1 < _argc) { root = _argv[++i]; }
+		else if (argument == "-o" && i + 1 < _argc) { outputPath = _argv[++i]; }
+		else { inputPaths.emplace_back(argument); }
+	}
+	if (outputPath.empty() || inputPaths.empty())
+	{
+		std::cerr << "Usage: AssetCooker [--rgba8] [--root <directory>] -o <output pack> <source images...>\n";
+		return 1;
+	}
+
+	try
+	{
+		//Every level's size is known from the headers alone, so the whole layout is fixed before anything is decoded and blobs can be streamed out one image at a time
+		std::vector<SourceImage> sources;
+		for (const std::filesystem::path& path : inputPaths) { sources.push_back(InspectSource(path, root, compress)); }
+		std::sort(sources.begin(), sources.end(), [](const SourceImage& _a, const SourceImage& _b){ return _a.name < _b.name; });
+		for (std::size_t i{ 1 }; i<sources.size(); ++i)
+		{
+			if (sources[i].name == sources[i - 1].name) { throw std::runtime_error("Duplicate entry name: " + sources[i].name); }
+		}
+
+		AssetPackHeader header{};
+		header.magic = ASSET_PACK_MAGIC;
+		header.version = ASSET_PACK_VERSION;
+		header.entryCount = static_cast<std::uint32_t>(sources.size());
+		std::vector<AssetPackEntry> entries(sources.size());
+		std::vector<AssetPackLevel> levels;
+		std::string names;
+		for (std::size_t i{ 0 }; i<sources.size(); ++i)
+		{
+			entries[i].nameOffset = static_cast<std::uint32_t>(names.size());
+			entries[i].nameLength = static_cast<std::uint32_t>(sources[i].name.size());
+			entries[i].format = static_cast<std::uint32_t>(sources[i].format);
+			entries[i].width = sources[i].width;
+			entries[i].height = sources[i].height;
+			entries[i].firstLevel = static_cast<std::uint32_t>(levels.size());
+			entries[i].levelCount = static_cast<std::uint32_t>(sources[i].levelSizes.size());
+			names += sources[i].name;
+			for (const std::uint64_t size : sources[i].levelSizes) { levels.push_back({ 0, size }); }
+		}
+		header.levelCount = static_cast<std::uint32_t>(levels.size());
+		header.namesOffset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry) + levels.size() * sizeof(AssetPackLevel);
+		header.namesSize = names.size();
+		std::uint64_t offset{ header.namesOffset + header.namesSize };
+		for (AssetPackLevel& level : levels)
+		{
+			level.offset = AlignUp(offset, ASSET_PACK_BLOB_ALIGNMENT);
+			offset = level.offset + level.size;
+		}
+
+		std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+		if (!output) { throw std::runtime_error("Failed to open " + outputPath.string() + " for writing"); }
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(AssetPackEntry)));
+		output.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(AssetPackLevel)));
+		output.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+		std::uint64_t written{ header.namesOffset + header.namesSize };
+		std::uint64_t totalSourceBytes{ 0 };
+		for (std::size_t i{ 0 }; i<sources.size(); ++i)
+		{
+			const std::vector<std::vector<unsigned char>> blobs{ CookSource(sources[i]) };
+			for (std::size_t j{ 0 }; j<blobs.size(); ++j)
+			{
+				const AssetPackLevel& level{ levels[entries[i].firstLevel + j] };
+				if (blobs[j].size() != level.size) { throw std::runtime_error("Cooked level " + std::to_string(j) + " of " + sources[i].name + " doesn't match the size from its header"); }
+				const std::vector<char> padding(level.offset - written, 0);
+				output.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+				output.write(reinterpret_cast<const char*>(blobs[j].data()), static_cast<std::streamsize>(blobs[j].size()));
+				written = level.offset + level.size;
+			}
+			totalSourceBytes += std::filesystem::file_size(sources[i].path);
+			std::cout << "Cooked " << sources[i].name << " (" << sources[i].width << "x" << sources[i].height << ", format " << sources[i].format << ", " << blobs.size() << " level" << (blobs.size() == 1 ? "" : "s") << ")\n";
+		}
+		if (!output) { throw std::runtime_error("Failed to write " + outputPath.string()); }
+		std::cout << "Wrote " << sources.size() << " entr" << (sources.size() == 1 ? "y" : "ies") << " (" << written << " bytes from " << totalSourceBytes << " bytes of sources) to " << outputPath.string() << "\n";
+	}
+	catch (const std::exception& _exception)
+	{
+		std::cerr << _exception.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
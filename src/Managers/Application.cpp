@@ -9,6 +9,7 @@ namespace Neki
 
 
 Application::Application(const VKAppCreationDescription& _vkAppCreationDescription)
+						: framePacer(_vkAppCreationDescription.targetFrameRate, _vkAppCreationDescription.reduceLatency)
 {
 	vkApp = std::make_unique<VKApp>(_vkAppCreationDescription);
 	camera = std::make_unique<PlayerCamera>(30.0f, 0.05f, *(vkApp->vulkanSwapchain), glm::vec3(0,0,3), glm::vec3(0,1,0), 0.0f, 0.0f, 0.1f, 100.0f, 90.0f);
@@ -32,11 +33,20 @@ void Application::Start()
 
 void Application::RunFrame()
 {
+	//Nothing can be drawn while minimised - sleep until an event restores (or closes) the window rather than spinning through frames that StartFrame() skips
+	while (vkApp->vulkanSwapchain->IsMinimised() && !vkApp->vulkanSwapchain->WindowShouldClose())
+	{
+		glfwWaitEvents();
+	}
+
+	//Wait before polling input so the input is as fresh as possible by the time the frame is presented
+	framePacer.WaitForNextFrame();
 	glfwPollEvents();
 	TimeManager::NewFrame();
 	InputManager::UpdateInput(vkApp->vulkanSwapchain->GetWindow());
 	camera->Update();
 	vkApp->DrawFrame(*camera);
+	framePacer.ReportBlockTime(vkApp->vulkanRenderManager->GetLastFrameBlockTime());
 }
 
 
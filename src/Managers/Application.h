@@ -2,6 +2,7 @@
 #define APPLICATION_H
 #include "../Camera/PlayerCamera.h"
 #include "../Vulkan/VKApp.h"
+#include "FramePacer.h"
 
 
 namespace Neki
@@ -23,6 +24,7 @@ private:
 	
 	std::unique_ptr<VKApp> vkApp;
 	std::unique_ptr<PlayerCamera> camera;
+	FramePacer framePacer;
 };
 
 
@@ -0,0 +1,102 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+
+namespace Neki
+{
+
+
+
+FramePacer::FramePacer(double _targetFrameRate, bool _reduceLatency)
+					  : reduceLatency(_reduceLatency), latencyDelay(0.0), sleepOvershoot(0.001), frameTime(0.0), firstFrame(true)
+{
+	SetTargetFrameRate(_targetFrameRate);
+}
+
+
+
+void FramePacer::WaitForNextFrame()
+{
+	const Clock::time_point now{ Clock::now() };
+	if (firstFrame)
+	{
+		lastFrameStart = now;
+		firstFrame = false;
+		return;
+	}
+
+	//Frames that take longer than the target start straight away rather than trying to catch up
+	const double elapsed{ std::chrono::duration<double>(now - lastFrameStart).count() };
+	const double wait{ std::max(targetFrameTime - elapsed, 0.0) + latencyDelay };
+	if (wait > 0.0)
+	{
+		WaitUntil(now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(wait)));
+	}
+
+	const Clock::time_point frameStart{ Clock::now() };
+	const double measuredFrameTime{ std::chrono::duration<double>(frameStart - lastFrameStart).count() };
+
+	//A frame that took much longer than usual has most likely missed a refresh by waiting too long - back off rather than keep pushing past it
+	if (frameTime > 0.0 && measuredFrameTime > 1.5 * frameTime) { latencyDelay *= 0.5; }
+	frameTime = (frameTime == 0.0) ? measuredFrameTime : frameTime + 0.1 * (measuredFrameTime - frameTime);
+	lastFrameStart = frameStart;
+}
+
+
+
+void FramePacer::ReportBlockTime(double _seconds)
+{
+	if (!reduceLatency) { return; }
+
+	//Steer the delay so frames still block for a small margin - blocking for none at all risks the GPU going idle and missing a refresh
+	//A quarter of the error is corrected each frame so a single spike doesn't throw the delay off
+	//Never wait more than a whole frame on top of the limit, in case something blocks for reasons waiting can't absorb
+	constexpr double margin{ 0.001 };
+	latencyDelay = std::clamp(latencyDelay + 0.25 * (_seconds - margin), 0.0, frameTime);
+}
+
+
+
+void FramePacer::SetTargetFrameRate(double _targetFrameRate)
+{
+	targetFrameTime = (_targetFrameRate > 0.0) ? 1.0 / _targetFrameRate : 0.0;
+}
+
+
+
+double FramePacer::GetFrameTime() const
+{
+	return frameTime;
+}
+
+
+
+double FramePacer::GetLatencyDelay() const
+{
+	return latencyDelay;
+}
+
+
+
+void FramePacer::WaitUntil(Clock::time_point _deadline)
+{
+	//Sleeps routinely overshoot by around a scheduler tick, so stop sleeping early enough to cover a typical overshoot
+	const Clock::time_point sleepDeadline{ _deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sleepOvershoot * 1.5)) };
+	if (sleepDeadline > Clock::now())
+	{
+		std::this_thread::sleep_until(sleepDeadline);
+		const double overshoot{ std::chrono::duration<double>(Clock::now() - sleepDeadline).count() };
+		sleepOvershoot += 0.1 * (std::max(overshoot, 0.0) - sleepOvershoot);
+	}
+
+	while (Clock::now() < _deadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+
+
+}
\ No newline at end of file
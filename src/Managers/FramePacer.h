@@ -0,0 +1,54 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <chrono>
+
+
+namespace Neki
+{
+
+
+
+//Responsible for limiting the frame rate on the CPU and, optionally, for reducing latency by starting each frame as late as it can afford to
+//A frame that blocks on the GPU/swapchain after polling input shows that input later than it needs to - with latency reduction on, the pacer learns how long frames block and moves that wait to before input is polled
+class FramePacer
+{
+public:
+	//_targetFrameRate of 0 leaves the frame rate unlimited
+	explicit FramePacer(double _targetFrameRate=0.0, bool _reduceLatency=false);
+
+	//Call at the very start of each frame, before polling input
+	//Blocks until the frame rate limit allows the next frame to start, plus however long frames have been measured to block later on
+	void WaitForNextFrame();
+
+	//Report how long the current frame spent blocked on the GPU/swapchain (i.e.: VulkanRenderManager::GetLastFrameBlockTime())
+	void ReportBlockTime(double _seconds);
+
+	void SetTargetFrameRate(double _targetFrameRate);
+	[[nodiscard]] double GetFrameTime() const; //Smoothed measured seconds between frame starts
+	[[nodiscard]] double GetLatencyDelay() const; //Seconds currently waited before input is polled on top of the frame rate limit
+
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	//Sleep for most of the wait and spin for the rest, learning from how late past sleeps woke up how much needs spinning
+	void WaitUntil(Clock::time_point _deadline);
+
+	double targetFrameTime; //0 if unlimited
+	bool reduceLatency;
+	double latencyDelay;
+	double sleepOvershoot; //Smoothed seconds a sleep wakes up after it was asked to
+	double frameTime;
+
+	Clock::time_point lastFrameStart;
+	bool firstFrame;
+};
+
+
+
+}
+
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef ASSETPACKFORMAT_H
+#define ASSETPACKFORMAT_H
+
+#include <cstdint>
+
+//On-disk layout of a pack file written by the asset cooker (Tools/AssetCooker) and read by AssetPackReader
+//[AssetPackHeader][AssetPackEntry * entryCount][AssetPackLevel * levelCount][names][padding][blobs]
+//Every field is little-endian and every structure is naturally aligned when the file is mapped
+//Entries are sorted by name so they can be binary searched in place, and every blob (one per mip level) starts on an ASSET_PACK_BLOB_ALIGNMENT boundary so it can be copied to staging memory as-is
+constexpr std::uint32_t ASSET_PACK_MAGIC{ 0x4B504B4E }; //"NKPK"
+constexpr std::uint32_t ASSET_PACK_VERSION{ 1 };
+constexpr std::uint64_t ASSET_PACK_BLOB_ALIGNMENT{ 16 };
+
+struct AssetPackHeader
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t entryCount;
+	std::uint32_t levelCount; //Total across all entries
+	std::uint64_t namesOffset;
+	std::uint64_t namesSize;
+};
+
+//A cooked image - its levels are levels[firstLevel] to levels[firstLevel + levelCount - 1], largest first
+struct AssetPackEntry
+{
+	std::uint32_t nameOffset; //Relative to AssetPackHeader::namesOffset - names aren't null-terminated
+	std::uint32_t nameLength;
+	std::uint32_t format; //VkFormat
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t firstLevel;
+	std::uint32_t levelCount;
+	std::uint32_t reserved;
+};
+
+//A tightly packed mip level blob
+struct AssetPackLevel
+{
+	std::uint64_t offset; //Relative to the start of the file
+	std::uint64_t size;
+};
+
+static_assert(sizeof(AssetPackHeader) == 32 && sizeof(AssetPackEntry) == 32 && sizeof(AssetPackLevel) == 16, "Asset pack structures must match the on-disk layout");
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "AssetPackReader.h"
+#include <stdexcept>
+#include <algorithm>
+
+AssetPack AssetPackReader::Open(const std::string& filepath)
+{
+	AssetPack pack{};
+	pack.mappedFile = FileMapper::Map(filepath);
+	const std::size_t fileSize{ pack.mappedFile.size };
+	try
+	{
+		if (fileSize < sizeof(AssetPackHeader)) { throw std::runtime_error("Truncated asset pack header: " + filepath); }
+		pack.header = reinterpret_cast<const AssetPackHeader*>(pack.mappedFile.data);
+		if (pack.header->magic != ASSET_PACK_MAGIC) { throw std::runtime_error("Not an asset pack: " + filepath); }
+		if (pack.header->version != ASSET_PACK_VERSION) { throw std::runtime_error("Asset pack version " + std::to_string(pack.header->version) + " doesn't match the reader's (" + std::to_string(ASSET_PACK_VERSION) + ") - re-cook " + filepath); }
+
+		//Never trust a table or blob to lie inside the file
+		const std::size_t entriesOffset{ sizeof(AssetPackHeader) };
+		const std::size_t levelsOffset{ entriesOffset + static_cast<std::size_t>(pack.header->entryCount) * sizeof(AssetPackEntry) };
+		const std::size_t tablesEnd{ levelsOffset + static_cast<std::size_t>(pack.header->levelCount) * sizeof(AssetPackLevel) };
+		if (tablesEnd > fileSize || pack.header->namesOffset < tablesEnd || pack.header->namesOffset > fileSize || pack.header->namesSize > fileSize - pack.header->namesOffset) { throw std::runtime_error("Asset pack tables out of bounds: " + filepath); }
+		pack.entries = reinterpret_cast<const AssetPackEntry*>(pack.mappedFile.data + entriesOffset);
+		pack.levels = reinterpret_cast<const AssetPackLevel*>(pack.mappedFile.data + levelsOffset);
+		pack.names = reinterpret_cast<const char*>(pack.mappedFile.data + pack.header->namesOffset);
+
+		for (std::uint32_t i{ 0 }; i<pack.header->entryCount; ++i)
+		{
+			const AssetPackEntry& entry{ pack.entries[i] };
+			if (static_cast<std::uint64_t>(entry.nameOffset) + entry.nameLength > pack.header->namesSize ||
+				entry.levelCount == 0 || static_cast<std::uint64_t>(entry.firstLevel) + entry.levelCount > pack.header->levelCount)
+			{
+				throw std::runtime_error("Asset pack entry " + std::to_string(i) + " out of bounds: " + filepath);
+			}
+		}
+		for (std::uint32_t i{ 0 }; i<pack.header->levelCount; ++i)
+		{
+			const AssetPackLevel& level{ pack.levels[i] };
+			if (level.offset > fileSize || level.size > fileSize - level.offset || level.offset % ASSET_PACK_BLOB_ALIGNMENT != 0) { throw std::runtime_error("Asset pack blob " + std::to_string(i) + " out of bounds: " + filepath); }
+		}
+	}
+	catch (...)
+	{
+		Close(pack);
+		throw;
+	}
+	return pack;
+}
+
+
+
+void AssetPackReader::Close(AssetPack& pack)
+{
+	FileMapper::Unmap(pack.mappedFile);
+	pack.header = nullptr;
+	pack.entries = nullptr;
+	pack.levels = nullptr;
+	pack.names = nullptr;
+}
+
+
+
+const AssetPackEntry* AssetPackReader::Find(const AssetPack& pack, std::string_view name)
+{
+	const AssetPackEntry* begin{ pack.entries };
+	const AssetPackEntry* end{ pack.entries + pack.header->entryCount };
+	const AssetPackEntry* entry{ std::lower_bound(begin, end, name, [&pack](const AssetPackEntry& _entry, std::string_view _name){ return GetName(pack, _entry) < _name; }) };
+	return (entry != end && GetName(pack, *entry) == name) ? entry : nullptr;
+}
+
+
+
+std::string_view AssetPackReader::GetName(const AssetPack& pack, const AssetPackEntry& entry)
+{
+	return std::string_view{ pack.names + entry.nameOffset, entry.nameLength };
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef ASSETPACKREADER_H
+#define ASSETPACKREADER_H
+
+#include "AssetPackFormat.h"
+#include "MappedFile.h"
+
+#include <string_view>
+
+//A memory-mapped pack file - the pointers point straight into the mapping
+struct AssetPack
+{
+	MappedFile mappedFile;
+	const AssetPackHeader* header;
+	const AssetPackEntry* entries;
+	const AssetPackLevel* levels;
+	const char* names;
+};
+
+
+//Static utility class for reading pack files written by the asset cooker (see AssetPackFormat.h)
+//Nothing is decoded or copied - entries' blobs are GPU-ready byte ranges of the mapping, so loading a pack is one sequential read through the page cache
+class AssetPackReader
+{
+public:
+	//Memory-map filepath and validate its tables (throws if the file is malformed or of a different version)
+	static AssetPack Open(const std::string& filepath);
+
+	//Unmap a pack from Open() - invalidates every pointer into it
+	static void Close(AssetPack& pack);
+
+	//Binary search for the entry called name (nullptr if there isn't one)
+	static const AssetPackEntry* Find(const AssetPack& pack, std::string_view name);
+
+	static std::string_view GetName(const AssetPack& pack, const AssetPackEntry& entry);
+};
+
+
+#endif
\ No newline at end of file
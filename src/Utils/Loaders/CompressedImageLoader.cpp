@@ -0,0 +1,252 @@
+#include "CompressedImageLoader.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <cctype>
+
+namespace
+{
+	//Read a little-endian value of type T from _data + _offset (both formats are little-endian, as is every platform Vulkan runs on)
+	template<typename T>
+	T Read(const unsigned char* _data, std::size_t _offset)
+	{
+		T value;
+		memcpy(&value, _data + _offset, sizeof(T));
+		return value;
+	}
+
+	//A full mip chain ends at 1x1, so a header claiming more levels than that (or an empty image) is corrupt
+	void ValidateExtent(std::uint32_t _width, std::uint32_t _height, std::uint32_t _levelCount, const std::string& _filepath)
+	{
+		if (_width == 0 || _height == 0) { throw std::runtime_error("Zero-sized image: " + _filepath); }
+		if (_levelCount > static_cast<std::uint32_t>(std::bit_width(std::max(_width, _height)))) { throw std::runtime_error("More mip levels than a " + std::to_string(_width) + "x" + std::to_string(_height) + " image can have: " + _filepath); }
+	}
+
+	constexpr std::uint32_t MakeFourCC(char _a, char _b, char _c, char _d)
+	{
+		return static_cast<std::uint32_t>(_a) | (static_cast<std::uint32_t>(_b) << 8) | (static_cast<std::uint32_t>(_c) << 16) | (static_cast<std::uint32_t>(_d) << 24);
+	}
+
+	constexpr unsigned char KTX2_IDENTIFIER[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	constexpr std::size_t KTX2_HEADER_SIZE{ 80 }; //Identifier, header and index - the level index follows
+	constexpr std::size_t KTX2_LEVEL_INDEX_ENTRY_SIZE{ 24 };
+
+	constexpr std::uint32_t DDS_MAGIC{ MakeFourCC('D', 'D', 'S', ' ') };
+	constexpr std::size_t DDS_HEADER_SIZE{ 128 }; //Magic and DDS_HEADER
+	constexpr std::size_t DDS_DX10_HEADER_SIZE{ 20 };
+	constexpr std::uint32_t DDS_PIXEL_FORMAT_FOURCC_FLAG{ 0x4 };
+	constexpr std::uint32_t DDS_CUBEMAP_FLAG{ 0x200 };
+}
+
+
+
+bool CompressedImageLoader::IsCompressedImageFile(const std::string& filepath)
+{
+	const std::size_t dot{ filepath.find_last_of('.') };
+	if (dot == std::string::npos) { return false; }
+	std::string extension{ filepath.substr(dot + 1) };
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+	return extension == "ktx2" || extension == "dds";
+}
+
+
+
+CompressedImageFile CompressedImageLoader::Open(const std::string& filepath)
+{
+	CompressedImageFile file{};
+	file.mappedFile = FileMapper::Map(filepath);
+	try
+	{
+		if (file.mappedFile.size >= sizeof(KTX2_IDENTIFIER) && memcmp(file.mappedFile.data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) { ParseKTX2(file, filepath); }
+		else if (file.mappedFile.size >= sizeof(DDS_MAGIC) && Read<std::uint32_t>(file.mappedFile.data, 0) == DDS_MAGIC) { ParseDDS(file, filepath); }
+		else { throw std::runtime_error("Not a KTX2 or DDS file: " + filepath); }
+
+		//Never trust a level to lie inside the file
+		for (const CompressedImageLevel& level : file.levels)
+		{
+			if (level.size == 0 || level.offset > file.mappedFile.size || level.size > file.mappedFile.size - level.offset) { throw std::runtime_error("Mip level data out of bounds: " + filepath); }
+		}
+	}
+	catch (...)
+	{
+		Close(file);
+		throw;
+	}
+	return file;
+}
+
+
+
+void CompressedImageLoader::Close(CompressedImageFile& file)
+{
+	FileMapper::Unmap(file.mappedFile);
+	file.levels.clear();
+}
+
+
+
+std::uint32_t CompressedImageLoader::GetBCBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+
+
+FormatBlockInfo CompressedImageLoader::GetFormatBlockInfo(VkFormat format)
+{
+	//Core formats are grouped by component layout in the enum, so each group is a contiguous range
+	if (format == VK_FORMAT_R4G4_UNORM_PACK8) { return { 1, 1, 1 }; }
+	if (format >= VK_FORMAT_R4G4B4A4_UNORM_PACK16 && format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16) { return { 2, 1, 1 }; }
+	if (format >= VK_FORMAT_R8_UNORM && format <= VK_FORMAT_R8_SRGB) { return { 1, 1, 1 }; }
+	if (format >= VK_FORMAT_R8G8_UNORM && format <= VK_FORMAT_R8G8_SRGB) { return { 2, 1, 1 }; }
+	if (format >= VK_FORMAT_R8G8B8_UNORM && format <= VK_FORMAT_B8G8R8_SRGB) { return { 3, 1, 1 }; }
+	if (format >= VK_FORMAT_R8G8B8A8_UNORM && format <= VK_FORMAT_A2B10G10R10_SINT_PACK32) { return { 4, 1, 1 }; }
+	if (format >= VK_FORMAT_R16_UNORM && format <= VK_FORMAT_R16_SFLOAT) { return { 2, 1, 1 }; }
+	if (format >= VK_FORMAT_R16G16_UNORM && format <= VK_FORMAT_R16G16_SFLOAT) { return { 4, 1, 1 }; }
+	if (format >= VK_FORMAT_R16G16B16_UNORM && format <= VK_FORMAT_R16G16B16_SFLOAT) { return { 6, 1, 1 }; }
+	if (format >= VK_FORMAT_R16G16B16A16_UNORM && format <= VK_FORMAT_R16G16B16A16_SFLOAT) { return { 8, 1, 1 }; }
+	if (format >= VK_FORMAT_R32_UINT && format <= VK_FORMAT_R32_SFLOAT) { return { 4, 1, 1 }; }
+	if (format >= VK_FORMAT_R32G32_UINT && format <= VK_FORMAT_R32G32_SFLOAT) { return { 8, 1, 1 }; }
+	if (format >= VK_FORMAT_R32G32B32_UINT && format <= VK_FORMAT_R32G32B32_SFLOAT) { return { 12, 1, 1 }; }
+	if (format >= VK_FORMAT_R32G32B32A32_UINT && format <= VK_FORMAT_R32G32B32A32_SFLOAT) { return { 16, 1, 1 }; }
+	if (format >= VK_FORMAT_R64_UINT && format <= VK_FORMAT_R64_SFLOAT) { return { 8, 1, 1 }; }
+	if (format >= VK_FORMAT_R64G64_UINT && format <= VK_FORMAT_R64G64_SFLOAT) { return { 16, 1, 1 }; }
+	if (format >= VK_FORMAT_R64G64B64_UINT && format <= VK_FORMAT_R64G64B64_SFLOAT) { return { 24, 1, 1 }; }
+	if (format >= VK_FORMAT_R64G64B64A64_UINT && format <= VK_FORMAT_R64G64B64A64_SFLOAT) { return { 32, 1, 1 }; }
+	if (format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) { return { 4, 1, 1 }; }
+	if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) { return { GetBCBlockSize(format), 4, 4 }; }
+	if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) { return { 8, 4, 4 }; }
+	if (format == VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK || format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) { return { 16, 4, 4 }; }
+	if (format == VK_FORMAT_EAC_R11_UNORM_BLOCK || format == VK_FORMAT_EAC_R11_SNORM_BLOCK) { return { 8, 4, 4 }; }
+	if (format == VK_FORMAT_EAC_R11G11_UNORM_BLOCK || format == VK_FORMAT_EAC_R11G11_SNORM_BLOCK) { return { 16, 4, 4 }; }
+	if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+	{
+		//Every ASTC block is 16 bytes - only the footprint varies (UNORM/SRGB pairs in increasing footprint order)
+		constexpr std::uint32_t ASTC_FOOTPRINTS[14][2]{ { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+		const std::uint32_t footprint{ static_cast<std::uint32_t>(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2 };
+		return { 16, ASTC_FOOTPRINTS[footprint][0], ASTC_FOOTPRINTS[footprint][1] };
+	}
+	return { 0, 1, 1 };
+}
+
+
+
+void CompressedImageLoader::ParseKTX2(CompressedImageFile& file, const std::string& filepath)
+{
+	const unsigned char* data{ file.mappedFile.data };
+	if (file.mappedFile.size < KTX2_HEADER_SIZE) { throw std::runtime_error("Truncated KTX2 header: " + filepath); }
+
+	file.format = static_cast<VkFormat>(Read<std::uint32_t>(data, 12));
+	file.width = Read<std::uint32_t>(data, 20);
+	file.height = std::max(Read<std::uint32_t>(data, 24), 1u); //0 for 1D images, which are loaded as Nx1
+	const std::uint32_t depth{ Read<std::uint32_t>(data, 28) };
+	const std::uint32_t layerCount{ Read<std::uint32_t>(data, 32) };
+	const std::uint32_t faceCount{ Read<std::uint32_t>(data, 36) };
+	const std::uint32_t levelCount{ std::max(Read<std::uint32_t>(data, 40), 1u) }; //0 means "generate the chain at load time" - only the base level is stored
+	const std::uint32_t supercompressionScheme{ Read<std::uint32_t>(data, 44) };
+
+	if (file.format == VK_FORMAT_UNDEFINED || supercompressionScheme != 0) { throw std::runtime_error("Basis Universal / supercompressed KTX2 files need transcoding and aren't supported: " + filepath); }
+	if (depth > 1 || layerCount > 1 || faceCount != 1) { throw std::runtime_error("Only single-layer 2D KTX2 files are supported: " + filepath); }
+	ValidateExtent(file.width, file.height, levelCount, filepath);
+	if (file.mappedFile.size < KTX2_HEADER_SIZE + static_cast<std::size_t>(levelCount) * KTX2_LEVEL_INDEX_ENTRY_SIZE) { throw std::runtime_error("Truncated KTX2 level index: " + filepath); }
+
+	file.levels.resize(levelCount);
+	for (std::uint32_t i{ 0 }; i<levelCount; ++i)
+	{
+		const std::size_t entry{ KTX2_HEADER_SIZE + static_cast<std::size_t>(i) * KTX2_LEVEL_INDEX_ENTRY_SIZE };
+		file.levels[i].offset = static_cast<std::size_t>(Read<std::uint64_t>(data, entry));
+		file.levels[i].size = static_cast<std::size_t>(Read<std::uint64_t>(data, entry + 8));
+	}
+}
+
+
+
+void CompressedImageLoader::ParseDDS(CompressedImageFile& file, const std::string& filepath)
+{
+	const unsigned char* data{ file.mappedFile.data };
+	if (file.mappedFile.size < DDS_HEADER_SIZE) { throw std::runtime_error("Truncated DDS header: " + filepath); }
+
+	file.height = Read<std::uint32_t>(data, 12);
+	file.width = Read<std::uint32_t>(data, 16);
+	const std::uint32_t levelCount{ std::max(Read<std::uint32_t>(data, 28), 1u) };
+	const std::uint32_t pixelFormatFlags{ Read<std::uint32_t>(data, 80) };
+	const std::uint32_t fourCC{ Read<std::uint32_t>(data, 84) };
+	const std::uint32_t caps2{ Read<std::uint32_t>(data, 112) };
+	if ((pixelFormatFlags & DDS_PIXEL_FORMAT_FOURCC_FLAG) == 0) { throw std::runtime_error("Only block-compressed DDS files are supported: " + filepath); }
+	if ((caps2 & DDS_CUBEMAP_FLAG) != 0) { throw std::runtime_error("Only 2D DDS files are supported: " + filepath); }
+	ValidateExtent(file.width, file.height, levelCount, filepath);
+
+	std::size_t dataOffset{ DDS_HEADER_SIZE };
+	file.format = VK_FORMAT_UNDEFINED;
+	if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		if (file.mappedFile.size < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE) { throw std::runtime_error("Truncated DDS DX10 header: " + filepath); }
+		const std::uint32_t dxgiFormat{ Read<std::uint32_t>(data, DDS_HEADER_SIZE) };
+		const std::uint32_t arraySize{ Read<std::uint32_t>(data, DDS_HEADER_SIZE + 12) };
+		if (arraySize > 1) { throw std::runtime_error("Only single-layer DDS files are supported: " + filepath); }
+		dataOffset += DDS_DX10_HEADER_SIZE;
+		switch (dxgiFormat)
+		{
+		case 71: file.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+		case 72: file.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+		case 74: file.format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+		case 75: file.format = VK_FORMAT_BC2_SRGB_BLOCK; break;
+		case 77: file.format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+		case 78: file.format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+		case 80: file.format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+		case 81: file.format = VK_FORMAT_BC4_SNORM_BLOCK; break;
+		case 83: file.format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+		case 84: file.format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+		case 95: file.format = VK_FORMAT_BC6H_UFLOAT_BLOCK; break;
+		case 96: file.format = VK_FORMAT_BC6H_SFLOAT_BLOCK; break;
+		case 98: file.format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+		case 99: file.format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+		default: break;
+		}
+	}
+	else
+	{
+		//Legacy headers carry no colour space - colour formats are assumed to hold sRGB data like uncompressed textures
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1')) { file.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; }
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '3')) { file.format = VK_FORMAT_BC2_SRGB_BLOCK; }
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '5')) { file.format = VK_FORMAT_BC3_SRGB_BLOCK; }
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) { file.format = VK_FORMAT_BC4_UNORM_BLOCK; }
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) { file.format = VK_FORMAT_BC5_UNORM_BLOCK; }
+	}
+	if (file.format == VK_FORMAT_UNDEFINED) { throw std::runtime_error("Unsupported DDS pixel format: " + filepath); }
+
+	//Levels are stored tightly packed, largest first
+	const std::uint32_t blockSize{ GetBCBlockSize(file.format) };
+	file.levels.resize(levelCount);
+	for (std::uint32_t i{ 0 }; i<levelCount; ++i)
+	{
+		const std::size_t levelWidth{ std::max(file.width >> i, 1u) };
+		const std::size_t levelHeight{ std::max(file.height >> i, 1u) };
+		file.levels[i].offset = dataOffset;
+		file.levels[i].size = ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+		dataOffset += file.levels[i].size;
+	}
+}
\ No newline at end of file
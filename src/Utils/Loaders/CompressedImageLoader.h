@@ -0,0 +1,64 @@
+#ifndef COMPRESSEDIMAGELOADER_H
+#define COMPRESSEDIMAGELOADER_H
+
+#include "MappedFile.h"
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+//A single mip level of a compressed image - a byte range of the mapped file
+struct CompressedImageLevel
+{
+	std::size_t offset;
+	std::size_t size;
+};
+
+//A memory-mapped KTX2 or DDS file whose blocks can be copied to the GPU as-is
+struct CompressedImageFile
+{
+	MappedFile mappedFile;
+	VkFormat format;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::vector<CompressedImageLevel> levels; //Largest first
+};
+
+//Size and footprint of one texel block of a format (uncompressed formats have 1x1 blocks)
+struct FormatBlockInfo
+{
+	std::uint32_t size; //Bytes - 0 if the format is unsupported
+	std::uint32_t width;
+	std::uint32_t height;
+};
+
+
+//Static utility class for reading block-compressed (BCn, ETC2, ASTC) textures without decoding them
+//KTX2 files may contain any non-supercompressed 2D VkFormat, DDS files may contain BC1-BC5 and BC7
+//Only single-layer, single-face 2D images are supported
+class CompressedImageLoader
+{
+public:
+	//True if filepath has a .ktx2 or .dds extension
+	static bool IsCompressedImageFile(const std::string& filepath);
+
+	//Memory-map filepath and locate every mip level stored in it (throws if the file is malformed or unsupported)
+	static CompressedImageFile Open(const std::string& filepath);
+
+	//Unmap a file from Open()
+	static void Close(CompressedImageFile& file);
+
+	//Size in bytes of one texel block of a BCn format (0 for anything else)
+	static std::uint32_t GetBCBlockSize(VkFormat format);
+
+	//Texel block of any core single-plane colour format (size 0 for depth/stencil, multi-planar, and extension formats)
+	static FormatBlockInfo GetFormatBlockInfo(VkFormat format);
+
+
+private:
+	static void ParseKTX2(CompressedImageFile& file, const std::string& filepath);
+	static void ParseDDS(CompressedImageFile& file, const std::string& filepath);
+};
+
+
+#endif
\ No newline at end of file
@@ -1,13 +1,19 @@
 #include "ImageLoader.h"
 #include <stb_image.h>
 #include <stdexcept>
+#include <cstring>
+#include <climits>
 
 ImageData ImageLoader::Load(const std::string& filepath)
 {
-	stbi_set_flip_vertically_on_load(true);
+	ImageFile file{ Open(filepath) };
+
+	//Per-thread flag so that images can be decoded on several threads at once
+	stbi_set_flip_vertically_on_load_thread(true);
 	
 	ImageData imageData{};
-	imageData.pixels = stbi_load(filepath.c_str(), &imageData.metadata.width, &imageData.metadata.height, &imageData.metadata.channels, STBI_rgb_alpha);
+	imageData.pixels = stbi_load_from_memory(file.mappedFile.data, static_cast<int>(file.mappedFile.size), &imageData.metadata.width, &imageData.metadata.height, &imageData.metadata.channels, STBI_rgb_alpha);
+	Close(file);
 	if (!imageData.pixels) { throw std::runtime_error("Failed to load texture image: " + filepath); }
 	imageData.metadata.channels = 4;
 	return imageData;
@@ -18,4 +24,57 @@ ImageData ImageLoader::Load(const std::string& filepath)
 void ImageLoader::Free(void* pixels)
 {
 	stbi_image_free(pixels);
+}
+
+
+
+ImageFile ImageLoader::Open(const std::string& filepath)
+{
+	ImageFile file{};
+	file.mappedFile = FileMapper::Map(filepath);
+	if (file.mappedFile.size > INT_MAX)
+	{
+		Close(file);
+		throw std::runtime_error("Texture image is too large for stb_image: " + filepath);
+	}
+
+	if (!stbi_info_from_memory(file.mappedFile.data, static_cast<int>(file.mappedFile.size), &file.metadata.width, &file.metadata.height, &file.metadata.channels))
+	{
+		Close(file);
+		throw std::runtime_error("Failed to read texture image header: " + filepath + " (" + stbi_failure_reason() + ")");
+	}
+	file.metadata.channels = 4; //Always decoded as RGBA
+	return file;
+}
+
+
+
+void ImageLoader::LoadInto(const ImageFile& file, void* dst, std::size_t rowPitch)
+{
+	//stb can't decode into caller memory, so the flip is folded into the copy out of its buffer rather than being a separate pass over the image
+	stbi_set_flip_vertically_on_load_thread(false);
+
+	int width, height, channels;
+	stbi_uc* pixels{ stbi_load_from_memory(file.mappedFile.data, static_cast<int>(file.mappedFile.size), &width, &height, &channels, STBI_rgb_alpha) };
+	if (!pixels) { throw std::runtime_error(std::string("Failed to decode texture image (") + stbi_failure_reason() + ")"); }
+	if (width != file.metadata.width || height != file.metadata.height)
+	{
+		stbi_image_free(pixels);
+		throw std::runtime_error("Decoded texture image size doesn't match its header");
+	}
+
+	const std::size_t srcPitch{ static_cast<std::size_t>(width) * 4 };
+	unsigned char* dstBytes{ static_cast<unsigned char*>(dst) };
+	for (int row{ 0 }; row<height; ++row)
+	{
+		memcpy(dstBytes + static_cast<std::size_t>(row) * rowPitch, pixels + static_cast<std::size_t>(height - 1 - row) * srcPitch, srcPitch);
+	}
+	stbi_image_free(pixels);
+}
+
+
+
+void ImageLoader::Close(ImageFile& file)
+{
+	FileMapper::Unmap(file.mappedFile);
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #ifndef IMAGELOADER_H
 #define IMAGELOADER_H
 
-#include <string>
+#include "MappedFile.h"
 
 struct ImageMetadata
 {
@@ -16,13 +16,33 @@ struct ImageData
 	ImageMetadata metadata;
 };
 
+//A read-only memory map of an encoded image file along with the metadata of the image it decodes to
+struct ImageFile
+{
+	MappedFile mappedFile;
+	ImageMetadata metadata;
+};
+
 
 //Static utility class for loading and freeing image data using stb_image
+//Image files are read through a memory map (see FileMapper) rather than stdio
+//Load() and LoadInto() are safe to call from multiple threads concurrently
 class ImageLoader
 {
 public:
 	static ImageData Load(const std::string& filepath);
 	static void Free(void* pixels);
+
+	//Memory-map filepath and read its header without decoding it
+	//The metadata is that of the decoded image (always 4 channels) - use it to size the destination passed to LoadInto()
+	static ImageFile Open(const std::string& filepath);
+
+	//Decode file straight into dst (e.g.: mapped staging memory), flipped vertically, with each row starting rowPitch bytes after the previous one
+	//rowPitch must be at least width * channels
+	static void LoadInto(const ImageFile& file, void* dst, std::size_t rowPitch);
+
+	//Unmap a file from Open()
+	static void Close(ImageFile& file);
 };
 
 
@@ -0,0 +1,65 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile FileMapper::Map(const std::string& filepath)
+{
+	MappedFile file{};
+
+	#if defined(_WIN32)
+		const HANDLE fileHandle{ CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (fileHandle == INVALID_HANDLE_VALUE) { throw std::runtime_error("Failed to open file: " + filepath); }
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		file.size = static_cast<std::size_t>(fileSize.QuadPart);
+		file.mapping = file.size == 0 ? nullptr : CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		//The mapping keeps the file open
+		CloseHandle(fileHandle);
+		if (file.mapping != nullptr) { file.data = static_cast<const unsigned char*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0)); }
+	#else
+		const int fileDescriptor{ open(filepath.c_str(), O_RDONLY) };
+		if (fileDescriptor == -1) { throw std::runtime_error("Failed to open file: " + filepath); }
+		struct stat fileStat{};
+		fstat(fileDescriptor, &fileStat);
+		file.size = static_cast<std::size_t>(fileStat.st_size);
+		if (file.size != 0)
+		{
+			void* data{ mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) };
+			file.data = data == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(data);
+			//Files are read from front to back once
+			if (file.data != nullptr) { madvise(data, file.size, MADV_SEQUENTIAL); }
+		}
+		//The mapping keeps the file open
+		close(fileDescriptor);
+	#endif
+
+	if (file.data == nullptr)
+	{
+		Unmap(file);
+		throw std::runtime_error("Failed to map file: " + filepath);
+	}
+	return file;
+}
+
+
+
+void FileMapper::Unmap(MappedFile& file)
+{
+	#if defined(_WIN32)
+		if (file.data != nullptr) { UnmapViewOfFile(file.data); }
+		if (file.mapping != nullptr) { CloseHandle(file.mapping); }
+	#else
+		if (file.data != nullptr) { munmap(const_cast<unsigned char*>(file.data), file.size); }
+	#endif
+	file.data = nullptr;
+	file.size = 0;
+	file.mapping = nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+//A read-only memory map of a whole file
+struct MappedFile
+{
+	const unsigned char* data;
+	std::size_t size;
+	void* mapping; //Handle of the file mapping object (Windows only)
+};
+
+
+//Static utility class for memory-mapping files (mmap on POSIX, file mappings on Windows) so that they're read straight from the page cache rather than through stdio
+class FileMapper
+{
+public:
+	//Throws if filepath can't be opened or is empty
+	static MappedFile Map(const std::string& filepath);
+	static void Unmap(MappedFile& file);
+};
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "TextureCache.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	constexpr std::uint32_t TEXTURE_CACHE_MAGIC{ 0x43544B4E }; //"NKTC"
+	constexpr std::uint32_t TEXTURE_CACHE_VERSION{ 1 };
+
+	//[TextureCacheHeader][source path][padding to 16 bytes][pixels]
+	struct TextureCacheHeader
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::int64_t sourceModifiedTime;
+		std::uint64_t sourceSize;
+		std::uint64_t sourceHash;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t channels;
+		std::uint32_t pathLength; //Guards against two paths hashing to the same entry
+	};
+	static_assert(sizeof(TextureCacheHeader) == 48);
+
+	constexpr std::size_t GetPixelsOffset(std::size_t pathLength)
+	{
+		return ((sizeof(TextureCacheHeader) + pathLength + 15) / 16) * 16;
+	}
+}
+
+
+
+TextureCache::TextureCache(const std::string& cacheDirectory) : directory(cacheDirectory)
+{
+	if (directory.empty()) { return; }
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) { directory.clear(); }
+}
+
+
+
+bool TextureCache::IsEnabled() const
+{
+	return !directory.empty();
+}
+
+
+
+bool TextureCache::Find(const std::string& filepath, CachedTexture& texture) const
+{
+	if (!IsEnabled()) { return false; }
+
+	const std::string entryPath{ GetEntryPath(filepath) };
+	SourceKey sourceKey;
+	std::error_code error;
+	if (!std::filesystem::exists(entryPath, error) || !GetSourceKey(filepath, sourceKey)) { return false; }
+
+	try
+	{
+		texture.mappedFile = FileMapper::Map(entryPath);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	//Validate the entry itself before trusting anything in it
+	const MappedFile& entry{ texture.mappedFile };
+	TextureCacheHeader header;
+	bool valid{ entry.size >= sizeof(TextureCacheHeader) };
+	if (valid)
+	{
+		memcpy(&header, entry.data, sizeof(TextureCacheHeader));
+		const std::size_t pixelsSize{ static_cast<std::size_t>(header.width) * header.height * header.channels };
+		valid = header.magic == TEXTURE_CACHE_MAGIC && header.version == TEXTURE_CACHE_VERSION &&
+				header.pathLength == filepath.size() && entry.size >= GetPixelsOffset(header.pathLength) + pixelsSize &&
+				memcmp(entry.data + sizeof(TextureCacheHeader), filepath.data(), filepath.size()) == 0;
+	}
+
+	//A changed modification time or size doesn't necessarily mean changed contents (e.g.: a fresh checkout) - compare content hashes before rebuilding
+	if (valid && (header.sourceModifiedTime != sourceKey.modifiedTime || header.sourceSize != sourceKey.size))
+	{
+		valid = false;
+		if (header.sourceSize == sourceKey.size)
+		{
+			try
+			{
+				MappedFile source{ FileMapper::Map(filepath) };
+				valid = HashBytes(source.data, source.size) == header.sourceHash;
+				FileMapper::Unmap(source);
+			}
+			catch (const std::exception&) {}
+		}
+
+		//Refresh the stored modification time so the next lookup takes the fast path again
+		if (valid)
+		{
+			FileMapper::Unmap(texture.mappedFile);
+			header.sourceModifiedTime = sourceKey.modifiedTime;
+			{
+				std::fstream file(entryPath, std::ios::in | std::ios::out | std::ios::binary);
+				file.write(reinterpret_cast<const char*>(&header), sizeof(TextureCacheHeader));
+			}
+			try { texture.mappedFile = FileMapper::Map(entryPath); }
+			catch (const std::exception&) { return false; }
+		}
+	}
+
+	if (!valid)
+	{
+		Close(texture);
+		return false;
+	}
+	texture.metadata.width = static_cast<int>(header.width);
+	texture.metadata.height = static_cast<int>(header.height);
+	texture.metadata.channels = static_cast<int>(header.channels);
+	texture.pixels = texture.mappedFile.data + GetPixelsOffset(header.pathLength);
+	return true;
+}
+
+
+
+bool TextureCache::Store(const std::string& filepath, const ImageMetadata& metadata, const void* pixels) const
+{
+	if (!IsEnabled()) { return false; }
+
+	//The key is taken from the source as it is now, so a source that changes mid-load is simply rebuilt again next time
+	TextureCacheHeader header{};
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.width = static_cast<std::uint32_t>(metadata.width);
+	header.height = static_cast<std::uint32_t>(metadata.height);
+	header.channels = static_cast<std::uint32_t>(metadata.channels);
+	header.pathLength = static_cast<std::uint32_t>(filepath.size());
+	SourceKey sourceKey;
+	if (!GetSourceKey(filepath, sourceKey)) { return false; }
+	header.sourceModifiedTime = sourceKey.modifiedTime;
+	header.sourceSize = sourceKey.size;
+	try
+	{
+		MappedFile source{ FileMapper::Map(filepath) };
+		header.sourceHash = HashBytes(source.data, source.size);
+		FileMapper::Unmap(source);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	//Write to a uniquely named temporary file and rename it over the entry so that readers never see a partially written entry
+	static std::atomic<std::uint64_t> temporaryCounter{ 0 };
+	const std::string entryPath{ GetEntryPath(filepath) };
+	const std::string temporaryPath{ entryPath + ".tmp" + std::to_string(temporaryCounter.fetch_add(1)) };
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		const std::size_t pixelsOffset{ GetPixelsOffset(filepath.size()) };
+		const char padding[16]{};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(TextureCacheHeader));
+		file.write(filepath.data(), static_cast<std::streamsize>(filepath.size()));
+		file.write(padding, static_cast<std::streamsize>(pixelsOffset - sizeof(TextureCacheHeader) - filepath.size()));
+		file.write(static_cast<const char*>(pixels), static_cast<std::streamsize>(static_cast<std::size_t>(metadata.width) * metadata.height * metadata.channels));
+		if (!file)
+		{
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, entryPath, error);
+	if (error)
+	{
+		//e.g.: the entry is mapped by another thread on a platform that doesn't allow replacing mapped files
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+
+
+void TextureCache::Close(CachedTexture& texture)
+{
+	FileMapper::Unmap(texture.mappedFile);
+	texture.pixels = nullptr;
+}
+
+
+
+std::string TextureCache::GetEntryPath(const std::string& filepath) const
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(HashBytes(filepath.data(), filepath.size())));
+	return (std::filesystem::path(directory) / (std::string(name) + ".nktc")).string();
+}
+
+
+
+bool TextureCache::GetSourceKey(const std::string& filepath, SourceKey& key)
+{
+	std::error_code error;
+	const std::filesystem::file_time_type modifiedTime{ std::filesystem::last_write_time(filepath, error) };
+	if (error) { return false; }
+	key.size = static_cast<std::uint64_t>(std::filesystem::file_size(filepath, error));
+	if (error) { return false; }
+	key.modifiedTime = static_cast<std::int64_t>(modifiedTime.time_since_epoch().count());
+	return true;
+}
+
+
+
+std::uint64_t TextureCache::HashBytes(const void* data, std::size_t size)
+{
+	//64-bit multiply-xorshift over 8-byte words - not cryptographic, just fast enough that hashing a source is far cheaper than decoding it
+	constexpr std::uint64_t multiplier{ 0x9E3779B97F4A7C15ull };
+	const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+	std::uint64_t hash{ 0xCBF29CE484222325ull ^ (size * multiplier) };
+	std::size_t i{ 0 };
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ (word * multiplier)) * multiplier;
+		hash ^= hash >> 29;
+	}
+	std::uint64_t tail{ 0 };
+	memcpy(&tail, bytes + i, size - i);
+	hash = (hash ^ (tail * multiplier)) * multiplier;
+	hash ^= hash >> 32;
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "ImageLoader.h"
+
+#include <cstdint>
+#include <string>
+
+//A decoded texture read from the cache - pixels point into the mapped cache file
+struct CachedTexture
+{
+	MappedFile mappedFile;
+	ImageMetadata metadata;
+	const unsigned char* pixels; //Tightly packed and already flipped, exactly as ImageLoader::LoadInto() produces them
+};
+
+
+//On-disk cache of decoded textures so that repeat loads skip decoding entirely
+//Entries are keyed by source path and validated against the source's modification time and size - if either has changed, the source is hashed and the entry is only reused if its contents are unchanged
+//Find() and Store() are safe to call from multiple threads concurrently
+class TextureCache
+{
+public:
+	//Entries are stored in cacheDirectory (created if it doesn't exist) - an empty cacheDirectory disables the cache
+	explicit TextureCache(const std::string& cacheDirectory);
+
+	[[nodiscard]] bool IsEnabled() const;
+
+	//Map the cached pixels of filepath into texture if there is a valid entry for it (Close() it once the pixels have been copied)
+	//Returns false on a miss or a stale entry - decode the source and Store() it to rebuild the entry
+	[[nodiscard]] bool Find(const std::string& filepath, CachedTexture& texture) const;
+
+	//Write the decoded pixels of filepath, replacing any existing entry
+	//Failing to write is not an error (the texture is just decoded again next time) - returns false if the entry wasn't written
+	bool Store(const std::string& filepath, const ImageMetadata& metadata, const void* pixels) const;
+
+	static void Close(CachedTexture& texture);
+
+
+private:
+	//The source key an entry was built from
+	struct SourceKey
+	{
+		std::int64_t modifiedTime;
+		std::uint64_t size;
+	};
+
+	[[nodiscard]] std::string GetEntryPath(const std::string& filepath) const;
+	[[nodiscard]] static bool GetSourceKey(const std::string& filepath, SourceKey& key);
+	[[nodiscard]] static std::uint64_t HashBytes(const void* data, std::size_t size);
+
+	std::string directory;
+};
+
+
+#endif
\ No newline at end of file
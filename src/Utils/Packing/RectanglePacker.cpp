@@ -0,0 +1,107 @@
+#include "RectanglePacker.h"
+
+#include <climits>
+
+
+namespace Neki
+{
+
+
+
+RectanglePacker::RectanglePacker(std::uint32_t _width, std::uint32_t _height) : width(_width), height(_height), usedArea(0)
+{
+	Reset();
+}
+
+
+
+bool RectanglePacker::Pack(std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_x, std::uint32_t& _out_y)
+{
+	if (_width == 0 || _height == 0 || _width > width || _height > height) { return false; }
+
+	//Bottom-left: pick the position whose top edge is lowest, breaking ties by the leftmost
+	std::size_t bestIndex{ SIZE_MAX };
+	std::uint32_t bestY{ UINT32_MAX };
+	for (std::size_t i{ 0 }; i<skyline.size(); ++i)
+	{
+		const std::uint32_t y{ GetFitHeight(i, _width, _height) };
+		if (y != UINT32_MAX && (bestIndex == SIZE_MAX || y < bestY))
+		{
+			bestIndex = i;
+			bestY = y;
+		}
+	}
+	if (bestIndex == SIZE_MAX) { return false; }
+	_out_x = skyline[bestIndex].x;
+	_out_y = bestY;
+
+	//Raise the skyline over the rectangle, shrinking or removing the nodes it now covers
+	skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(bestIndex), SkylineNode{ _out_x, bestY + _height, _width });
+	const std::uint32_t right{ _out_x + _width };
+	for (std::size_t i{ bestIndex + 1 }; i<skyline.size();)
+	{
+		SkylineNode& node{ skyline[i] };
+		if (node.x >= right) { break; }
+		const std::uint32_t overlap{ right - node.x };
+		if (overlap >= node.width)
+		{
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i));
+			continue;
+		}
+		node.x += overlap;
+		node.width -= overlap;
+		break;
+	}
+
+	//Merge neighbours at the same height
+	for (std::size_t i{ 0 }; i + 1<skyline.size();)
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i) + 1);
+			continue;
+		}
+		++i;
+	}
+
+	usedArea += static_cast<std::uint64_t>(_width) * _height;
+	return true;
+}
+
+
+
+void RectanglePacker::Reset()
+{
+	skyline.clear();
+	skyline.push_back(SkylineNode{ 0, 0, width });
+	usedArea = 0;
+}
+
+
+
+float RectanglePacker::GetOccupancy() const
+{
+	return static_cast<float>(static_cast<double>(usedArea) / (static_cast<double>(width) * height));
+}
+
+
+
+std::uint32_t RectanglePacker::GetFitHeight(std::size_t _index, std::uint32_t _width, std::uint32_t _height) const
+{
+	//The rectangle rests on the highest node it spans
+	if (skyline[_index].x + _width > width) { return UINT32_MAX; }
+	std::uint32_t y{ 0 };
+	std::uint32_t remainingWidth{ _width };
+	for (std::size_t i{ _index }; remainingWidth > 0; ++i)
+	{
+		y = skyline[i].y > y ? skyline[i].y : y;
+		if (y + _height > height) { return UINT32_MAX; }
+		remainingWidth -= skyline[i].width < remainingWidth ? skyline[i].width : remainingWidth;
+	}
+	return y;
+}
+
+
+
+}
\ No newline at end of file
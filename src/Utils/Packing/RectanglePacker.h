@@ -0,0 +1,50 @@
+#ifndef RECTANGLEPACKER_H
+#define RECTANGLEPACKER_H
+
+#include <cstdint>
+#include <vector>
+
+//Skyline bin packer that places rectangles into a fixed-size bin, bottom-left first
+//The skyline only tracks the top edge of what has been placed, so space under an overhang is never reused - sort rectangles by descending height before packing to keep that waste small
+namespace Neki
+{
+
+
+class RectanglePacker
+{
+public:
+	explicit RectanglePacker(std::uint32_t _width, std::uint32_t _height);
+
+	//Find room for a _width x _height rectangle and reserve it - returns false (and reserves nothing) if it doesn't fit anywhere
+	[[nodiscard]] bool Pack(std::uint32_t _width, std::uint32_t _height, std::uint32_t& _out_x, std::uint32_t& _out_y);
+
+	//Free every rectangle
+	void Reset();
+
+	//Fraction of the bin's area covered by packed rectangles
+	[[nodiscard]] float GetOccupancy() const;
+
+
+private:
+	//A horizontal segment of the skyline - everything below y is (considered) used
+	struct SkylineNode
+	{
+		std::uint32_t x;
+		std::uint32_t y;
+		std::uint32_t width;
+	};
+
+	//The y a _width x _height rectangle would sit at if placed at the start of node _index, or UINT32_MAX if it doesn't fit there
+	[[nodiscard]] std::uint32_t GetFitHeight(std::size_t _index, std::uint32_t _width, std::uint32_t _height) const;
+
+	std::uint32_t width;
+	std::uint32_t height;
+	std::vector<SkylineNode> skyline; //Ordered by x, covering [0, width)
+	std::uint64_t usedArea;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef HANDLETABLE_H
+#define HANDLETABLE_H
+
+#include <cstdint>
+#include <vector>
+
+//Generic generational-index handle system
+//A HandleTable only hands out slot indices and tracks which generation of each slot is alive - the owner stores the actual per-resource data in its own parallel (structure-of-arrays) vectors indexed by Handle::index
+//Freeing a slot bumps its generation, so any copies of the old handle are detected as stale rather than silently aliasing whatever reuses the slot
+namespace Neki
+{
+
+
+//Tag is only used to make handles of different resource types distinct types (e.g.: Handle<struct BufferTag>)
+template<typename Tag>
+struct Handle
+{
+	std::uint32_t index{ UINT32_MAX };
+	std::uint32_t generation{ 0 };
+
+	[[nodiscard]] bool IsNull() const { return index == UINT32_MAX; }
+	bool operator==(const Handle&) const = default;
+};
+
+
+template<typename Tag>
+class HandleTable
+{
+public:
+	//Allocate a slot, reusing a freed one if possible
+	//The owner must make sure its parallel vectors are at least GetCapacity() long after this call
+	[[nodiscard]] Handle<Tag> Allocate()
+	{
+		std::uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			index = static_cast<std::uint32_t>(generations.size());
+			generations.push_back(0);
+			alive.push_back(false);
+		}
+		alive[index] = true;
+		++liveCount;
+		return Handle<Tag>{ index, generations[index] };
+	}
+
+	//Free _handle's slot - does nothing if _handle is null or stale
+	void Free(Handle<Tag> _handle)
+	{
+		if (!IsValid(_handle)) { return; }
+		alive[_handle.index] = false;
+		++generations[_handle.index];
+		freeIndices.push_back(_handle.index);
+		--liveCount;
+	}
+
+	//True if _handle refers to a live slot of the generation it was created with
+	[[nodiscard]] bool IsValid(Handle<Tag> _handle) const
+	{
+		return _handle.index < generations.size() && alive[_handle.index] && generations[_handle.index] == _handle.generation;
+	}
+
+	//Number of slots ever created (the size parallel vectors need to be)
+	[[nodiscard]] std::uint32_t GetCapacity() const { return static_cast<std::uint32_t>(generations.size()); }
+
+	//Number of currently live slots
+	[[nodiscard]] std::uint32_t GetLiveCount() const { return liveCount; }
+
+	//Get the current handle for slot _index, or a null handle if the slot isn't live (for iterating over all live slots)
+	[[nodiscard]] Handle<Tag> GetHandle(std::uint32_t _index) const
+	{
+		if (_index >= generations.size() || !alive[_index]) { return Handle<Tag>{}; }
+		return Handle<Tag>{ _index, generations[_index] };
+	}
+
+
+private:
+	std::vector<std::uint32_t> generations;
+	std::vector<bool> alive;
+	std::vector<std::uint32_t> freeIndices;
+	std::uint32_t liveCount{ 0 };
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+
+namespace Neki
+{
+
+
+
+ThreadPool::ThreadPool(std::uint32_t _threadCount) : stopping(false)
+{
+	if (_threadCount == 0)
+	{
+		//hardware_concurrency() may report 0 if it can't be determined
+		const std::uint32_t hardwareThreads{ std::thread::hardware_concurrency() };
+		_threadCount = std::max(hardwareThreads, 2u) - 1;
+	}
+
+	workers.reserve(_threadCount);
+	for (std::uint32_t i{ 0 }; i<_threadCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		stopping = true;
+	}
+	tasksCondition.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+
+
+void ThreadPool::Submit(std::function<void()> _task)
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		tasks.push_back(std::move(_task));
+	}
+	tasksCondition.notify_one();
+}
+
+
+
+void ThreadPool::RunAndWait(std::uint32_t _taskCount, const std::function<void(std::uint32_t)>& _task)
+{
+	if (_taskCount == 0) { return; }
+
+	//Lives on this stack frame, which outlives every task since this blocks until they've all finished
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	std::uint32_t remaining{ _taskCount - 1 };
+	std::exception_ptr exception;
+	const auto run{ [&](std::uint32_t _index)
+	{
+		try { _task(_index); }
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (!exception) { exception = std::current_exception(); }
+		}
+	} };
+
+	for (std::uint32_t i{ 1 }; i<_taskCount; ++i)
+	{
+		Submit([&, i]()
+		{
+			run(i);
+			//Notify while holding the lock so the waiting thread can't return (destroying doneCondition) mid-notify
+			std::lock_guard<std::mutex> lock(doneMutex);
+			--remaining;
+			doneCondition.notify_one();
+		});
+	}
+
+	//The calling thread takes the first task rather than sitting idle
+	run(0);
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&]{ return remaining == 0; });
+	if (exception) { std::rethrow_exception(exception); }
+}
+
+
+
+std::uint32_t ThreadPool::GetThreadCount() const
+{
+	return static_cast<std::uint32_t>(workers.size());
+}
+
+
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(tasksMutex);
+			tasksCondition.wait(lock, [this]{ return stopping || !tasks.empty(); });
+			//Drain the queue before stopping so no submitted task is silently dropped
+			if (tasks.empty()) { return; }
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads that run submitted tasks in FIFO order
+//Tasks must not throw - catch inside the task and hand any std::exception_ptr back to the submitting thread
+namespace Neki
+{
+
+
+class ThreadPool
+{
+public:
+	//Start _threadCount workers - 0 uses one per hardware thread, minus one for the calling thread (and at least one)
+	explicit ThreadPool(std::uint32_t _threadCount=0);
+
+	//Finishes every queued task before joining the workers
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//Queue _task to run on the next free worker
+	void Submit(std::function<void()> _task);
+
+	//Run _task(i) for every i in [0, _taskCount) across the workers and the calling thread, returning once every call has finished
+	//Unlike Submit(), _task may throw - the first exception is rethrown here once every call has finished
+	//Don't call from inside a task on the same pool (it can deadlock waiting on itself)
+	void RunAndWait(std::uint32_t _taskCount, const std::function<void(std::uint32_t)>& _task);
+
+	[[nodiscard]] std::uint32_t GetThreadCount() const;
+
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex tasksMutex;
+	std::condition_variable tasksCondition;
+	bool stopping;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
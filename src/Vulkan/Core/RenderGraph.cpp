@@ -0,0 +1,654 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Neki
+{
+
+
+
+RenderGraph::RenderGraph(const VKLogger& _logger) : logger(_logger), compiled(false), renderPassDesc{}
+{
+	//The swapchain is always declared so passes can write to it
+	Attachment swapchainAttachment{};
+	swapchainAttachment.name = "Swapchain";
+	swapchainAttachment.type = FORMAT_TYPE::SWAPCHAIN;
+	swapchainAttachment.format = VK_FORMAT_UNDEFINED;
+	swapchainAttachment.clear = false;
+	attachments.push_back(swapchainAttachment);
+}
+
+
+
+RenderGraphAttachment RenderGraph::CreateAttachment(const std::string& _name, FORMAT_TYPE _type, VkFormat _format)
+{
+	if (compiled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attempted to create attachment \"" + _name + "\" after the render graph was compiled\n");
+		throw std::runtime_error("");
+	}
+	if (_type == FORMAT_TYPE::SWAPCHAIN)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attachment \"" + _name + "\" can't be of type SWAPCHAIN - use GetSwapchainAttachment()\n");
+		throw std::runtime_error("");
+	}
+
+	Attachment attachment{};
+	attachment.name = _name;
+	attachment.type = _type;
+	attachment.format = _format;
+	attachment.clear = false;
+	attachments.push_back(attachment);
+	return RenderGraphAttachment{ static_cast<std::uint32_t>(attachments.size() - 1), 0 };
+}
+
+
+
+RenderGraphAttachment RenderGraph::GetSwapchainAttachment() const
+{
+	return RenderGraphAttachment{ 0, 0 };
+}
+
+
+
+void RenderGraph::SetClearValue(RenderGraphAttachment _attachment, VkClearValue _value)
+{
+	if (_attachment.index >= attachments.size())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attempted to set the clear value of an invalid attachment\n");
+		throw std::runtime_error("");
+	}
+	attachments[_attachment.index].clear = true;
+	attachments[_attachment.index].clearValue = _value;
+}
+
+
+
+RenderGraphPass RenderGraph::AddPass(const std::string& _name)
+{
+	if (compiled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attempted to add pass \"" + _name + "\" after the render graph was compiled\n");
+		throw std::runtime_error("");
+	}
+
+	Pass pass{};
+	pass.name = _name;
+	pass.subpass = UINT32_MAX;
+	passes.push_back(pass);
+	return RenderGraphPass{ static_cast<std::uint32_t>(passes.size() - 1), 0 };
+}
+
+
+
+void RenderGraph::WriteColour(RenderGraphPass _pass, RenderGraphAttachment _attachment)
+{
+	AddAccess(_pass, _attachment, ACCESS_TYPE::COLOUR_WRITE);
+}
+
+
+
+void RenderGraph::WriteDepth(RenderGraphPass _pass, RenderGraphAttachment _attachment)
+{
+	AddAccess(_pass, _attachment, ACCESS_TYPE::DEPTH_WRITE);
+}
+
+
+
+void RenderGraph::ReadDepth(RenderGraphPass _pass, RenderGraphAttachment _attachment)
+{
+	AddAccess(_pass, _attachment, ACCESS_TYPE::DEPTH_READ);
+}
+
+
+
+void RenderGraph::ReadInputAttachment(RenderGraphPass _pass, RenderGraphAttachment _attachment)
+{
+	AddAccess(_pass, _attachment, ACCESS_TYPE::INPUT_READ);
+}
+
+
+
+void RenderGraph::Compile()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_GRAPH, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_GRAPH, "Compiling Render Graph\n");
+
+	if (compiled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Render graph has already been compiled\n");
+		throw std::runtime_error("");
+	}
+
+	//Every read must have been written by an earlier pass
+	std::vector<bool> written(attachments.size(), false);
+	for (const Pass& pass : passes)
+	{
+		for (const Access& access : pass.accesses)
+		{
+			if (!IsWrite(access.type) && !written[access.attachment])
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" reads attachment \"" + attachments[access.attachment].name + "\" before any pass writes to it\n");
+				throw std::runtime_error("");
+			}
+		}
+		for (const Access& access : pass.accesses)
+		{
+			if (IsWrite(access.type))
+			{
+				written[access.attachment] = true;
+			}
+		}
+	}
+
+	CullPasses();
+	AliasAttachments();
+	BuildSubpasses();
+	BuildDependencies();
+
+	renderPassDesc.attachmentCount = static_cast<std::uint32_t>(attachmentDescriptions.size());
+	renderPassDesc.attachments = attachmentDescriptions.data();
+	renderPassDesc.attachmentFormats = attachmentFormats.data();
+	renderPassDesc.attachmentTypes = attachmentTypes.data();
+	renderPassDesc.subpassCount = static_cast<std::uint32_t>(subpasses.size());
+	renderPassDesc.subpasses = subpasses.data();
+	renderPassDesc.dependencyCount = static_cast<std::uint32_t>(dependencies.size());
+	renderPassDesc.dependencies = dependencies.data();
+	compiled = true;
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_GRAPH, "  " + std::to_string(passes.size()) + " passes -> " + std::to_string(subpasses.size()) + " subpasses, " + std::to_string(attachments.size()) + " attachments -> " + std::to_string(attachmentDescriptions.size()) + " framebuffer attachments, " + std::to_string(dependencies.size()) + " dependencies\n");
+}
+
+
+
+const VKRenderPassCleanDesc& RenderGraph::GetRenderPassDesc() const
+{
+	if (!compiled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Render graph must be compiled before its render pass description can be retrieved\n");
+		throw std::runtime_error("");
+	}
+	return renderPassDesc;
+}
+
+
+
+bool RenderGraph::IsCulled(RenderGraphPass _pass) const
+{
+	return GetSubpassIndex(_pass) == UINT32_MAX;
+}
+
+
+
+std::uint32_t RenderGraph::GetSubpassIndex(RenderGraphPass _pass) const
+{
+	return (_pass.index < passes.size()) ? passes[_pass.index].subpass : UINT32_MAX;
+}
+
+
+
+std::uint32_t RenderGraph::GetAttachmentIndex(RenderGraphAttachment _attachment) const
+{
+	return (_attachment.index < attachments.size()) ? attachments[_attachment.index].framebufferIndex : UINT32_MAX;
+}
+
+
+
+std::uint32_t RenderGraph::GetClearValueCount() const
+{
+	return static_cast<std::uint32_t>(clearValues.size());
+}
+
+
+
+VkClearValue* RenderGraph::GetClearValues()
+{
+	return clearValues.data();
+}
+
+
+
+void RenderGraph::AddAccess(RenderGraphPass _pass, RenderGraphAttachment _attachment, ACCESS_TYPE _type)
+{
+	if (compiled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attempted to declare an access after the render graph was compiled\n");
+		throw std::runtime_error("");
+	}
+	if (_pass.index >= passes.size() || _attachment.index >= attachments.size())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Attempted to declare an access with an invalid pass or attachment\n");
+		throw std::runtime_error("");
+	}
+
+	Pass& pass{ passes[_pass.index] };
+	const Attachment& attachment{ attachments[_attachment.index] };
+	const bool depthAccess{ _type == ACCESS_TYPE::DEPTH_WRITE || _type == ACCESS_TYPE::DEPTH_READ };
+
+	//The attachment's type decides which usage flags its image is created with, so it has to support the access
+	if (depthAccess && !IsDepth(attachment.type))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" uses colour attachment \"" + attachment.name + "\" as a depth attachment\n");
+		throw std::runtime_error("");
+	}
+	if (_type == ACCESS_TYPE::COLOUR_WRITE && IsDepth(attachment.type))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" uses depth attachment \"" + attachment.name + "\" as a colour attachment\n");
+		throw std::runtime_error("");
+	}
+	if (_type == ACCESS_TYPE::INPUT_READ && attachment.type != FORMAT_TYPE::COLOUR_INPUT_ATTACHMENT && attachment.type != FORMAT_TYPE::DEPTH_INPUT_ATTACHMENT)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" reads attachment \"" + attachment.name + "\" as an input attachment but it isn't of type COLOUR_INPUT_ATTACHMENT or DEPTH_INPUT_ATTACHMENT\n");
+		throw std::runtime_error("");
+	}
+
+	for (const Access& access : pass.accesses)
+	{
+		if (access.attachment == _attachment.index)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" accesses attachment \"" + attachment.name + "\" more than once\n");
+			throw std::runtime_error("");
+		}
+		if (depthAccess && (access.type == ACCESS_TYPE::DEPTH_WRITE || access.type == ACCESS_TYPE::DEPTH_READ))
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "Pass \"" + pass.name + "\" already has a depth attachment\n");
+			throw std::runtime_error("");
+		}
+	}
+
+	pass.accesses.push_back(Access{ _attachment.index, _type });
+}
+
+
+
+void RenderGraph::CullPasses()
+{
+	//Walk backwards from the swapchain - a pass is kept if it writes an attachment a kept pass (or the presentation engine) needs
+	//A kept pass needs everything it reads, including the depth it tests against
+	std::vector<bool> needed(attachments.size(), false);
+	needed[0] = true;
+	std::vector<bool> kept(passes.size(), false);
+	for (std::size_t i{ passes.size() }; i-- > 0;)
+	{
+		for (const Access& access : passes[i].accesses)
+		{
+			if (IsWrite(access.type) && needed[access.attachment])
+			{
+				kept[i] = true;
+				break;
+			}
+		}
+		if (!kept[i])
+		{
+			logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_GRAPH, "  Culling pass \"" + passes[i].name + "\" (doesn't contribute to the swapchain image)\n");
+			continue;
+		}
+		for (const Access& access : passes[i].accesses)
+		{
+			if (access.type != ACCESS_TYPE::COLOUR_WRITE)
+			{
+				needed[access.attachment] = true;
+			}
+		}
+	}
+
+	//Kept passes become subpasses in declaration order
+	for (std::size_t i{ 0 }; i<passes.size(); ++i)
+	{
+		if (kept[i])
+		{
+			passes[i].subpass = static_cast<std::uint32_t>(subpassPasses.size());
+			subpassPasses.push_back(static_cast<std::uint32_t>(i));
+		}
+	}
+	if (subpassPasses.empty())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_GRAPH, "No pass writes to the swapchain attachment\n");
+		throw std::runtime_error("");
+	}
+
+	//Lifetimes only span the kept passes
+	for (Attachment& attachment : attachments)
+	{
+		attachment.firstSubpass = UINT32_MAX;
+		attachment.lastSubpass = 0;
+		attachment.framebufferIndex = UINT32_MAX;
+	}
+	for (std::uint32_t subpass{ 0 }; subpass<subpassPasses.size(); ++subpass)
+	{
+		for (const Access& access : passes[subpassPasses[subpass]].accesses)
+		{
+			Attachment& attachment{ attachments[access.attachment] };
+			attachment.firstSubpass = std::min(attachment.firstSubpass, subpass);
+			attachment.lastSubpass = std::max(attachment.lastSubpass, subpass);
+		}
+	}
+}
+
+
+
+void RenderGraph::AliasAttachments()
+{
+	//Visit attachments in the order their lifetimes start - ties keep declaration order
+	std::vector<std::uint32_t> order;
+	for (std::uint32_t i{ 1 }; i<attachments.size(); ++i)
+	{
+		if (attachments[i].firstSubpass != UINT32_MAX)
+		{
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](std::uint32_t _a, std::uint32_t _b) { return attachments[_a].firstSubpass < attachments[_b].firstSubpass; });
+
+	//An attachment can take over a framebuffer attachment whose current occupant is dead by the time it's first used, as long as its image would be created identically
+	//Load ops only apply to a framebuffer attachment's first occupant, so attachments that need clearing always get their own
+	std::vector<std::uint32_t> occupants; //occupants[framebufferIndex] is the attachment currently living in it
+	std::vector<std::uint32_t> firstOccupants;
+	for (std::uint32_t i : order)
+	{
+		Attachment& attachment{ attachments[i] };
+		if (!attachment.clear)
+		{
+			for (std::uint32_t f{ 0 }; f<occupants.size(); ++f)
+			{
+				const Attachment& occupant{ attachments[occupants[f]] };
+				if (occupant.lastSubpass < attachment.firstSubpass && occupant.type == attachment.type && occupant.format == attachment.format)
+				{
+					logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_GRAPH, "  Aliasing attachment \"" + attachment.name + "\" onto \"" + occupant.name + "\" (framebuffer attachment " + std::to_string(f) + ")\n");
+					attachment.framebufferIndex = f;
+					occupants[f] = i;
+					break;
+				}
+			}
+		}
+		if (attachment.framebufferIndex == UINT32_MAX)
+		{
+			attachment.framebufferIndex = static_cast<std::uint32_t>(occupants.size());
+			occupants.push_back(i);
+			firstOccupants.push_back(i);
+		}
+	}
+	for (std::uint32_t i{ 1 }; i<attachments.size(); ++i)
+	{
+		if (attachments[i].firstSubpass == UINT32_MAX)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_GRAPH, "  Attachment \"" + attachments[i].name + "\" is unused and won't be created\n");
+		}
+	}
+
+	//Final attachment must be swapchain
+	attachments[0].framebufferIndex = static_cast<std::uint32_t>(firstOccupants.size());
+	firstOccupants.push_back(0);
+
+	//Intermediate attachments are never stored - they only need to live in tile memory for the duration of the render pass
+	attachmentDescriptions.resize(firstOccupants.size());
+	attachmentFormats.resize(firstOccupants.size());
+	attachmentTypes.resize(firstOccupants.size());
+	clearValues.resize(firstOccupants.size(), VkClearValue{});
+	for (std::size_t f{ 0 }; f<firstOccupants.size(); ++f)
+	{
+		const Attachment& attachment{ attachments[firstOccupants[f]] };
+		const bool swapchainAttachment{ attachment.type == FORMAT_TYPE::SWAPCHAIN };
+
+		VkAttachmentDescription& description{ attachmentDescriptions[f] };
+		description.flags = 0;
+		description.format = attachment.format; //Resolved by VulkanRenderManager if VK_FORMAT_UNDEFINED
+		description.samples = VK_SAMPLE_COUNT_1_BIT; //No MSAA
+		description.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.storeOp = swapchainAttachment ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //Contents are never loaded
+		description.finalLayout = swapchainAttachment ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED; //Intermediate attachments are set to their last layout in BuildSubpasses() to avoid a transition at the end of the render pass
+
+		attachmentFormats[f] = attachment.format;
+		attachmentTypes[f] = attachment.type;
+		if (attachment.clear)
+		{
+			clearValues[f] = attachment.clearValue;
+		}
+	}
+}
+
+
+
+void RenderGraph::BuildSubpasses()
+{
+	colourReferences.resize(subpassPasses.size());
+	inputReferences.resize(subpassPasses.size());
+	depthReferences.resize(subpassPasses.size(), VkAttachmentReference{ VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+	preserveAttachments.resize(subpassPasses.size());
+	for (std::uint32_t subpass{ 0 }; subpass<subpassPasses.size(); ++subpass)
+	{
+		for (const Access& access : passes[subpassPasses[subpass]].accesses)
+		{
+			const Attachment& attachment{ attachments[access.attachment] };
+			const VkAttachmentReference reference{ attachment.framebufferIndex, GetLayout(access.type, IsDepth(attachment.type)) };
+			if (access.type == ACCESS_TYPE::COLOUR_WRITE)
+			{
+				colourReferences[subpass].push_back(reference);
+			}
+			else if (access.type == ACCESS_TYPE::INPUT_READ)
+			{
+				inputReferences[subpass].push_back(reference);
+			}
+			else
+			{
+				depthReferences[subpass] = reference;
+			}
+
+			//Subpasses are visited in order, so an attachment ends the render pass in the layout of its last access
+			if (attachment.type != FORMAT_TYPE::SWAPCHAIN)
+			{
+				attachmentDescriptions[attachment.framebufferIndex].finalLayout = reference.layout;
+			}
+		}
+	}
+
+	//Attachments have to be preserved through any subpass in their lifetime that doesn't reference them, or their contents are lost
+	for (const Attachment& attachment : attachments)
+	{
+		if (attachment.firstSubpass == UINT32_MAX)
+		{
+			continue;
+		}
+		for (std::uint32_t subpass{ attachment.firstSubpass + 1 }; subpass<attachment.lastSubpass; ++subpass)
+		{
+			const std::vector<Access>& accesses{ passes[subpassPasses[subpass]].accesses };
+			const bool referenced{ std::any_of(accesses.begin(), accesses.end(), [&](const Access& _access) { return attachments[_access.attachment].framebufferIndex == attachment.framebufferIndex; }) };
+			if (!referenced)
+			{
+				preserveAttachments[subpass].push_back(attachment.framebufferIndex);
+			}
+		}
+	}
+
+	//All storage is in place - the descriptions can now point into it
+	subpasses.resize(subpassPasses.size());
+	for (std::size_t subpass{ 0 }; subpass<subpassPasses.size(); ++subpass)
+	{
+		VkSubpassDescription& description{ subpasses[subpass] };
+		description = {};
+		description.flags = 0;
+		description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		description.colorAttachmentCount = static_cast<std::uint32_t>(colourReferences[subpass].size());
+		description.pColorAttachments = colourReferences[subpass].empty() ? nullptr : colourReferences[subpass].data();
+		description.inputAttachmentCount = static_cast<std::uint32_t>(inputReferences[subpass].size());
+		description.pInputAttachments = inputReferences[subpass].empty() ? nullptr : inputReferences[subpass].data();
+		description.pDepthStencilAttachment = (depthReferences[subpass].attachment == VK_ATTACHMENT_UNUSED) ? nullptr : &depthReferences[subpass];
+		description.preserveAttachmentCount = static_cast<std::uint32_t>(preserveAttachments[subpass].size());
+		description.pPreserveAttachments = preserveAttachments[subpass].empty() ? nullptr : preserveAttachments[subpass].data();
+	}
+}
+
+
+
+void RenderGraph::BuildDependencies()
+{
+	//Track hazards per framebuffer attachment so aliased attachments are ordered against the ones they replace
+	struct AccessRecord
+	{
+		std::uint32_t subpass;
+		ACCESS_TYPE type;
+	};
+	std::vector<std::vector<AccessRecord>> readsSinceWrite(attachmentDescriptions.size());
+	std::vector<AccessRecord> lastWrites(attachmentDescriptions.size(), AccessRecord{ UINT32_MAX, ACCESS_TYPE::COLOUR_WRITE });
+	std::vector<AccessRecord> firstAccesses(attachmentDescriptions.size(), AccessRecord{ UINT32_MAX, ACCESS_TYPE::COLOUR_WRITE });
+	std::vector<AccessRecord> lastAccesses(attachmentDescriptions.size(), AccessRecord{ UINT32_MAX, ACCESS_TYPE::COLOUR_WRITE });
+
+	for (std::uint32_t subpass{ 0 }; subpass<subpassPasses.size(); ++subpass)
+	{
+		for (const Access& access : passes[subpassPasses[subpass]].accesses)
+		{
+			const std::uint32_t f{ attachments[access.attachment].framebufferIndex };
+			if (firstAccesses[f].subpass == UINT32_MAX)
+			{
+				firstAccesses[f] = AccessRecord{ subpass, access.type };
+			}
+			lastAccesses[f] = AccessRecord{ subpass, access.type };
+
+			//Read-after-write, and write-after-write when nothing has read the last write since - the last write has to be available and visible
+			//Reads in between already chain the last write to this one through their own dependencies
+			if (lastWrites[f].subpass != UINT32_MAX && (!IsWrite(access.type) || readsSinceWrite[f].empty()))
+			{
+				AddDependency(lastWrites[f].subpass, subpass, lastWrites[f].type, true, access.type);
+			}
+
+			if (IsWrite(access.type))
+			{
+				//Write-after-read - only an execution dependency is needed
+				for (const AccessRecord& read : readsSinceWrite[f])
+				{
+					AddDependency(read.subpass, subpass, read.type, false, access.type);
+				}
+				readsSinceWrite[f].clear();
+				lastWrites[f] = AccessRecord{ subpass, access.type };
+			}
+			else
+			{
+				readsSinceWrite[f].push_back(AccessRecord{ subpass, access.type });
+			}
+		}
+	}
+
+	//Every frame in flight shares the intermediate attachments, so their first use has to wait for the previous frame's last use
+	//The swapchain image instead waits on the acquire semaphore, which VulkanRenderManager waits on at the colour attachment output stage
+	for (std::uint32_t f{ 0 }; f<attachmentDescriptions.size(); ++f)
+	{
+		if (firstAccesses[f].subpass == UINT32_MAX)
+		{
+			continue;
+		}
+		if (attachmentTypes[f] == FORMAT_TYPE::SWAPCHAIN)
+		{
+			AddDependency(VK_SUBPASS_EXTERNAL, firstAccesses[f].subpass, ACCESS_TYPE::COLOUR_WRITE, false, firstAccesses[f].type);
+		}
+		else
+		{
+			AddDependency(VK_SUBPASS_EXTERNAL, firstAccesses[f].subpass, lastAccesses[f].type, IsWrite(lastAccesses[f].type), firstAccesses[f].type);
+			//The DONT_CARE store op is itself a write (at the attachment output/late fragment tests stage) even if the last access only read the attachment
+			const ACCESS_TYPE storeType{ IsDepth(attachmentTypes[f]) ? ACCESS_TYPE::DEPTH_WRITE : ACCESS_TYPE::COLOUR_WRITE };
+			AddDependency(VK_SUBPASS_EXTERNAL, firstAccesses[f].subpass, storeType, true, firstAccesses[f].type);
+		}
+	}
+}
+
+
+
+void RenderGraph::AddDependency(std::uint32_t _srcSubpass, std::uint32_t _dstSubpass, ACCESS_TYPE _srcType, bool _srcWrites, ACCESS_TYPE _dstType)
+{
+	if (_srcSubpass == _dstSubpass)
+	{
+		return;
+	}
+
+	const VkPipelineStageFlags srcStageMask{ GetStageMask(_srcType) };
+	const VkAccessFlags srcAccessMask{ _srcWrites ? GetAccessMask(_srcType, true) : 0u };
+	const VkPipelineStageFlags dstStageMask{ GetStageMask(_dstType) };
+	const VkAccessFlags dstAccessMask{ GetAccessMask(_dstType, false) };
+
+	//Merge all hazards between the same pair of subpasses into one dependency
+	for (VkSubpassDependency& dependency : dependencies)
+	{
+		if (dependency.srcSubpass == _srcSubpass && dependency.dstSubpass == _dstSubpass)
+		{
+			dependency.srcStageMask |= srcStageMask;
+			dependency.srcAccessMask |= srcAccessMask;
+			dependency.dstStageMask |= dstStageMask;
+			dependency.dstAccessMask |= dstAccessMask;
+			return;
+		}
+	}
+
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = _srcSubpass;
+	dependency.dstSubpass = _dstSubpass;
+	dependency.srcStageMask = srcStageMask;
+	dependency.dstStageMask = dstStageMask;
+	dependency.srcAccessMask = srcAccessMask;
+	dependency.dstAccessMask = dstAccessMask;
+	dependency.dependencyFlags = (_srcSubpass == VK_SUBPASS_EXTERNAL) ? 0 : VK_DEPENDENCY_BY_REGION_BIT; //Attachment accesses within the render pass are all framebuffer-local
+	dependencies.push_back(dependency);
+}
+
+
+
+bool RenderGraph::IsWrite(ACCESS_TYPE _type)
+{
+	return _type == ACCESS_TYPE::COLOUR_WRITE || _type == ACCESS_TYPE::DEPTH_WRITE;
+}
+
+
+
+bool RenderGraph::IsDepth(FORMAT_TYPE _type)
+{
+	return _type == FORMAT_TYPE::DEPTH_NO_SAMPLING || _type == FORMAT_TYPE::DEPTH_INPUT_ATTACHMENT || _type == FORMAT_TYPE::DEPTH_SAMPLED;
+}
+
+
+
+VkPipelineStageFlags RenderGraph::GetStageMask(ACCESS_TYPE _type)
+{
+	switch (_type)
+	{
+		case ACCESS_TYPE::COLOUR_WRITE:	return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		case ACCESS_TYPE::DEPTH_WRITE:	return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		case ACCESS_TYPE::DEPTH_READ:	return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		case ACCESS_TYPE::INPUT_READ:	return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		default:						return VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+	}
+}
+
+
+
+VkAccessFlags RenderGraph::GetAccessMask(ACCESS_TYPE _type, bool _writesOnly)
+{
+	switch (_type)
+	{
+		case ACCESS_TYPE::COLOUR_WRITE:	return _writesOnly ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; //Blending reads the attachment too
+		case ACCESS_TYPE::DEPTH_WRITE:	return _writesOnly ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		case ACCESS_TYPE::DEPTH_READ:	return _writesOnly ? 0 : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		case ACCESS_TYPE::INPUT_READ:	return _writesOnly ? 0 : VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		default:						return 0;
+	}
+}
+
+
+
+VkImageLayout RenderGraph::GetLayout(ACCESS_TYPE _type, bool _depth)
+{
+	switch (_type)
+	{
+		case ACCESS_TYPE::COLOUR_WRITE:	return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		case ACCESS_TYPE::DEPTH_WRITE:	return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		case ACCESS_TYPE::DEPTH_READ:	return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		case ACCESS_TYPE::INPUT_READ:	return _depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		default:						return VK_IMAGE_LAYOUT_GENERAL;
+	}
+}
+
+
+
+}
\ No newline at end of file
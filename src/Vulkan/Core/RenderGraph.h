@@ -0,0 +1,139 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "VulkanRenderManager.h"
+#include <string>
+
+//Responsible for generating the VKRenderPassCleanDesc passed to VulkanRenderManager from passes that declare which attachments they read and write
+//-Passes that don't contribute (directly or indirectly) to the swapchain image are culled
+//-Remaining passes become subpasses of one render pass so intermediate attachments can stay in tile memory (they're never stored)
+//-Attachments whose lifetimes don't overlap are aliased onto one framebuffer attachment
+//-Load/store ops, layouts, preserved attachments, and subpass dependencies are derived from the declared accesses
+namespace Neki
+{
+
+
+//Handles to attachments and passes declared on a RenderGraph
+struct RenderGraphAttachmentTag;
+using RenderGraphAttachment = Handle<RenderGraphAttachmentTag>;
+struct RenderGraphPassTag;
+using RenderGraphPass = Handle<RenderGraphPassTag>;
+
+
+class RenderGraph
+{
+public:
+	explicit RenderGraph(const VKLogger& _logger);
+
+	~RenderGraph() = default;
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	//Declare an intermediate attachment - _type and _format follow the rules of VKRenderPassCleanDesc (VK_FORMAT_UNDEFINED uses the swapchain or default depth format)
+	//Attachments read with ReadInputAttachment() must be of type COLOUR_INPUT_ATTACHMENT or DEPTH_INPUT_ATTACHMENT
+	[[nodiscard]] RenderGraphAttachment CreateAttachment(const std::string& _name, FORMAT_TYPE _type, VkFormat _format=VK_FORMAT_UNDEFINED);
+
+	//The attachment populated by the swapchain image - only passes that contribute to it are kept
+	[[nodiscard]] RenderGraphAttachment GetSwapchainAttachment() const;
+
+	//Clear _attachment to _value before its first write - attachments that aren't cleared start out undefined (and can be aliased onto earlier attachments)
+	void SetClearValue(RenderGraphAttachment _attachment, VkClearValue _value);
+
+	//Passes execute in the order they're added and can only read attachments written by earlier passes
+	//Each attachment can only be accessed once per pass
+	[[nodiscard]] RenderGraphPass AddPass(const std::string& _name);
+	void WriteColour(RenderGraphPass _pass, RenderGraphAttachment _attachment);
+	void WriteDepth(RenderGraphPass _pass, RenderGraphAttachment _attachment); //Depth test and write
+	void ReadDepth(RenderGraphPass _pass, RenderGraphAttachment _attachment); //Depth test only
+	void ReadInputAttachment(RenderGraphPass _pass, RenderGraphAttachment _attachment); //Bound to input attachment indices in the order they're read
+
+	//Cull, merge, and alias the declared passes and attachments and generate the render pass description
+	//Nothing can be declared after compiling
+	void Compile();
+
+	//The description points into the graph - the graph must outlive the construction of the VulkanRenderManager it's passed to
+	[[nodiscard]] const VKRenderPassCleanDesc& GetRenderPassDesc() const;
+	[[nodiscard]] bool IsCulled(RenderGraphPass _pass) const;
+	[[nodiscard]] std::uint32_t GetSubpassIndex(RenderGraphPass _pass) const; //UINT32_MAX if _pass was culled
+	[[nodiscard]] std::uint32_t GetAttachmentIndex(RenderGraphAttachment _attachment) const; //Framebuffer attachment index (e.g.: for VulkanRenderManager::GetFramebufferImageView()) - UINT32_MAX if unused
+	[[nodiscard]] std::uint32_t GetClearValueCount() const;
+	[[nodiscard]] VkClearValue* GetClearValues(); //One per framebuffer attachment, ready to be passed to VulkanRenderManager::StartFrame()
+
+
+private:
+	enum class ACCESS_TYPE
+	{
+		COLOUR_WRITE,
+		DEPTH_WRITE,
+		DEPTH_READ,
+		INPUT_READ,
+	};
+
+	struct Access
+	{
+		std::uint32_t attachment;
+		ACCESS_TYPE type;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<Access> accesses;
+		std::uint32_t subpass; //UINT32_MAX if culled
+	};
+
+	struct Attachment
+	{
+		std::string name;
+		FORMAT_TYPE type;
+		VkFormat format;
+		bool clear;
+		VkClearValue clearValue;
+
+		//Filled in by Compile()
+		std::uint32_t firstSubpass; //Lifetime across the non-culled passes (UINT32_MAX if unused)
+		std::uint32_t lastSubpass;
+		std::uint32_t framebufferIndex;
+	};
+
+	void AddAccess(RenderGraphPass _pass, RenderGraphAttachment _attachment, ACCESS_TYPE _type);
+	void CullPasses();
+	void AliasAttachments();
+	void BuildSubpasses();
+	void BuildDependencies();
+	void AddDependency(std::uint32_t _srcSubpass, std::uint32_t _dstSubpass, ACCESS_TYPE _srcType, bool _srcWrites, ACCESS_TYPE _dstType);
+
+	[[nodiscard]] static bool IsWrite(ACCESS_TYPE _type);
+	[[nodiscard]] static bool IsDepth(FORMAT_TYPE _type);
+	[[nodiscard]] static VkPipelineStageFlags GetStageMask(ACCESS_TYPE _type);
+	[[nodiscard]] static VkAccessFlags GetAccessMask(ACCESS_TYPE _type, bool _writesOnly);
+	[[nodiscard]] static VkImageLayout GetLayout(ACCESS_TYPE _type, bool _depth);
+
+	//Dependency injections from the application
+	const VKLogger& logger;
+
+	std::vector<Attachment> attachments; //attachments[0] is the swapchain
+	std::vector<Pass> passes;
+	std::vector<std::uint32_t> subpassPasses; //subpassPasses[subpass] is the index of the pass recorded in that subpass
+	bool compiled;
+
+	//Generated description and the storage it points into
+	VKRenderPassCleanDesc renderPassDesc;
+	std::vector<VkAttachmentDescription> attachmentDescriptions;
+	std::vector<VkFormat> attachmentFormats;
+	std::vector<FORMAT_TYPE> attachmentTypes;
+	std::vector<VkClearValue> clearValues;
+	std::vector<VkSubpassDescription> subpasses;
+	std::vector<std::vector<VkAttachmentReference>> colourReferences;
+	std::vector<std::vector<VkAttachmentReference>> inputReferences;
+	std::vector<VkAttachmentReference> depthReferences;
+	std::vector<std::vector<std::uint32_t>> preserveAttachments;
+	std::vector<VkSubpassDependency> dependencies;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
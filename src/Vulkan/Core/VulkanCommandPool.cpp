@@ -7,7 +7,7 @@ namespace Neki
 
 
 
-VulkanCommandPool::VulkanCommandPool(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VK_COMMAND_POOL_TYPE _poolType)
+VulkanCommandPool::VulkanCommandPool(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VK_COMMAND_POOL_TYPE _poolType, VkCommandPoolCreateFlags _flags)
 									: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device)
 {
 	pool = VK_NULL_HANDLE;
@@ -34,11 +34,15 @@ VulkanCommandPool::VulkanCommandPool(const VKLogger& _logger, VKDebugAllocator&
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::COMMAND_POOL, "Provided _poolType (COMPUTE) is not currently supported.\n");
 		throw std::runtime_error("");
 	}
+	else if (poolType == VK_COMMAND_POOL_TYPE::TRANSFER)
+	{
+		queueFamilyIndex = device.GetTransferQueueFamilyIndex();
+	}
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.pNext = nullptr;
 	poolInfo.queueFamilyIndex = queueFamilyIndex;
-	poolInfo.flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.flags = _flags;
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::COMMAND_POOL, "Creating command pool for queue family " + std::to_string(queueFamilyIndex) + " (" + PoolTypeToString(poolType) + ")", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkResult result{ vkCreateCommandPool(device.GetDevice(), &poolInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &pool) };
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::DEVICE, result == VK_SUCCESS ? "success" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
@@ -148,6 +152,7 @@ std::string VulkanCommandPool::PoolTypeToString(VK_COMMAND_POOL_TYPE _poolType)
 	{
 		case VK_COMMAND_POOL_TYPE::GRAPHICS:	return "GRAPHICS";
 		case VK_COMMAND_POOL_TYPE::COMPUTE:		return "COMPUTE";
+		case VK_COMMAND_POOL_TYPE::TRANSFER:	return "TRANSFER";
 		default:								return "UNDEFINED";
 	}
 }
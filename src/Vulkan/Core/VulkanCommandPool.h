@@ -17,8 +17,9 @@ namespace Neki
 	{
 		GRAPHICS = 0,
 		COMPUTE = 1,
+		TRANSFER = 2,
 		
-		MAX_ENUM = 2,
+		MAX_ENUM = 3,
 	};
 
 	class VulkanCommandPool
@@ -27,7 +28,8 @@ namespace Neki
 		explicit VulkanCommandPool(const VKLogger& _logger,
 								   VKDebugAllocator& _deviceDebugAllocator,
 								   const VulkanDevice& _device,
-								   VK_COMMAND_POOL_TYPE _poolType);
+								   VK_COMMAND_POOL_TYPE _poolType,
+								   VkCommandPoolCreateFlags _flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
 		~VulkanCommandPool();
 
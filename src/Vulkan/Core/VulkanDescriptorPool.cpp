@@ -1,6 +1,7 @@
 #include "VulkanDescriptorPool.h"
 #include "../Debug/VKLogger.h"
 #include <stdexcept>
+#include <algorithm>
 
 
 namespace Neki
@@ -20,7 +21,8 @@ VulkanDescriptorPool::VulkanDescriptorPool(const VKLogger& _logger, VKDebugAlloc
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.pNext = nullptr;
-	poolInfo.maxSets = 2;
+	poolInfo.maxSets = 0;
+	for (std::uint32_t i{ 0 }; i<poolSizeCount; ++i) { poolInfo.maxSets += _poolSizes[i].descriptorCount; } //Every set uses at least one descriptor, so this is the most that could ever be allocated
 	poolInfo.poolSizeCount = poolSizeCount;
 	poolInfo.pPoolSizes = _poolSizes;
 	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
@@ -65,7 +67,7 @@ VulkanDescriptorPool::~VulkanDescriptorPool()
 
 VkDescriptorSet VulkanDescriptorPool::AllocateDescriptorSet(VkDescriptorSetLayout& _layout)
 {
-	ownedDescriptorSetLayouts.push_back(_layout);
+	if (std::find(ownedDescriptorSetLayouts.begin(), ownedDescriptorSetLayouts.end(), _layout) == ownedDescriptorSetLayouts.end()) { ownedDescriptorSetLayouts.push_back(_layout); }
 	
 	VkDescriptorSet descriptorSet;
 
@@ -95,14 +97,18 @@ std::vector<VkDescriptorSet> VulkanDescriptorPool::AllocateDescriptorSets(std::s
 {
 	std::vector<VkDescriptorSet> descriptorSets(_count);
 
-	for (std::size_t i{ 0 }; i<_count; ++i) { ownedDescriptorSetLayouts.push_back(_layouts[i]); }
+	//The same layout may be passed more than once (e.g.: one set per frame in flight) - only take ownership of it once
+	for (std::size_t i{ 0 }; i<_count; ++i)
+	{
+		if (std::find(ownedDescriptorSetLayouts.begin(), ownedDescriptorSetLayouts.end(), _layouts[i]) == ownedDescriptorSetLayouts.end()) { ownedDescriptorSetLayouts.push_back(_layouts[i]); }
+	}
 
 	//Allocate the command buffers
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.pNext = nullptr;
 	allocInfo.descriptorPool = pool;
-	allocInfo.descriptorSetCount = 1;
+	allocInfo.descriptorSetCount = static_cast<std::uint32_t>(_count);
 	allocInfo.pSetLayouts = _layouts;
 	
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DESCRIPTOR_POOL, "Allocating " + std::to_string(_count) + " descriptor set" + std::string(_count == 1 ? "" : "s"), VK_LOGGER_WIDTH::SUCCESS_FAILURE);
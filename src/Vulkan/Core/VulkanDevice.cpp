@@ -3,6 +3,7 @@
 
 #include <format>
 #include <cstring>
+#include <algorithm>
 #include <GLFW/glfw3.h>
 
 #include "../../Utils/Strings/format.h"
@@ -42,8 +43,13 @@ VulkanDevice::VulkanDevice(const VKLogger& _logger,
 	physicalDevice = VK_NULL_HANDLE;
 	device = VK_NULL_HANDLE;
 	graphicsQueue = VK_NULL_HANDLE;
+	transferQueue = VK_NULL_HANDLE;
+	timelineSemaphoreEnabled = false;
+	memoryBudgetEnabled = false;
+	apiVersion = _apiVer;
 	CreateInstance(_apiVer, _appName, _desiredInstanceLayerCount, _desiredInstanceLayers, _desiredInstanceExtensionCount, _desiredInstanceExtensions);
 	SelectPhysicalDevice();
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 	CreateLogicalDevice(_desiredDeviceLayerCount, _desiredDeviceLayers, _desiredDeviceExtensionCount, _desiredDeviceExtensions);
 }
 
@@ -591,6 +597,30 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		throw std::runtime_error("");
 	}
 
+	//Prefer a transfer-only queue family (usually backed by a DMA engine) so uploads don't compete with rendering, otherwise settle for any non-graphics family with transfer support
+	transferQueueFamilyIndex = graphicsQueueFamilyIndex;
+	for (std::size_t i{ 0 }; i < queueFamilies.size(); ++i)
+	{
+		if (!(queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) || (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) { continue; }
+		if (!(queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT))
+		{
+			transferQueueFamilyIndex = i;
+			break;
+		}
+		if (transferQueueFamilyIndex == graphicsQueueFamilyIndex)
+		{
+			transferQueueFamilyIndex = i;
+		}
+	}
+	if (transferQueueFamilyIndex != graphicsQueueFamilyIndex)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::DEVICE, "Found dedicated transfer queue family (" + std::to_string(transferQueueFamilyIndex) + ")\n");
+	}
+	else
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Chosen device does not provide a dedicated transfer queue family - uploads will use the graphics queue\n");
+	}
+
 	//Get desired layers for chosen device
 	std::uint32_t deviceLayerCount{ 0 };
 	VkResult result{ vkEnumerateDeviceLayerProperties(physicalDevice, &deviceLayerCount, nullptr) };
@@ -656,6 +686,28 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		}
 	}
 
+	//VK_EXT_memory_budget is always enabled when available so DeviceMemoryPool can report the driver's view of heap usage - querying it requires vkGetPhysicalDeviceMemoryProperties2 (Vulkan 1.1)
+	//From here on apiVersion is the version usable on the logical device - both the instance and the device need to support it
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+	apiVersion = std::min(apiVersion, physicalDeviceProperties.apiVersion);
+	if (apiVersion >= VK_API_VERSION_1_1)
+	{
+		for (std::size_t i{ 0 }; i < deviceExtensionCount; ++i)
+		{
+			if (strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, deviceExtensions[i].extensionName) == 0)
+			{
+				deviceExtensionNamesToBeAdded.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				memoryBudgetEnabled = true;
+				break;
+			}
+		}
+	}
+	if (!memoryBudgetEnabled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME + std::string(" is not supported - memory budgets will be estimated from heap sizes\n"));
+	}
+
 	//Remove duplicates
 	std::sort(deviceExtensionNamesToBeAdded.begin(), deviceExtensionNamesToBeAdded.end(), [](const char* a, const char* b){ return std::strcmp(a,b) < 0; });
 	deviceExtensionNamesToBeAdded.erase(std::unique(deviceExtensionNamesToBeAdded.begin(), deviceExtensionNamesToBeAdded.end(), [](const char* a, const char* b) { return std::strcmp(a, b) == 0; }), deviceExtensionNamesToBeAdded.end());
@@ -694,21 +746,45 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Sampler anisotropy is not supported by this device.\n");
 	}
 
-	VkDeviceQueueCreateInfo queueCreateInfo{};
-	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueCreateInfo.pNext = nullptr;
-	queueCreateInfo.flags = 0;
-	queueCreateInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
-	queueCreateInfo.queueCount = 1;
+	//Timeline semaphores are core in Vulkan 1.2
+	if (apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+		supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+		supportedVulkan12Features.pNext = nullptr;
+		VkPhysicalDeviceFeatures2 supportedFeatures2{};
+		supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures2.pNext = &supportedVulkan12Features;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+		timelineSemaphoreEnabled = supportedVulkan12Features.timelineSemaphore == VK_TRUE;
+	}
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+	vulkan12Features.pNext = nullptr;
+	vulkan12Features.timelineSemaphore = timelineSemaphoreEnabled ? VK_TRUE : VK_FALSE;
+	if (!timelineSemaphoreEnabled)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::DEVICE, "Timeline semaphores are not supported (requires Vulkan 1.2).\n");
+	}
+
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(transferQueueFamilyIndex != graphicsQueueFamilyIndex ? 2 : 1);
 	constexpr float queuePriority{ 1.0f };
-	queueCreateInfo.pQueuePriorities = &queuePriority;
+	for (std::size_t i{ 0 }; i < queueCreateInfos.size(); ++i)
+	{
+		queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfos[i].pNext = nullptr;
+		queueCreateInfos[i].flags = 0;
+		queueCreateInfos[i].queueFamilyIndex = i == 0 ? graphicsQueueFamilyIndex : transferQueueFamilyIndex;
+		queueCreateInfos[i].queueCount = 1;
+		queueCreateInfos[i].pQueuePriorities = &queuePriority;
+	}
 
 	VkDeviceCreateInfo deviceCreateInfo{};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCreateInfo.pNext = nullptr;
+	deviceCreateInfo.pNext = timelineSemaphoreEnabled ? &vulkan12Features : nullptr;
 	deviceCreateInfo.flags = 0;
-	deviceCreateInfo.queueCreateInfoCount = 1;
-	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+	deviceCreateInfo.queueCreateInfoCount = static_cast<std::uint32_t>(queueCreateInfos.size());
+	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.enabledLayerCount = deviceLayerNamesToBeAdded.size();
 	deviceCreateInfo.ppEnabledLayerNames = deviceLayerNamesToBeAdded.data();
 	deviceCreateInfo.enabledExtensionCount = deviceExtensionNamesToBeAdded.size();
@@ -727,9 +803,10 @@ void VulkanDevice::CreateLogicalDevice(std::uint32_t _desiredDeviceLayerCount, c
 		return;
 	}
 
-	//Get the queue handle
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Getting queue handle\n");
+	//Get the queue handles
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::DEVICE, "Getting queue handles\n");
 	vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
+	vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
 }
 
 
@@ -739,6 +816,74 @@ const VkPhysicalDevice& VulkanDevice::GetPhysicalDevice() const { return physica
 const VkDevice& VulkanDevice::GetDevice() const { return device; }
 const VkQueue& VulkanDevice::GetGraphicsQueue() const { return graphicsQueue; }
 const std::size_t& VulkanDevice::GetGraphicsQueueFamilyIndex() const { return graphicsQueueFamilyIndex; }
+const VkQueue& VulkanDevice::GetTransferQueue() const { return transferQueue; }
+const std::size_t& VulkanDevice::GetTransferQueueFamilyIndex() const { return transferQueueFamilyIndex; }
+bool VulkanDevice::HasDedicatedTransferQueue() const { return transferQueueFamilyIndex != graphicsQueueFamilyIndex; }
+bool VulkanDevice::IsTimelineSemaphoreEnabled() const { return timelineSemaphoreEnabled; }
+bool VulkanDevice::IsMemoryBudgetEnabled() const { return memoryBudgetEnabled; }
+const VkPhysicalDeviceMemoryProperties& VulkanDevice::GetMemoryProperties() const { return memoryProperties; }
+std::uint32_t VulkanDevice::GetApiVersion() const { return apiVersion; }
+
+
+
+std::uint32_t VulkanDevice::FindMemoryType(std::uint32_t _memoryTypeBits, VkMemoryPropertyFlags _requiredFlags, MEMORY_USAGE_INTENT _intent) const
+{
+	//Types with these flags have special semantics and are only ever chosen if explicitly required
+	constexpr VkMemoryPropertyFlags specialFlags{ VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD | VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD };
+
+	std::uint32_t bestIndex{ UINT32_MAX };
+	std::int32_t bestScore{ INT32_MIN };
+	VkDeviceSize bestHeapSize{ 0 };
+	for (std::uint32_t i{ 0 }; i<memoryProperties.memoryTypeCount; ++i)
+	{
+		const VkMemoryPropertyFlags flags{ memoryProperties.memoryTypes[i].propertyFlags };
+		if (!(_memoryTypeBits & (1u << i))) { continue; }
+		if ((flags & _requiredFlags) != _requiredFlags) { continue; }
+		if (flags & specialFlags & ~_requiredFlags) { continue; }
+
+		const bool deviceLocal{ (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0 };
+		const bool hostVisible{ (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 };
+		const bool hostCoherent{ (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0 };
+		const bool hostCached{ (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0 };
+		std::int32_t score{ 0 };
+		switch (_intent)
+		{
+		case MEMORY_USAGE_INTENT::GPU_ONLY:
+			//Keep host-visible device-local memory (BAR) free for data the host actually writes
+			score += deviceLocal ? 100 : 0;
+			score -= hostVisible ? 10 : 0;
+			break;
+		case MEMORY_USAGE_INTENT::UPLOAD:
+			//Staging data belongs in system memory, and uncached (write-combined) memory is fastest for sequential writes
+			score += hostCoherent ? 20 : 0;
+			score -= deviceLocal ? 40 : 0;
+			score -= hostCached ? 10 : 0;
+			break;
+		case MEMORY_USAGE_INTENT::READBACK:
+			//Reading uncached memory from the host is an order of magnitude slower than reading cached memory
+			score += hostCached ? 100 : 0;
+			score += hostCoherent ? 10 : 0;
+			score -= deviceLocal ? 20 : 0;
+			break;
+		case MEMORY_USAGE_INTENT::DYNAMIC:
+			//Prefer DEVICE_LOCAL | HOST_VISIBLE (ReBAR / UMA) so the device reads the data from its own memory every draw rather than over PCIe
+			score += deviceLocal ? 100 : 0;
+			score += hostCoherent ? 20 : 0;
+			score -= hostCached ? 10 : 0;
+			break;
+		}
+
+		//Break ties with the larger heap
+		const VkDeviceSize heapSize{ memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size };
+		if (score > bestScore || (score == bestScore && heapSize > bestHeapSize))
+		{
+			bestIndex = i;
+			bestScore = score;
+			bestHeapSize = heapSize;
+		}
+	}
+	return bestIndex;
+}
 
 
 
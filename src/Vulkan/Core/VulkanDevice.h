@@ -9,11 +9,21 @@
 #include "../Debug/VKLogger.h"
 
 
-//Responsible for the initialisation, ownership, and clean shutdown of a VkInstance, VkDevice, and VkQueue
+//Responsible for the initialisation, ownership, and clean shutdown of a VkInstance, VkDevice, and its graphics and transfer VkQueues
 
 namespace Neki
 {
 
+	//How a resource's memory will be accessed - used to score memory types when more than one satisfies an allocation's required flags
+	enum class MEMORY_USAGE_INTENT : std::uint32_t
+	{
+		GPU_ONLY, //Only accessed by the device (e.g.: static meshes, textures, render targets)
+		UPLOAD, //Written sequentially by the host once, then copied from by the device (e.g.: staging buffers)
+		READBACK, //Written by the device, read back by the host (e.g.: screenshots, query results)
+		DYNAMIC, //Rewritten by the host every frame and read directly by the device (e.g.: per-frame uniforms, streamed vertices)
+	};
+
+
 	class VulkanDevice
 	{
 	public:
@@ -35,6 +45,29 @@ namespace Neki
 		[[nodiscard]] const VkQueue& GetGraphicsQueue() const;
 		[[nodiscard]] const std::size_t& GetGraphicsQueueFamilyIndex() const;
 
+		//If the device has no transfer-only queue family, these return the graphics queue and its family
+		[[nodiscard]] const VkQueue& GetTransferQueue() const;
+		[[nodiscard]] const std::size_t& GetTransferQueueFamilyIndex() const;
+
+		//True if the transfer queue belongs to a different family to the graphics queue (i.e. resources written on it need a queue family ownership transfer)
+		[[nodiscard]] bool HasDedicatedTransferQueue() const;
+
+		//True if the timelineSemaphore feature (Vulkan 1.2) was enabled on the logical device
+		[[nodiscard]] bool IsTimelineSemaphoreEnabled() const;
+
+		//True if VK_EXT_memory_budget was enabled on the logical device
+		[[nodiscard]] bool IsMemoryBudgetEnabled() const;
+
+		//The Vulkan version supported by both the instance and the logical device
+		[[nodiscard]] std::uint32_t GetApiVersion() const;
+
+		//Memory types and heaps of the physical device - queried once at device creation
+		[[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const;
+
+		//Find the best memory type allowed by _memoryTypeBits that has all of _requiredFlags for the given access pattern
+		//Returns UINT32_MAX if no memory type is suitable
+		[[nodiscard]] std::uint32_t FindMemoryType(std::uint32_t _memoryTypeBits, VkMemoryPropertyFlags _requiredFlags, MEMORY_USAGE_INTENT _intent) const;
+
 		//Finds a supported format from the list of _candidates for a given tiling and feature set
 		[[nodiscard]] VkFormat FindSupportedFormat(const std::vector<VkFormat>& _candidates, VkImageTiling _tiling, VkFormatFeatureFlags _features) const;
 		
@@ -50,11 +83,20 @@ namespace Neki
 		std::size_t physicalDeviceIndex; //Used for logging purposes only
 		VkPhysicalDevice physicalDevice;
 		VkDevice device;
+		std::uint32_t apiVersion;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
 
 		//Queue that has graphics support
 		std::size_t graphicsQueueFamilyIndex;
 		VkQueue graphicsQueue;
 
+		//Queue with transfer support only (falls back to the graphics queue if the device doesn't have one)
+		std::size_t transferQueueFamilyIndex;
+		VkQueue transferQueue;
+
+		bool timelineSemaphoreEnabled;
+		bool memoryBudgetEnabled;
+
 
 		void CreateInstance(const std::uint32_t _apiVer, const char* _appName, std::uint32_t _desiredInstanceLayerCount, const char** const _desiredInstanceLayers, std::uint32_t _desiredInstanceExtensionCount, const char** const _desiredInstanceExtensions);
 		void SelectPhysicalDevice();
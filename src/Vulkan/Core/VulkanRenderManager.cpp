@@ -3,6 +3,8 @@
 
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
 
 namespace Neki
@@ -10,22 +12,32 @@ namespace Neki
 
 
 
-VulkanRenderManager::VulkanRenderManager(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanSwapchain& _swapchain, ImageFactory& _imageFactory, VulkanCommandPool& _commandPool, std::size_t _framesInFlight, VKRenderPassCleanDesc _renderPassDesc)
-										: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), swapchain(_swapchain), imageFactory(_imageFactory), commandPool(_commandPool)
+VulkanRenderManager::VulkanRenderManager(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanSwapchain& _swapchain, ImageFactory& _imageFactory, std::size_t _framesInFlight, VKRenderPassCleanDesc _renderPassDesc, std::uint32_t _recordingThreadCount)
+										: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), swapchain(_swapchain), imageFactory(_imageFactory)
 {
 	renderPass = VK_NULL_HANDLE;
 	framesInFlight = _framesInFlight;
 	imageIndex = 0;
 	currentFrame = 0;
+	frameNumber = 0;
+	lastFrameBlockTime = 0.0;
+	currentSubpass = 0;
+	recordingThreadCount = (_recordingThreadCount == 0) ? std::max(std::thread::hardware_concurrency(), 1u) : _recordingThreadCount; //hardware_concurrency() may report 0 if it can't be determined
+	attachmentGeneration = 0;
+	swapchainNeedsRecreation = false;
+	attachmentFormats.assign(_renderPassDesc.attachmentFormats, _renderPassDesc.attachmentFormats + _renderPassDesc.attachmentCount);
+	attachmentTypes.assign(_renderPassDesc.attachmentTypes, _renderPassDesc.attachmentTypes + _renderPassDesc.attachmentCount);
 	
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Render Manager\n");
 
 	defaultDepthTextureFormat = device.FindSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 	
-	AllocateCommandBuffers();
+	CreateFrameCommandPools();
+	CreateSecondaryCommandPools();
 	CreateRenderPass(_renderPassDesc);
-	CreateSwapchainFramebuffers(_renderPassDesc);
+	CreateFramebufferAttachments();
+	CreateSwapchainFramebuffers();
 	CreateSyncObjects();
 }
 
@@ -35,6 +47,35 @@ VulkanRenderManager::~VulkanRenderManager()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER,"Shutting down VulkanRenderManager\n");
 
+	//The device is idle by now, so every retired resource can go regardless of when it was retired
+	if (!retiredResources.empty())
+	{
+		DestroyRetiredResources(UINT64_MAX);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER,"  Retired Swapchain Resources Destroyed\n");
+	}
+
+	if (!secondaryCommandPools.empty())
+	{
+		for (VkCommandPool p : secondaryCommandPools)
+		{
+			vkDestroyCommandPool(device.GetDevice(), p, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER,"  Secondary Command Pools (and all allocated command buffers) Destroyed\n");
+	}
+	secondaryCommandPools.clear();
+	secondaryCommandBuffers.clear();
+
+	if (!frameCommandPools.empty())
+	{
+		for (VkCommandPool p : frameCommandPools)
+		{
+			vkDestroyCommandPool(device.GetDevice(), p, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER,"  Frame Command Pools (and all allocated command buffers) Destroyed\n");
+	}
+	frameCommandPools.clear();
+	commandBuffers.clear();
+
 	if (!inFlightFences.empty())
 	{
 		for (VkFence& f : inFlightFences)
@@ -149,13 +190,44 @@ VkSubpassDescription VulkanRenderManager::GetDefaultSubpassDescription(VkAttachm
 
 
 
-void VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkClearValue* _clearValues)
+bool VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkClearValue* _clearValues, VkSubpassContents _contents)
 {
+	const std::chrono::steady_clock::time_point blockStart{ std::chrono::steady_clock::now() };
+
 	//Wait for previous rendering for the frame of this frame index to finish before overwriting the command buffer for the frame
 	vkWaitForFences(device.GetDevice(), 1, &(inFlightFences[currentFrame]), VK_TRUE, UINT64_MAX);
 
+	//Every frame up to and including the one that last used this frame index has now completed, so anything retired before then can be destroyed
+	DestroyRetiredResources(frameNumber + 1 > framesInFlight ? frameNumber + 1 - framesInFlight : 0);
+
+	if (swapchainNeedsRecreation || swapchain.WasResized())
+	{
+		if (!RecreateSwapchain()) { return false; }
+	}
+
 	//Get index of the next image in the swapchain and pass a semaphore to be signalled once the image is available (no longer being read for presentation)
-	vkAcquireNextImageKHR(device.GetDevice(), swapchain.GetSwapchain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result{ vkAcquireNextImageKHR(device.GetDevice(), swapchain.GetSwapchain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex) };
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		//No image was acquired (so the semaphore won't be signalled) - recreate and try again
+		if (!RecreateSwapchain()) { return false; }
+		result = vkAcquireNextImageKHR(device.GetDevice(), swapchain.GetSwapchain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	}
+	if (result == VK_SUBOPTIMAL_KHR)
+	{
+		//An image was still acquired - render to it and recreate before the next frame
+		swapchainNeedsRecreation = true;
+	}
+	else if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		swapchainNeedsRecreation = true;
+		return false;
+	}
+	else if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to acquire swapchain image (" + std::to_string(result) + ")\n");
+		throw std::runtime_error("");
+	}
 
 	//Check if a previous frame is using this image (i.e. there is its fence to wait on)
 	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
@@ -163,6 +235,8 @@ void VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkCle
 		vkWaitForFences(device.GetDevice(), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
 	}
 	
+	lastFrameBlockTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+	
 	//Mark the image as now being in use by this frame - tying its synchronisation to this frame's fence
 	//The next frame that wants to use this image will have to wait for this frame to finish rendering to it so as to not overwrite
 	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
@@ -171,8 +245,17 @@ void VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkCle
 	vkResetFences(device.GetDevice(), 1, &(inFlightFences[currentFrame]));
 
 	
+	//This frame's command buffers have finished executing - reset their pools wholesale
+	vkResetCommandPool(device.GetDevice(), frameCommandPools[currentFrame], 0);
+	for (std::uint32_t i{ 0 }; i<recordingThreadCount; ++i)
+	{
+		const std::size_t poolIndex{ currentFrame * recordingThreadCount + i };
+		vkResetCommandPool(device.GetDevice(), secondaryCommandPools[poolIndex], 0);
+		secondaryCommandBuffersUsed[poolIndex] = 0;
+	}
+
+	
 	//Start recording the command buffer
-	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.pNext = nullptr;
@@ -196,7 +279,18 @@ void VulkanRenderManager::StartFrame(std::uint32_t _clearValueCount, const VkCle
 	renderPassInfo.clearValueCount = _clearValueCount;
 	renderPassInfo.pClearValues = _clearValues;
 	
-	vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, _contents);
+	currentSubpass = 0;
+
+	return true;
+}
+
+
+
+void VulkanRenderManager::NextSubpass(VkSubpassContents _contents)
+{
+	vkCmdNextSubpass(commandBuffers[currentFrame], _contents);
+	++currentSubpass;
 }
 
 
@@ -246,20 +340,118 @@ void VulkanRenderManager::SubmitAndPresent()
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = nullptr;
 
-	vkQueuePresentKHR(device.GetGraphicsQueue(), &presentInfo);
+	const VkResult result{ vkQueuePresentKHR(device.GetGraphicsQueue(), &presentInfo) };
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	{
+		swapchainNeedsRecreation = true;
+	}
+	else if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to present swapchain image (" + std::to_string(result) + ")\n");
+		throw std::runtime_error("");
+	}
 	
 	
+	++frameNumber;
 	currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
 
 
+VkCommandBuffer VulkanRenderManager::BeginSecondaryCommandBuffer(std::uint32_t _threadIndex)
+{
+	if (_threadIndex >= recordingThreadCount)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Thread index " + std::to_string(_threadIndex) + " is out of range (recording thread count: " + std::to_string(recordingThreadCount) + ")\n");
+		throw std::runtime_error("");
+	}
+
+	//Only this thread index touches its pool's bookkeeping, so no locking is needed
+	const std::size_t poolIndex{ currentFrame * recordingThreadCount + _threadIndex };
+	std::vector<VkCommandBuffer>& buffers{ secondaryCommandBuffers[poolIndex] };
+	if (secondaryCommandBuffersUsed[poolIndex] == buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+		allocInfo.commandPool = secondaryCommandPools[poolIndex];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer buffer;
+		if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &buffer) != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to allocate secondary command buffer\n");
+			throw std::runtime_error("");
+		}
+		buffers.push_back(buffer);
+	}
+	const VkCommandBuffer commandBuffer{ buffers[secondaryCommandBuffersUsed[poolIndex]++] };
+
+	//Inherit the current subpass (passing the framebuffer too lets the driver optimise for it)
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = nullptr;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = currentSubpass;
+	inheritanceInfo.framebuffer = swapchainFramebuffers[imageIndex];
+	inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+	inheritanceInfo.queryFlags = 0;
+	inheritanceInfo.pipelineStatistics = 0;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to begin secondary command buffer\n");
+		throw std::runtime_error("");
+	}
+
+	return commandBuffer;
+}
+
+
+
+void VulkanRenderManager::EndSecondaryCommandBuffer(VkCommandBuffer _commandBuffer)
+{
+	if (vkEndCommandBuffer(_commandBuffer) != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to end secondary command buffer\n");
+		throw std::runtime_error("");
+	}
+}
+
+
+
+void VulkanRenderManager::ExecuteSecondaryCommandBuffers(std::uint32_t _count, const VkCommandBuffer* _commandBuffers)
+{
+	vkCmdExecuteCommands(commandBuffers[currentFrame], _count, _commandBuffers);
+}
+
+
+
 VkCommandBuffer VulkanRenderManager::GetCurrentCommandBuffer()
 {
 	return commandBuffers[currentFrame];
 }
 
 
+
+std::size_t VulkanRenderManager::GetCurrentFrame()
+{
+	return currentFrame;
+}
+
+
+
+std::size_t VulkanRenderManager::GetFramesInFlight()
+{
+	return framesInFlight;
+}
+
+
 VkRenderPass VulkanRenderManager::GetRenderPass()
 {
 	return renderPass;
@@ -274,10 +466,93 @@ VkImageView VulkanRenderManager::GetFramebufferImageView(std::size_t _index)
 
 
 
-void VulkanRenderManager::AllocateCommandBuffers()
+std::uint32_t VulkanRenderManager::GetRecordingThreadCount() const
+{
+	return recordingThreadCount;
+}
+
+
+
+double VulkanRenderManager::GetLastFrameBlockTime() const
 {
-	commandBuffers.resize(framesInFlight);
-	commandBuffers = commandPool.AllocateCommandBuffers(framesInFlight);
+	return lastFrameBlockTime;
+}
+
+
+
+std::uint64_t VulkanRenderManager::GetAttachmentGeneration() const
+{
+	return attachmentGeneration;
+}
+
+
+
+void VulkanRenderManager::CreateFrameCommandPools()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Frame Command Pools\n");
+
+	//Transient and without VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT - the pool is the unit of reset
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+
+	frameCommandPools.resize(framesInFlight, VK_NULL_HANDLE);
+	commandBuffers.resize(framesInFlight, VK_NULL_HANDLE);
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating " + std::to_string(framesInFlight) + " command pools (1 primary command buffer per frame in flight)", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	for (std::size_t i{ 0 }; i<framesInFlight; ++i)
+	{
+		VkResult result{ vkCreateCommandPool(device.GetDevice(), &poolInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &frameCommandPools[i]) };
+		if (result == VK_SUCCESS)
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.pNext = nullptr;
+			allocInfo.commandPool = frameCommandPools[i];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+			result = vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &commandBuffers[i]);
+		}
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "failure (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+			throw std::runtime_error("");
+		}
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER, "success\n", VK_LOGGER_WIDTH::DEFAULT, false);
+}
+
+
+
+void VulkanRenderManager::CreateSecondaryCommandPools()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Secondary Command Pools\n");
+
+	//Transient - buffers only live for one frame and are reset together with their pool
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+
+	const std::size_t poolCount{ framesInFlight * recordingThreadCount };
+	secondaryCommandPools.resize(poolCount, VK_NULL_HANDLE);
+	secondaryCommandBuffers.resize(poolCount);
+	secondaryCommandBuffersUsed.resize(poolCount, 0);
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating " + std::to_string(poolCount) + " command pools (" + std::to_string(recordingThreadCount) + " recording thread" + std::string(recordingThreadCount == 1 ? "" : "s") + " per frame)", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	for (std::size_t i{ 0 }; i<poolCount; ++i)
+	{
+		const VkResult result{ vkCreateCommandPool(device.GetDevice(), &poolInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &secondaryCommandPools[i]) };
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "failure (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+			throw std::runtime_error("");
+		}
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER, "success\n", VK_LOGGER_WIDTH::DEFAULT, false);
 }
 
 
@@ -336,29 +611,29 @@ void VulkanRenderManager::CreateRenderPass(VKRenderPassCleanDesc& _renderPassDes
 
 
 
-void VulkanRenderManager::CreateSwapchainFramebuffers(const VKRenderPassCleanDesc& _renderPassDesc)
+void VulkanRenderManager::CreateFramebufferAttachments()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Swapchain Framebuffers\n");
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Framebuffer Attachments\n");
 
 	//Final attachment must be swapchain
-	if (_renderPassDesc.attachmentTypes[_renderPassDesc.attachmentCount-1] != FORMAT_TYPE::SWAPCHAIN)
+	if (attachmentTypes.back() != FORMAT_TYPE::SWAPCHAIN)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Final image in framebuffer description must be of type SWAPCHAIN");
 		throw std::runtime_error("");
 	}
 	//Final attachment must be VK_FORMAT_UNDEFINED as per the Neki standard - enforcing this prevents accidents
-	if (_renderPassDesc.attachmentFormats[_renderPassDesc.attachmentCount-1] != VK_FORMAT_UNDEFINED)
+	if (attachmentFormats.back() != VK_FORMAT_UNDEFINED)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Final image in framebuffer description must be of format UNDEFINED");
 	}
 
 	//Create images and image views based on provided description
 	//Ignore last attachment because the Neki standard states it must be the swapchain - swapchain image is populated further down
-	for (std::size_t i{ 0 }; i<_renderPassDesc.attachmentCount-1; ++i)
+	for (std::size_t i{ 0 }; i<attachmentTypes.size()-1; ++i)
 	{
-		const FORMAT_TYPE formatType{ _renderPassDesc.attachmentTypes[i] };
-		VkFormat format{ _renderPassDesc.attachmentFormats[i] };
+		const FORMAT_TYPE formatType{ attachmentTypes[i] };
+		VkFormat format{ attachmentFormats[i] };
 		if (format == VK_FORMAT_UNDEFINED)
 		{
 			const bool useSwapchainFormat{ formatType == FORMAT_TYPE::SWAPCHAIN || formatType == FORMAT_TYPE::COLOUR_INPUT_ATTACHMENT || formatType == FORMAT_TYPE::COLOUR_SAMPLED };
@@ -369,7 +644,7 @@ void VulkanRenderManager::CreateSwapchainFramebuffers(const VKRenderPassCleanDes
 		{
 			const VkImageUsageFlagBits flag{ (formatType == FORMAT_TYPE::COLOUR_INPUT_ATTACHMENT) ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT };
 			framebufferImages.push_back(imageFactory.AllocateImage(swapchain.GetSwapchainExtent(), format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | flag));
-			framebufferImageViews.push_back(imageFactory.CreateImageView(framebufferImages[i], format, VK_IMAGE_ASPECT_COLOR_BIT));
+			framebufferImageViewHandles.push_back(imageFactory.CreateImageView(framebufferImages.back(), format, VK_IMAGE_ASPECT_COLOR_BIT));
 		}
 		else if (formatType == FORMAT_TYPE::DEPTH_NO_SAMPLING || formatType == FORMAT_TYPE::DEPTH_INPUT_ATTACHMENT || formatType == FORMAT_TYPE::DEPTH_SAMPLED)
 		{
@@ -382,10 +657,23 @@ void VulkanRenderManager::CreateSwapchainFramebuffers(const VKRenderPassCleanDes
 				const VkImageUsageFlagBits flag{ (formatType == FORMAT_TYPE::DEPTH_INPUT_ATTACHMENT) ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT };
 				framebufferImages.push_back(imageFactory.AllocateImage(swapchain.GetSwapchainExtent(), format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | flag));	
 			}
-			framebufferImageViews.push_back(imageFactory.CreateImageView(framebufferImages[i], format, VK_IMAGE_ASPECT_DEPTH_BIT));
+			framebufferImageViewHandles.push_back(imageFactory.CreateImageView(framebufferImages.back(), format, VK_IMAGE_ASPECT_DEPTH_BIT));
 		}
 	}
 
+	for (const ImageViewHandle& handle : framebufferImageViewHandles)
+	{
+		framebufferImageViews.push_back(imageFactory.GetImageView(handle));
+	}
+}
+
+
+
+void VulkanRenderManager::CreateSwapchainFramebuffers()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Creating Swapchain Framebuffers\n");
+
 	//Create a framebuffer for each swapchain image
 	//Each framebuffer should contain all the provided attachments as well as the corresponding swapchain image
 	swapchainFramebuffers.resize(swapchain.GetSwapchainSize());
@@ -398,7 +686,7 @@ void VulkanRenderManager::CreateSwapchainFramebuffers(const VKRenderPassCleanDes
 		framebufferInfo.pNext = nullptr;
 		framebufferInfo.flags = 0;
 		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = _renderPassDesc.attachmentCount;
+		framebufferInfo.attachmentCount = static_cast<std::uint32_t>(attachmentTypes.size());
 		framebufferInfo.pAttachments = framebufferImageViews.data();
 		framebufferInfo.width = swapchain.GetSwapchainExtent().width;
 		framebufferInfo.height = swapchain.GetSwapchainExtent().height;
@@ -427,9 +715,8 @@ void VulkanRenderManager::CreateSyncObjects()
 
 	//Allow for MAX_FRAMES_IN_FLIGHT frames to be in-flight at once
 	imageAvailableSemaphores.resize(framesInFlight);
-	renderFinishedSemaphores.resize(swapchain.GetSwapchainSize());
 	inFlightFences.resize(framesInFlight);
-	imagesInFlight.resize(swapchain.GetSwapchainSize());
+	CreateRenderFinishedSemaphores();
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -441,6 +728,31 @@ void VulkanRenderManager::CreateSyncObjects()
 	fenceInfo.pNext = nullptr;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
+	for (std::size_t i{ 0 }; i<framesInFlight; ++i)
+	{
+		if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+			vkCreateFence(device.GetDevice(), &fenceInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &inFlightFences[i]) != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to create per-frame sync objects\n");
+			throw std::runtime_error("");
+		}
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER, "Successfully created sync objects for " + std::to_string(framesInFlight) + " frames\n");
+}
+
+
+
+void VulkanRenderManager::CreateRenderFinishedSemaphores()
+{
+	//One per swapchain image, so these (and imagesInFlight) are remade whenever the swapchain is
+	renderFinishedSemaphores.resize(swapchain.GetSwapchainSize());
+	imagesInFlight.assign(swapchain.GetSwapchainSize(), VK_NULL_HANDLE);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = nullptr;
+	semaphoreInfo.flags = 0;
+
 	for (std::size_t i{ 0 }; i<swapchain.GetSwapchainSize(); ++i)
 	{
 		if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &renderFinishedSemaphores[i]) != VK_SUCCESS)
@@ -450,16 +762,77 @@ void VulkanRenderManager::CreateSyncObjects()
 		}
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER, "Successfully created sync objects for " + std::to_string(swapchain.GetSwapchainSize()) + " images\n");
-	for (std::size_t i{ 0 }; i<framesInFlight; ++i)
+}
+
+
+
+bool VulkanRenderManager::RecreateSwapchain()
+{
+	const VkExtent2D oldExtent{ swapchain.GetSwapchainExtent() };
+	if (!swapchain.Recreate(frameNumber))
 	{
-		if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(device.GetDevice(), &fenceInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &inFlightFences[i]) != VK_SUCCESS)
+		//Minimised - keep trying each frame until there's something to present to again
+		swapchainNeedsRecreation = true;
+		return false;
+	}
+	swapchainNeedsRecreation = false;
+
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::RENDER_MANAGER, "Recreating Swapchain Resources\n");
+
+	//Frames in flight may still be using the old framebuffers, semaphores, and attachments - retire them rather than waiting for the device to go idle
+	RetiredFrameResources retired{};
+	retired.retireFrame = frameNumber;
+	retired.framebuffers = std::move(swapchainFramebuffers);
+	retired.semaphores = std::move(renderFinishedSemaphores);
+	swapchainFramebuffers.clear();
+	renderFinishedSemaphores.clear();
+
+	//Size-dependent attachments only need remaking if the extent has actually changed
+	const VkExtent2D newExtent{ swapchain.GetSwapchainExtent() };
+	if (newExtent.width != oldExtent.width || newExtent.height != oldExtent.height)
+	{
+		retired.images = std::move(framebufferImages);
+		retired.imageViews = std::move(framebufferImageViewHandles);
+		framebufferImages.clear();
+		framebufferImageViewHandles.clear();
+		framebufferImageViews.clear();
+		CreateFramebufferAttachments();
+		++attachmentGeneration;
+	}
+	else
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::RENDER_MANAGER, "Extent unchanged - keeping framebuffer attachments\n");
+	}
+	retiredResources.push_back(std::move(retired));
+
+	//Framebuffers reference the swapchain's image views, which are new even if the extent isn't
+	CreateSwapchainFramebuffers();
+	CreateRenderFinishedSemaphores();
+
+	return true;
+}
+
+
+
+void VulkanRenderManager::DestroyRetiredResources(std::uint64_t _completedFrameCount)
+{
+	std::erase_if(retiredResources, [&](RetiredFrameResources& _retired)
+	{
+		if (_retired.retireFrame > _completedFrameCount) { return false; }
+		for (VkFramebuffer f : _retired.framebuffers)
 		{
-			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::RENDER_MANAGER, "Failed to create per-frame sync objects\n");
-			throw std::runtime_error("");
+			vkDestroyFramebuffer(device.GetDevice(), f, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 		}
-	}
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::RENDER_MANAGER, "Successfully created sync objects for " + std::to_string(framesInFlight) + " frames\n");
+		for (VkSemaphore s : _retired.semaphores)
+		{
+			vkDestroySemaphore(device.GetDevice(), s, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+		for (ImageViewHandle& v : _retired.imageViews) { imageFactory.FreeImageView(v); }
+		for (ImageHandle& i : _retired.images) { imageFactory.FreeImage(i); }
+		return true;
+	});
+	swapchain.DestroyRetiredSwapchains(_completedFrameCount);
 }
 
 
@@ -1,7 +1,6 @@
 #ifndef VULKANRENDERMANAGER_H
 #define VULKANRENDERMANAGER_H
 
-#include "VulkanCommandPool.h"
 #include "VulkanSwapchain.h"
 #include "../Memory/ImageFactory.h"
 
@@ -31,7 +30,7 @@ enum class FORMAT_TYPE
 	DEPTH_SAMPLED,
 };
 
-//Passed to constructor
+//Passed to constructor - either written by hand or generated by a RenderGraph
 struct VKRenderPassCleanDesc final
 {
 	//Upon passing to VulkanRenderManager's constructor, attachmentCount attachments will be created with the corresponding attachmentFormats
@@ -56,14 +55,15 @@ struct VKRenderPassCleanDesc final
 class VulkanRenderManager
 {
 public:
+	//_recordingThreadCount is how many threads can record secondary command buffers at once - 0 uses one per hardware thread
 	explicit VulkanRenderManager(const VKLogger& _logger,
 							 VKDebugAllocator& _deviceDebugAllocator,
 							 const VulkanDevice& _device,
 							 VulkanSwapchain& _swapchain,
 							 ImageFactory& _imageFactory,
-							 VulkanCommandPool& _commandPool,
 							 std::size_t _framesInFlight,
-							 VKRenderPassCleanDesc _renderPassDesc);
+							 VKRenderPassCleanDesc _renderPassDesc,
+							 std::uint32_t _recordingThreadCount=1);
 
 	~VulkanRenderManager();
 
@@ -72,19 +72,56 @@ public:
 	[[nodiscard]] static VkAttachmentDescription GetDefaultOutputDepthAttachmentDescription();
 	[[nodiscard]] static VkSubpassDescription GetDefaultSubpassDescription(VkAttachmentReference* _colourAttachments, VkAttachmentReference* _depthStencilAttachment);
 	
-	void StartFrame(std::uint32_t _clearValueCount, const VkClearValue* _clearValues);
+	//Returns false if there's no swapchain image to render to (i.e.: the window is minimised) - skip the frame's recording and SubmitAndPresent() if so
+	//The swapchain is recreated here if it's out of date or the window has been resized
+	//Pass VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS if the first subpass will be recorded into secondary command buffers
+	[[nodiscard]] bool StartFrame(std::uint32_t _clearValueCount, const VkClearValue* _clearValues, VkSubpassContents _contents=VK_SUBPASS_CONTENTS_INLINE);
+	void NextSubpass(VkSubpassContents _contents=VK_SUBPASS_CONTENTS_INLINE);
 	void SubmitAndPresent();
 
+	//Begin a secondary command buffer that continues the current subpass (which must have been started with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+	//Every _threadIndex has its own command pool per frame in flight, so different threads can record at once as long as no two share a _threadIndex
+	//Secondary command buffers don't inherit dynamic state - set the viewport and scissor in each one
+	[[nodiscard]] VkCommandBuffer BeginSecondaryCommandBuffer(std::uint32_t _threadIndex);
+	void EndSecondaryCommandBuffer(VkCommandBuffer _commandBuffer);
+
+	//Execute _commandBuffers in order from the current frame's primary command buffer
+	void ExecuteSecondaryCommandBuffers(std::uint32_t _count, const VkCommandBuffer* _commandBuffers);
+
 	[[nodiscard]] VkCommandBuffer GetCurrentCommandBuffer();
+	[[nodiscard]] std::size_t GetCurrentFrame();
+	[[nodiscard]] std::size_t GetFramesInFlight();
 	[[nodiscard]] VkRenderPass GetRenderPass();
 	[[nodiscard]] VkImageView GetFramebufferImageView(std::size_t _index);
+	[[nodiscard]] std::uint32_t GetRecordingThreadCount() const;
+	[[nodiscard]] double GetLastFrameBlockTime() const; //Seconds the last StartFrame() spent blocked waiting on the GPU and swapchain
+	[[nodiscard]] std::uint64_t GetAttachmentGeneration() const; //Incremented whenever the framebuffer attachments are recreated (i.e.: the swapchain extent changes) - descriptors referencing GetFramebufferImageView() must be rewritten
 
 	
 private:
-	void AllocateCommandBuffers();
+	//Resources replaced by a swapchain recreation that frames in flight may still be using
+	struct RetiredFrameResources
+	{
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<VkSemaphore> semaphores;
+		std::vector<ImageHandle> images;
+		std::vector<ImageViewHandle> imageViews;
+		std::uint64_t retireFrame;
+	};
+
+	void CreateFrameCommandPools();
+	void CreateSecondaryCommandPools();
 	void CreateRenderPass(VKRenderPassCleanDesc& _renderPassDesc);
-	void CreateSwapchainFramebuffers(const VKRenderPassCleanDesc& _renderPassDesc);
+	void CreateFramebufferAttachments();
+	void CreateSwapchainFramebuffers();
 	void CreateSyncObjects();
+	void CreateRenderFinishedSemaphores();
+
+	//Returns false if the swapchain couldn't be recreated (i.e.: the window is minimised)
+	[[nodiscard]] bool RecreateSwapchain();
+
+	//Destroy every retired resource whose retireFrame is no greater than _completedFrameCount
+	void DestroyRetiredResources(std::uint64_t _completedFrameCount);
 
 	//Dependency injections from VKApp
 	const VKLogger& logger;
@@ -92,26 +129,48 @@ private:
 	const VulkanDevice& device;
 	ImageFactory& imageFactory;
 	VulkanSwapchain& swapchain;
-	VulkanCommandPool& commandPool;
 
 	VkFormat defaultDepthTextureFormat;
 	VkRenderPass renderPass;
 
+	//Copied from the VKRenderPassCleanDesc so attachments can be recreated when the swapchain extent changes
+	std::vector<VkFormat> attachmentFormats;
+	std::vector<FORMAT_TYPE> attachmentTypes;
+
 	//For framebuffer
-	std::vector<VkImage> framebufferImages; //Contains all non-swapchain images
-	std::vector<VkImageView> framebufferImageViews;
+	std::vector<ImageHandle> framebufferImages; //Contains all non-swapchain images
+	std::vector<ImageViewHandle> framebufferImageViewHandles;
+	std::vector<VkImageView> framebufferImageViews; //Resolved from framebufferImageViewHandles to be used directly as framebuffer attachments
 	std::vector<VkFramebuffer> swapchainFramebuffers;
+	std::uint64_t attachmentGeneration;
+
+	//Swapchain recreation
+	bool swapchainNeedsRecreation; //Set when acquiring or presenting reports the swapchain as out of date or suboptimal
+	std::vector<RetiredFrameResources> retiredResources;
 	
 	//Sync objects
 	std::vector<VkSemaphore> imageAvailableSemaphores; //imageAvailableSemaphores[currentFrame] signalled when the image for frame currentFrame has finished being presented and can start being overwritten again
 	std::vector<VkSemaphore> renderFinishedSemaphores; //renderFinishedSemaphores[imageIndex] signalled when rendering has finished for image imageIndex
-	std::vector<VkFence> inFlightFences; //inFlightFences[currentFrame] signalled when frame currentFrame has finished rendering to the image (commandBuffers[currentFrame] can be overwritten)
+	std::vector<VkFence> inFlightFences; //inFlightFences[currentFrame] signalled when frame currentFrame has finished rendering to the image (frameCommandPools[currentFrame] can be reset)
 	std::vector<VkFence> imagesInFlight; //imagesInFlight[imageIndex] signalled when image imageIndex has finished being rendered to (tied to inFlightFences[x] where x is the frame the image is used in)
 	std::uint32_t imageIndex; //The index of the image to be rendered to on the current frame (acquired from the swapchain)
 	std::size_t currentFrame; //The index of the current frame in flight to be rendered to
 	std::size_t framesInFlight; //The total number of frames in flight (currentFrame = (0, framesInFlight])
+	std::uint64_t frameNumber; //The total number of frames submitted
+	double lastFrameBlockTime;
 	
+	//Primary command buffers - one per frame in flight, each allocated from its own transient pool
+	//Pools are reset wholesale once their frame's fence has signalled rather than resetting individual command buffers
+	std::vector<VkCommandPool> frameCommandPools;
 	std::vector<VkCommandBuffer> commandBuffers;
+	std::uint32_t currentSubpass; //The subpass the current frame is recording - inherited by secondary command buffers
+
+	//Secondary command buffers - secondaryCommandPools[currentFrame * recordingThreadCount + threadIndex]
+	//Buffers are allocated on demand and kept, each pool being reset wholesale once its frame's fence has signalled
+	std::uint32_t recordingThreadCount;
+	std::vector<VkCommandPool> secondaryCommandPools;
+	std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
+	std::vector<std::uint32_t> secondaryCommandBuffersUsed; //How many of each pool's buffers have been handed out this frame
 };
 }
 
@@ -7,14 +7,16 @@ namespace Neki
 
 
 
-VulkanSwapchain::VulkanSwapchain(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, ImageFactory& _imageFactory, VkExtent2D _windowSize)\
-								: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), imageFactory(_imageFactory)
+VulkanSwapchain::VulkanSwapchain(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, ImageFactory& _imageFactory, VkExtent2D _windowSize, PRESENT_POLICY _presentPolicy, std::uint32_t _imageCount)\
+								: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), imageFactory(_imageFactory), presentPolicy(_presentPolicy), requestedImageCount(_imageCount)
 {
 	windowSize = _windowSize;
 	window = nullptr;
 	surface = VK_NULL_HANDLE;
 	swapchain = VK_NULL_HANDLE;
 	swapchainImageFormat = VK_FORMAT_UNDEFINED;
+	presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	resized = false;
 
 	if (windowSize.height == 0 || windowSize.width == 0)
 	{
@@ -34,6 +36,13 @@ VulkanSwapchain::~VulkanSwapchain()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::SWAPCHAIN,"Shutting down VulkanSwapchain\n");
 
+	//The device is idle by now, so every retired swapchain can go regardless of when it was retired
+	if (!retiredSwapchains.empty())
+	{
+		DestroyRetiredSwapchains(UINT64_MAX);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::SWAPCHAIN,"  Retired Swapchains Destroyed\n");
+	}
+
 	if (!swapchainImageViews.empty())
 	{
 		for (VkImageView v : swapchainImageViews)
@@ -117,12 +126,99 @@ VkImageView VulkanSwapchain::GetSwapchainImageView(std::size_t _index)
 
 
 
+VkPresentModeKHR VulkanSwapchain::GetPresentMode() const
+{
+	return presentMode;
+}
+
+
+
+bool VulkanSwapchain::WasResized() const
+{
+	return resized;
+}
+
+
+
+bool VulkanSwapchain::IsMinimised() const
+{
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	return width == 0 || height == 0;
+}
+
+
+
+bool VulkanSwapchain::Recreate(std::uint64_t _retireFrame)
+{
+	//A minimised window has a zero-sized framebuffer, which can't be presented to
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+	windowSize = { static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height) };
+	resized = false;
+
+	//CreateSwapchain() passes the current swapchain as oldSwapchain before replacing it
+	const VkSwapchainKHR oldSwapchain{ swapchain };
+	std::vector<VkImageView> oldImageViews{ std::move(swapchainImageViews) };
+	swapchainImageViews.clear();
+	CreateSwapchain();
+	CreateSwapchainImageViews();
+	retiredSwapchains.push_back(RetiredSwapchain{ oldSwapchain, std::move(oldImageViews), _retireFrame });
+
+	return true;
+}
+
+
+
+void VulkanSwapchain::DestroyRetiredSwapchains(std::uint64_t _completedFrameCount)
+{
+	std::erase_if(retiredSwapchains, [&](RetiredSwapchain& _retired)
+	{
+		if (_retired.retireFrame > _completedFrameCount) { return false; }
+		for (VkImageView v : _retired.imageViews)
+		{
+			vkDestroyImageView(device.GetDevice(), v, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		}
+		vkDestroySwapchainKHR(device.GetDevice(), _retired.swapchain, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		return true;
+	});
+}
+
+
+
+void VulkanSwapchain::FramebufferResizeCallback(GLFWwindow* _window, int _width, int _height)
+{
+	static_cast<void>(_width);
+	static_cast<void>(_height);
+	static_cast<VulkanSwapchain*>(glfwGetWindowUserPointer(_window))->resized = true;
+}
+
+
+
+std::vector<VkPresentModeKHR> VulkanSwapchain::GetPreferredPresentModes(PRESENT_POLICY _policy)
+{
+	switch (_policy)
+	{
+	case PRESENT_POLICY::LOW_LATENCY_NO_TEARING:	return { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+	case PRESENT_POLICY::LOWEST_LATENCY:			return { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+	case PRESENT_POLICY::POWER_SAVING:				return { VK_PRESENT_MODE_FIFO_KHR };
+	case PRESENT_POLICY::POWER_SAVING_RELAXED:		return { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+	}
+	return { VK_PRESENT_MODE_FIFO_KHR };
+}
+
+
+
 void VulkanSwapchain::CreateWindow()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::SWAPCHAIN, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::SWAPCHAIN, "Creating Window\n");
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); //Don't create an OpenGL context
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); //Don't let window be resized (for now)
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); //Resizes are picked up by the render manager, which recreates the swapchain in place
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::SWAPCHAIN, "Creating window", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	window = glfwCreateWindow(windowSize.width, windowSize.height, "Vulkaneki", nullptr, nullptr);
 	logger.Log(window ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::SWAPCHAIN, window ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
@@ -130,6 +226,8 @@ void VulkanSwapchain::CreateWindow()
 	{
 		throw std::runtime_error("");
 	}
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, FramebufferResizeCallback);
 }
 
 
@@ -225,22 +323,25 @@ void VulkanSwapchain::CreateSwapchain()
 																																			(presentMode == 3 ? "FIFO_RELAXED\n" : ")\n")))));
 	}
 	
-	//Choose suitable present mode
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::SWAPCHAIN, "Selecting swapchain present mode (preferred: " + std::to_string(VK_PRESENT_MODE_MAILBOX_KHR) + " - VK_PRESENT_MODE_MAILBOX_KHR)\n");
-	VkPresentModeKHR presentMode{ VK_PRESENT_MODE_FIFO_KHR }; //Guaranteed to be available
-	for (const VkPresentModeKHR& availablePresentMode : presentModes)
+	//Choose suitable present mode - the first of the policy's preferred modes that's supported
+	const std::vector<VkPresentModeKHR> preferredPresentModes{ GetPreferredPresentModes(presentPolicy) };
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::SWAPCHAIN, "Selecting swapchain present mode (preferred: " + std::to_string(preferredPresentModes.front()) + ")\n");
+	presentMode = VK_PRESENT_MODE_FIFO_KHR; //Guaranteed to be available
+	for (const VkPresentModeKHR& preferredPresentMode : preferredPresentModes)
 	{
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (std::find(presentModes.begin(), presentModes.end(), preferredPresentMode) != presentModes.end())
 		{
-			presentMode = availablePresentMode;
+			presentMode = preferredPresentMode;
 			break;
 		}
 	}
-	logger.Log(presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::SWAPCHAIN, "Selected swapchain present mode: " + std::to_string(presentMode) + "\n");
+	logger.Log(presentMode == preferredPresentModes.front() ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::SWAPCHAIN, "Selected swapchain present mode: " + std::to_string(presentMode) + "\n");
 
 
 	//Get image count
-	std::uint32_t imageCount{ capabilities.minImageCount + 1 }; //Get 1 more than minimum required by driver for a bit of wiggle room
+	//Fewer images mean less queued-up latency under FIFO, more give MAILBOX room to replace queued frames
+	std::uint32_t imageCount{ requestedImageCount == 0 ? capabilities.minImageCount + 1 : requestedImageCount }; //Default to 1 more than minimum required by driver for a bit of wiggle room
+	imageCount = std::max(imageCount, capabilities.minImageCount);
 	if (capabilities.maxImageCount >0 && imageCount > capabilities.maxImageCount) { imageCount = capabilities.maxImageCount; }
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::SWAPCHAIN, "Requesting " + std::to_string(imageCount) + " swapchain images\n");
 
@@ -262,12 +363,15 @@ void VulkanSwapchain::CreateSwapchain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = swapchain; //VK_NULL_HANDLE unless being recreated - lets the driver recycle the old swapchain's resources
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::SWAPCHAIN, "Creating swapchain", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkResult result = vkCreateSwapchainKHR(device.GetDevice(), &createInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &swapchain);
+	VkSwapchainKHR newSwapchain{ VK_NULL_HANDLE };
+	VkResult result = vkCreateSwapchainKHR(device.GetDevice(), &createInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &newSwapchain);
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::SWAPCHAIN, result == VK_SUCCESS ? "success" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
 	if (result == VK_SUCCESS)
 	{
+		swapchain = newSwapchain;
+
 		//Get number of images in swapchain
 		vkGetSwapchainImagesKHR(device.GetDevice(), swapchain, &imageCount, nullptr);
 		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::SWAPCHAIN, " (images: " + std::to_string(imageCount) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
@@ -12,15 +12,35 @@ namespace Neki
 {
 
 
+//Passed to VKAppCreationDescription to pick the swapchain's present mode
+//Each policy falls back through its listed present modes until one the surface supports is found (FIFO is always supported)
+enum class PRESENT_POLICY
+{
+	//MAILBOX -> FIFO: no tearing, and the newest finished frame is always the one shown
+	LOW_LATENCY_NO_TEARING,
+
+	//IMMEDIATE -> MAILBOX -> FIFO: lowest latency, but frames can tear
+	LOWEST_LATENCY,
+
+	//FIFO: frame rate is capped to the refresh rate and the CPU/GPU idle in between
+	POWER_SAVING,
+
+	//FIFO_RELAXED -> FIFO: as POWER_SAVING, but a frame that misses a refresh is shown straight away (tearing) rather than waiting for the next one
+	POWER_SAVING_RELAXED,
+};
+
 
 class VulkanSwapchain
 {
 public:
+	//_imageCount is clamped to what the surface supports - 0 requests one more than the surface's minimum
 	explicit VulkanSwapchain(const VKLogger& _logger,
 							 VKDebugAllocator& _deviceDebugAllocator,
 							 const VulkanDevice& _device,
 							 ImageFactory& _imageFactory,
-							 VkExtent2D _windowSize);
+							 VkExtent2D _windowSize,
+							 PRESENT_POLICY _presentPolicy=PRESENT_POLICY::LOW_LATENCY_NO_TEARING,
+							 std::uint32_t _imageCount=0);
 
 	~VulkanSwapchain();
 
@@ -31,9 +51,32 @@ public:
 	[[nodiscard]] std::size_t GetSwapchainSize() const; //Returns number of images in swapchain
 	[[nodiscard]] VkSwapchainKHR GetSwapchain();
 	[[nodiscard]] VkImageView GetSwapchainImageView(std::size_t _index);
+	[[nodiscard]] VkPresentModeKHR GetPresentMode() const;
+	[[nodiscard]] bool WasResized() const; //Whether the window's framebuffer has been resized since the swapchain was last (re)created
+	[[nodiscard]] bool IsMinimised() const; //Whether the window's framebuffer is zero-sized (nothing can be presented until it's restored)
+
+	//Recreate the swapchain in place (e.g.: after a resize or VK_ERROR_OUT_OF_DATE_KHR), passing the current one as oldSwapchain so the driver can recycle its images
+	//The old swapchain and its image views may still be in use by frames in flight, so they're retired (tagged with _retireFrame) rather than destroyed
+	//Returns false without recreating if the window's framebuffer is zero-sized (i.e.: it's minimised)
+	[[nodiscard]] bool Recreate(std::uint64_t _retireFrame);
+
+	//Destroy every retired swapchain whose _retireFrame is no greater than _completedFrameCount
+	void DestroyRetiredSwapchains(std::uint64_t _completedFrameCount);
 	
 	
 private:
+	struct RetiredSwapchain
+	{
+		VkSwapchainKHR swapchain;
+		std::vector<VkImageView> imageViews;
+		std::uint64_t retireFrame;
+	};
+
+	static void FramebufferResizeCallback(GLFWwindow* _window, int _width, int _height);
+
+	//Present modes to try for _policy, most preferred first
+	[[nodiscard]] static std::vector<VkPresentModeKHR> GetPreferredPresentModes(PRESENT_POLICY _policy);
+
 	void CreateWindow();
 	void CreateSurface();
 	void CreateSwapchain();
@@ -48,12 +91,18 @@ private:
 	VkExtent2D windowSize;
 	GLFWwindow* window;
 	VkSurfaceKHR surface;
+	bool resized;
+
+	PRESENT_POLICY presentPolicy;
+	std::uint32_t requestedImageCount;
 
 	VkSwapchainKHR swapchain;
 	VkFormat swapchainImageFormat;
 	VkExtent2D swapchainExtent;
+	VkPresentModeKHR presentMode;
 	std::vector<VkImage> swapchainImages;
 	std::vector<VkImageView> swapchainImageViews;
+	std::vector<RetiredSwapchain> retiredSwapchains;
 };
 
 
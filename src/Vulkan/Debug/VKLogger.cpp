@@ -101,6 +101,10 @@ namespace Neki
 			case VK_LOGGER_LAYER::PIPELINE:			return "[PIPELINE]";
 			case VK_LOGGER_LAYER::BUFFER_FACTORY:	return "[BUFFER FACTORY]";
 			case VK_LOGGER_LAYER::IMAGE_FACTORY:	return "[IMAGE FACTORY]";
+			case VK_LOGGER_LAYER::MEMORY_POOL:		return "[MEMORY POOL]";
+			case VK_LOGGER_LAYER::FRAME_ALLOCATOR:	return "[FRAME ALLOCATOR]";
+			case VK_LOGGER_LAYER::TEXTURE_STREAMER:	return "[TEXTURE STREAMER]";
+			case VK_LOGGER_LAYER::RENDER_GRAPH:		return "[RENDER GRAPH]";
 			case VK_LOGGER_LAYER::APPLICATION:		return "[APPLICATION]";
 			default:								return "[UNDEFINED]";
 		}
@@ -39,6 +39,10 @@ namespace Neki
 		PIPELINE,
 		BUFFER_FACTORY,
 		IMAGE_FACTORY,
+		MEMORY_POOL,
+		FRAME_ALLOCATOR,
+		TEXTURE_STREAMER,
+		RENDER_GRAPH,
 		APPLICATION,
 	};
 
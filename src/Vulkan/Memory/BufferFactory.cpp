@@ -1,6 +1,7 @@
 #include "BufferFactory.h"
 #include "../../Utils/Strings/format.h"
 
+#include <cstring>
 #include <stdexcept>
 #include <algorithm>
 
@@ -10,11 +11,43 @@ namespace Neki
 
 
 
-BufferFactory::BufferFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanCommandPool& _commandPool)
-							: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), commandPool(_commandPool)
+BufferFactory::BufferFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, DeviceMemoryPool& _memoryPool, VulkanCommandPool& _commandPool, VulkanCommandPool& _transferCommandPool, VkDeviceSize _stagingRingSize)
+							: logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), memoryPool(_memoryPool), commandPool(_commandPool), transferCommandPool(_transferCommandPool), stagingRing(_stagingRingSize)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY, "Buffer Factory Initialised\n");
+
+	uploadSemaphore = VK_NULL_HANDLE;
+	lastUploadTicket = 0;
+	handOverDstStageMask = 0;
+
+	//Uploads are tracked with a timeline semaphore
+	if (!device.IsTimelineSemaphoreEnabled())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Upload tracking requires timeline semaphores (Vulkan 1.2)\n");
+		throw std::runtime_error("");
+	}
+	VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+	semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeInfo.pNext = nullptr;
+	semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &semaphoreTypeInfo;
+	semaphoreInfo.flags = 0;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Creating upload timeline semaphore", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	const VkResult result{ vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &uploadSemaphore) };
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		throw std::runtime_error("");
+	}
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Creating " + GetFormattedSizeString(_stagingRingSize) + " staging ring\n");
+	stagingBuffer = AllocateBufferImpl(_stagingRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_USAGE_INTENT::UPLOAD);
+	stagingData = bufferAllocations[stagingBuffer.index].mappedData;
 }
 
 
@@ -22,38 +55,57 @@ BufferFactory::BufferFactory(const VKLogger& _logger, VKDebugAllocator& _deviceD
 BufferFactory::~BufferFactory()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY,"Shutting down BufferFactory\n");
-	while (!bufferMemoryMap.empty())
+	WaitForUploads();
+	if (uploadSemaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device.GetDevice(), uploadSemaphore, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		uploadSemaphore = VK_NULL_HANDLE;
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  All uploads completed and upload semaphore destroyed\n");
+	unsubmittedBuffersToFree.clear();
+	for (std::uint32_t i{ 0 }; i<bufferHandles.GetCapacity(); ++i)
 	{
-		VkBuffer buffer{ bufferMemoryMap.begin()->first };
-		FreeBufferImpl(buffer);
+		BufferHandle buffer{ bufferHandles.GetHandle(i) };
+		if (!buffer.IsNull()) { FreeBufferImpl(buffer); }
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  All buffers and underlying memory freed\n");
 }
 
 
 
-VkBuffer BufferFactory::AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags)
+BufferHandle BufferFactory::AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating 1 Buffer And Associated Memory\n");
-	return AllocateBufferImpl(_size, _usage, _sharingMode, _requiredMemFlags);
+	return AllocateBufferImpl(_size, _usage, _sharingMode, _requiredMemFlags, GetDefaultIntent(_requiredMemFlags));
 }
 
 
 
-std::vector<VkBuffer> BufferFactory::AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags)
+BufferHandle BufferFactory::AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, MEMORY_USAGE_INTENT _intent, const VkMemoryPropertyFlags _requiredMemFlags, const VkSharingMode& _sharingMode)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating 1 Buffer And Associated Memory\n");
+
+	//Every intent other than GPU_ONLY is accessed by the host
+	const VkMemoryPropertyFlags requiredMemFlags{ _requiredMemFlags | (_intent == MEMORY_USAGE_INTENT::GPU_ONLY ? 0u : static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) };
+	return AllocateBufferImpl(_size, _usage, _sharingMode, requiredMemFlags, _intent);
+}
+
+
+
+std::vector<BufferHandle> BufferFactory::AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, const VkMemoryPropertyFlags* _requiredMemFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating " + std::to_string(_count) + " Buffer" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkBuffer> buffers;
+	std::vector<BufferHandle> allocatedBuffers;
 	for (std::size_t i{ 0 }; i<_count; ++i)
 	{
-		buffers.push_back(AllocateBufferImpl(_sizes[i], _usages[i], _sharingModes[i], _requiredMemFlags[i]));
+		allocatedBuffers.push_back(AllocateBufferImpl(_sizes[i], _usages[i], _sharingModes[i], _requiredMemFlags[i], GetDefaultIntent(_requiredMemFlags[i])));
 	}
-	return buffers;
+	return allocatedBuffers;
 }
 
 
 
-void BufferFactory::FreeBuffer(VkBuffer& _buffer)
+void BufferFactory::FreeBuffer(BufferHandle& _buffer)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Freeing 1 Buffer And Associated Memory\n");
 	FreeBufferImpl(_buffer);
@@ -61,7 +113,7 @@ void BufferFactory::FreeBuffer(VkBuffer& _buffer)
 
 
 
-void BufferFactory::FreeBuffers(std::uint32_t _count, VkBuffer* _buffers)
+void BufferFactory::FreeBuffers(std::uint32_t _count, BufferHandle* _buffers)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::BUFFER_FACTORY,"Freeing " + std::to_string(_count) + " Buffer" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n");
 	for (std::size_t i{ 0 }; i<_count; ++i)
@@ -72,74 +124,654 @@ void BufferFactory::FreeBuffers(std::uint32_t _count, VkBuffer* _buffers)
 
 
 
-VkBuffer BufferFactory::TransferToDeviceLocalBuffer(VkBuffer& _buffer, bool _freeSourceBuffer, VkCommandBuffer* _commandBuffer)
+BufferHandle BufferFactory::TransferToDeviceLocalBuffer(BufferHandle& _buffer, bool _freeSourceBuffer, VkCommandBuffer* _commandBuffer)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Transferring Host-Visible Buffer To Device-Local Heap\n");
-	if ((bufferMetadataMap[_buffer].usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+	const BufferMetadata srcMetadata{ bufferMetadata[GetSlot(_buffer)] };
+	if ((srcMetadata.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the TRANSFER_SRC_BIT usage flag\n");
 		throw std::runtime_error("");
 	}
-	if ((bufferMetadataMap[_buffer].flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+	if ((srcMetadata.flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Source buffer wasn't created with the HOST_VISIBLE memory property flag\n");
 		throw std::runtime_error("");
 	}
 
 	//For new buffer, remove TRANSFER_SRC_BIT usage flag and add TRANSFER_DST_BIT
-	VkBufferUsageFlags newUsageFlags{ (bufferMetadataMap[_buffer].usage & (~VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
-	VkBuffer dstBuffer{ AllocateBufferImpl(bufferMetadataMap[_buffer].size, newUsageFlags, bufferMetadataMap[_buffer].sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	VkBufferUsageFlags newUsageFlags{ (srcMetadata.usage & (~VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+	BufferHandle dstBuffer{ AllocateBufferImpl(srcMetadata.size, newUsageFlags, srcMetadata.sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_USAGE_INTENT::GPU_ONLY) };
 
 	//Record command buffer for copy command
-	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? commandPool.AllocateCommandBuffer() : *_commandBuffer };
+	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? BeginUploadCommandBuffer() : *_commandBuffer };
+
+	VkBufferCopy region{};
+	region.size = srcMetadata.size;
+	region.srcOffset = 0;
+	region.dstOffset = 0;
+	vkCmdCopyBuffer(commandBuffer, buffers[_buffer.index], buffers[dstBuffer.index], 1, &region);
+	HandOverBuffer(dstBuffer);
+
 	if (_commandBuffer == nullptr)
 	{
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.pNext = nullptr;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		//The source buffer can't be freed until the copy has completed, so hand it over to the submission
+		if (_freeSourceBuffer)
+		{
+			unsubmittedBuffersToFree.push_back(_buffer);
+			_buffer = BufferHandle{};
+		}
+		SubmitUploadCommandBuffer(commandBuffer);
+	}
+	else if (_freeSourceBuffer)
+	{
+		FreeBuffer(_buffer);
 	}
 
+	return dstBuffer;
+}
+
+
+
+BufferHandle BufferFactory::AllocateDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkSharingMode _sharingMode, VkCommandBuffer* _commandBuffer, UploadTicket* _out_ticket)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating 1 Device-Local Buffer Through Staging Ring\n");
+	BufferHandle dstBuffer{ AllocateBufferImpl(_size, _usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_USAGE_INTENT::GPU_ONLY) };
+
+	//Copy the data straight into the persistently mapped ring
+	const StagingAllocation staging{ AllocateStagingMemory(_size, 4) };
+	memcpy(staging.mappedData, _data, static_cast<std::size_t>(_size));
+
+	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? BeginUploadCommandBuffer() : *_commandBuffer };
+
 	VkBufferCopy region{};
-	region.size = bufferMetadataMap[_buffer].size;
-	region.srcOffset = 0;
+	region.size = _size;
+	region.srcOffset = staging.offset;
 	region.dstOffset = 0;
-	vkCmdCopyBuffer(commandBuffer, _buffer, dstBuffer, 1, &region);
+	vkCmdCopyBuffer(commandBuffer, staging.buffer, buffers[dstBuffer.index], 1, &region);
+	HandOverBuffer(dstBuffer);
 
 	if (_commandBuffer == nullptr)
 	{
-		vkEndCommandBuffer(commandBuffer);
-
-		//Execute the command buffer
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pNext = nullptr;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(device.GetGraphicsQueue());
-		commandPool.FreeCommandBuffer(commandBuffer);
+		const UploadTicket ticket{ SubmitUploadCommandBuffer(commandBuffer) };
+		if (_out_ticket != nullptr) { *_out_ticket = ticket; }
 	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Upload of " + GetFormattedSizeString(_size) + " recorded from staging offset " + std::to_string(staging.offset) + "\n");
 
-	if (_freeSourceBuffer)
+	return dstBuffer;
+}
+
+
+
+std::vector<BufferHandle> BufferFactory::AllocateDeviceLocalBuffers(std::uint32_t _count, const void* const* _datas, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes, UploadTicket* _out_ticket)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY,"Allocating " + std::to_string(_count) + " Device-Local Buffer" + std::string(_count == 1 ? "" : "s") + " Through Staging Ring\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	UploadBatch batch;
+	std::vector<BufferHandle> allocatedBuffers;
+	for (std::size_t i{ 0 }; i<_count; ++i)
 	{
-		FreeBuffer(_buffer);
+		allocatedBuffers.push_back(AddBufferUpload(batch, _datas[i], _sizes[i], _usages[i], _sharingModes == nullptr ? VK_SHARING_MODE_EXCLUSIVE : _sharingModes[i]));
 	}
+	const UploadTicket ticket{ SubmitUploadBatch(batch) };
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+	return allocatedBuffers;
+}
+
+
+
+BufferHandle BufferFactory::AddBufferUpload(UploadBatch& _batch, const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkSharingMode _sharingMode)
+{
+	BufferHandle dstBuffer{ AllocateBufferImpl(_size, _usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _sharingMode, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_USAGE_INTENT::GPU_ONLY) };
+
+	const StagingAllocation staging{ AllocateStagingMemory(_size, 4) };
+	memcpy(staging.mappedData, _data, static_cast<std::size_t>(_size));
+
+	UploadBatch::BufferCopy copy{};
+	copy.srcBuffer = staging.buffer;
+	copy.dstBuffer = dstBuffer;
+	copy.region.size = _size;
+	copy.region.srcOffset = staging.offset;
+	copy.region.dstOffset = 0;
+	_batch.bufferCopies.push_back(copy);
 
 	return dstBuffer;
 }
 
 
 
-VkDeviceMemory BufferFactory::GetMemory(VkBuffer _buffer)
+void BufferFactory::AddImageCopy(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, VkExtent3D _extent, VkImageAspectFlags _aspectMask, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask, std::uint32_t _mipLevels)
+{
+	UploadBatch::ImageCopy copy{};
+	copy.srcBuffer = _staging.buffer;
+	copy.dstImage = _image;
+	copy.region.bufferOffset = _staging.offset;
+	copy.region.bufferRowLength = 0;
+	copy.region.bufferImageHeight = 0;
+	copy.region.imageSubresource.aspectMask = _aspectMask;
+	copy.region.imageSubresource.mipLevel = 0;
+	copy.region.imageSubresource.baseArrayLayer = 0;
+	copy.region.imageSubresource.layerCount = 1;
+	copy.region.imageOffset = { 0, 0, 0 };
+	copy.region.imageExtent = _extent;
+	copy.finalLayout = _finalLayout;
+	copy.dstAccessMask = _dstAccessMask;
+	copy.dstStageMask = _dstStageMask;
+	copy.mipLevels = _mipLevels;
+	_batch.imageCopies.push_back(copy);
+}
+
+
+
+void BufferFactory::AddImageMipCopies(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, VkExtent3D _extent, std::uint32_t _levelCount, const VkDeviceSize* _levelOffsets, VkImageAspectFlags _aspectMask, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask)
+{
+	AddImageCopy(_batch, _staging, _image, _extent, _aspectMask, _finalLayout, _dstAccessMask, _dstStageMask);
+	UploadBatch::ImageCopy& copy{ _batch.imageCopies.back() };
+	copy.region.bufferOffset = _staging.offset + _levelOffsets[0];
+	copy.additionalRegions.resize(_levelCount - 1);
+	for (std::uint32_t level{ 1 }; level<_levelCount; ++level)
+	{
+		VkBufferImageCopy& region{ copy.additionalRegions[level - 1] };
+		region = copy.region;
+		region.bufferOffset = _staging.offset + _levelOffsets[level];
+		region.imageSubresource.mipLevel = level;
+		region.imageExtent = { std::max(_extent.width >> level, 1u), std::max(_extent.height >> level, 1u), 1 };
+	}
+}
+
+
+
+void BufferFactory::AddImageRegionCopies(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, std::uint32_t _regionCount, const VkBufferImageCopy* _regions, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask)
+{
+	UploadBatch::ImageCopy copy{};
+	copy.srcBuffer = _staging.buffer;
+	copy.dstImage = _image;
+	copy.region = _regions[0];
+	copy.region.bufferOffset += _staging.offset;
+	copy.finalLayout = _finalLayout;
+	copy.dstAccessMask = _dstAccessMask;
+	copy.dstStageMask = _dstStageMask;
+	copy.mipLevels = 1;
+	copy.additionalRegions.assign(_regions + 1, _regions + _regionCount);
+	for (VkBufferImageCopy& region : copy.additionalRegions) { region.bufferOffset += _staging.offset; }
+	_batch.imageCopies.push_back(copy);
+}
+
+
+
+UploadTicket BufferFactory::SubmitUploadBatch(UploadBatch& _batch)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Submitting Upload Batch (" + std::to_string(_batch.bufferCopies.size()) + " buffer" + std::string(_batch.bufferCopies.size() == 1 ? "" : "s") + ", " + std::to_string(_batch.imageCopies.size()) + " image" + std::string(_batch.imageCopies.size() == 1 ? "" : "s") + ")\n");
+	VkCommandBuffer commandBuffer{ BeginUploadCommandBuffer() };
+
+	//Transition every image to TRANSFER_DST_OPTIMAL with a single barrier
+	if (!_batch.imageCopies.empty())
+	{
+		std::vector<VkImageMemoryBarrier> barriers(_batch.imageCopies.size());
+		for (std::size_t i{ 0 }; i<_batch.imageCopies.size(); ++i)
+		{
+			barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barriers[i].pNext = nullptr;
+			barriers[i].srcAccessMask = 0;
+			barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].image = _batch.imageCopies[i].dstImage;
+			barriers[i].subresourceRange.aspectMask = _batch.imageCopies[i].region.imageSubresource.aspectMask;
+			barriers[i].subresourceRange.baseMipLevel = 0;
+			barriers[i].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barriers[i].subresourceRange.baseArrayLayer = 0;
+			barriers[i].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<std::uint32_t>(barriers.size()), barriers.data());
+	}
+
+	//Record all copies back-to-back
+	for (const UploadBatch::BufferCopy& copy : _batch.bufferCopies)
+	{
+		vkCmdCopyBuffer(commandBuffer, copy.srcBuffer, GetBuffer(copy.dstBuffer), 1, &copy.region);
+		HandOverBuffer(copy.dstBuffer);
+	}
+	for (const UploadBatch::ImageCopy& copy : _batch.imageCopies)
+	{
+		vkCmdCopyBufferToImage(commandBuffer, copy.srcBuffer, copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+		if (!copy.additionalRegions.empty()) { vkCmdCopyBufferToImage(commandBuffer, copy.srcBuffer, copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<std::uint32_t>(copy.additionalRegions.size()), copy.additionalRegions.data()); }
+		if (copy.mipLevels <= 1)
+		{
+			HandOverImage(copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.finalLayout, copy.region.imageSubresource.aspectMask, copy.dstAccessMask, copy.dstStageMask);
+			continue;
+		}
+
+		//Blits need a graphics queue - hand the image over as-is and build the mip chain once the graphics queue owns it
+		HandOverImage(copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.region.imageSubresource.aspectMask, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		mipmapGenerations.push_back({ copy.dstImage, copy.region.imageExtent, copy.mipLevels, copy.region.imageSubresource.aspectMask, copy.finalLayout, copy.dstAccessMask, copy.dstStageMask });
+	}
+	_batch.bufferCopies.clear();
+	_batch.imageCopies.clear();
+
+	//All handovers are recorded as one barrier on submission
+	return SubmitUploadCommandBuffer(commandBuffer);
+}
+
+
+
+StagingAllocation BufferFactory::AllocateStagingMemory(VkDeviceSize _size, VkDeviceSize _alignment)
+{
+	CollectCompletedUploads();
+
+	StagingAllocation allocation{};
+	allocation.size = _size;
+	bool allocated{ false };
+	if (_size <= stagingRing.GetSize())
+	{
+		allocated = stagingRing.Allocate(_size, _alignment, allocation.offset);
+		while (!allocated && !pendingUploads.empty())
+		{
+			//Ring is full - wait for the oldest upload to finish and recycle its staging memory
+			logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Staging ring full - waiting on oldest in-flight upload\n");
+			WaitForUpload(pendingUploads.front().ticket);
+			allocated = stagingRing.Allocate(_size, _alignment, allocation.offset);
+		}
+	}
+
+	if (allocated)
+	{
+		allocation.buffer = buffers[stagingBuffer.index];
+		allocation.mappedData = static_cast<char*>(stagingData) + allocation.offset;
+		return allocation;
+	}
+
+	//Either the request is larger than the ring or the ring is full of unsubmitted data - fall back to a temporary buffer freed with the next submission
+	logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Staging request of " + GetFormattedSizeString(_size) + " doesn't fit in the staging ring - using a temporary staging buffer\n");
+	const BufferHandle tempBuffer{ AllocateBufferImpl(_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_USAGE_INTENT::UPLOAD) };
+	allocation.buffer = buffers[tempBuffer.index];
+	allocation.offset = 0;
+	allocation.mappedData = bufferAllocations[tempBuffer.index].mappedData;
+	unsubmittedBuffersToFree.push_back(tempBuffer);
+	return allocation;
+}
+
+
+
+VkDeviceSize BufferFactory::GetStagingRingSize() const
+{
+	return stagingRing.GetSize();
+}
+
+
+
+VkCommandBuffer BufferFactory::BeginUploadCommandBuffer()
+{
+	VkCommandBuffer commandBuffer{ transferCommandPool.AllocateCommandBuffer() };
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	return commandBuffer;
+}
+
+
+
+void BufferFactory::HandOverBuffer(BufferHandle _buffer, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask)
+{
+	const std::uint32_t slot{ GetSlot(_buffer) };
+
+	//Concurrent buffers don't have an owning queue family - the semaphore wait alone is enough
+	const bool isExclusive{ bufferMetadata[slot].sharingMode == VK_SHARING_MODE_EXCLUSIVE };
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = _dstAccessMask;
+	barrier.srcQueueFamilyIndex = isExclusive ? static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex()) : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = isExclusive ? static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex()) : VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffers[slot];
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	bufferHandOvers.push_back(barrier);
+	handOverDstStageMask |= _dstStageMask;
+}
+
+
+
+void BufferFactory::HandOverImage(VkImage _image, VkImageLayout _oldLayout, VkImageLayout _newLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = _dstAccessMask;
+	barrier.oldLayout = _oldLayout;
+	barrier.newLayout = _newLayout;
+	barrier.srcQueueFamilyIndex = static_cast<std::uint32_t>(device.GetTransferQueueFamilyIndex());
+	barrier.dstQueueFamilyIndex = static_cast<std::uint32_t>(device.GetGraphicsQueueFamilyIndex());
+	barrier.image = _image;
+	barrier.subresourceRange.aspectMask = _aspectMask;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	imageHandOvers.push_back(barrier);
+	handOverDstStageMask |= _dstStageMask;
+}
+
+
+
+UploadTicket BufferFactory::SubmitUploadCommandBuffer(VkCommandBuffer _commandBuffer)
+{
+	PendingUpload upload{};
+	upload.transferCommandBuffer = _commandBuffer;
+	upload.acquireCommandBuffer = VK_NULL_HANDLE;
+	upload.ringMarker = stagingRing.GetHeadMarker();
+	upload.buffersToFree = std::move(unsubmittedBuffersToFree);
+	unsubmittedBuffersToFree.clear();
+
+	if (device.HasDedicatedTransferQueue())
+	{
+		//Release ownership of handed over resources on the transfer queue (the destination half of a release barrier is ignored)
+		if (!bufferHandOvers.empty() || !imageHandOvers.empty())
+		{
+			std::vector<VkBufferMemoryBarrier> releaseBufferBarriers{ bufferHandOvers };
+			std::vector<VkImageMemoryBarrier> releaseImageBarriers{ imageHandOvers };
+			for (VkBufferMemoryBarrier& barrier : releaseBufferBarriers) { barrier.dstAccessMask = 0; }
+			for (VkImageMemoryBarrier& barrier : releaseImageBarriers) { barrier.dstAccessMask = 0; }
+			vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<std::uint32_t>(releaseBufferBarriers.size()), releaseBufferBarriers.data(), static_cast<std::uint32_t>(releaseImageBarriers.size()), releaseImageBarriers.data());
+		}
+		vkEndCommandBuffer(_commandBuffer);
+		upload.ticket = SubmitToUploadTimeline(device.GetTransferQueue(), _commandBuffer);
+
+		//Acquire ownership on the graphics queue once the transfer has completed (the source half of an acquire barrier is ignored)
+		if (!bufferHandOvers.empty() || !imageHandOvers.empty())
+		{
+			for (VkBufferMemoryBarrier& barrier : bufferHandOvers) { barrier.srcAccessMask = 0; }
+			for (VkImageMemoryBarrier& barrier : imageHandOvers) { barrier.srcAccessMask = 0; }
+			upload.acquireCommandBuffer = commandPool.AllocateCommandBuffer();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.pNext = nullptr;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(upload.acquireCommandBuffer, &beginInfo);
+			vkCmdPipelineBarrier(upload.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, handOverDstStageMask, 0, 0, nullptr, static_cast<std::uint32_t>(bufferHandOvers.size()), bufferHandOvers.data(), static_cast<std::uint32_t>(imageHandOvers.size()), imageHandOvers.data());
+			RecordMipmapGenerations(upload.acquireCommandBuffer);
+			vkEndCommandBuffer(upload.acquireCommandBuffer);
+			upload.ticket = SubmitToUploadTimeline(device.GetGraphicsQueue(), upload.acquireCommandBuffer);
+		}
+	}
+	else
+	{
+		//Transfer and graphics share a queue - a single barrier makes the transfer writes visible to everything submitted after this (and performs any layout transitions)
+		for (VkBufferMemoryBarrier& barrier : bufferHandOvers) { barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; }
+		for (VkImageMemoryBarrier& barrier : imageHandOvers) { barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; }
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, static_cast<std::uint32_t>(bufferHandOvers.size()), bufferHandOvers.data(), static_cast<std::uint32_t>(imageHandOvers.size()), imageHandOvers.data());
+		RecordMipmapGenerations(_commandBuffer);
+		vkEndCommandBuffer(_commandBuffer);
+		upload.ticket = SubmitToUploadTimeline(device.GetGraphicsQueue(), _commandBuffer);
+	}
+
+	bufferHandOvers.clear();
+	imageHandOvers.clear();
+	handOverDstStageMask = 0;
+
+	const UploadTicket ticket{ upload.ticket };
+	pendingUploads.push_back(std::move(upload));
+	return ticket;
+}
+
+
+
+void BufferFactory::RecordMipmapGenerations(VkCommandBuffer _commandBuffer)
+{
+	for (const MipmapGeneration& generation : mipmapGenerations)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = generation.image;
+		barrier.subresourceRange.aspectMask = generation.aspectMask;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		std::int32_t mipWidth{ static_cast<std::int32_t>(generation.extent.width) };
+		std::int32_t mipHeight{ static_cast<std::int32_t>(generation.extent.height) };
+		for (std::uint32_t i{ 1 }; i<generation.mipLevels; ++i)
+		{
+			//Make the previous level readable as a blit source
+			barrier.subresourceRange.baseMipLevel = i - 1;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			//Downsample it into this level
+			const std::int32_t nextWidth{ mipWidth > 1 ? mipWidth / 2 : 1 };
+			const std::int32_t nextHeight{ mipHeight > 1 ? mipHeight / 2 : 1 };
+			VkImageBlit blit{};
+			blit.srcSubresource.aspectMask = generation.aspectMask;
+			blit.srcSubresource.mipLevel = i - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+			blit.dstSubresource.aspectMask = generation.aspectMask;
+			blit.dstSubresource.mipLevel = i;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = 1;
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+			vkCmdBlitImage(_commandBuffer, generation.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, generation.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			//The previous level is finished with
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.newLayout = generation.finalLayout;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.dstAccessMask = generation.dstAccessMask;
+			vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, generation.dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		//The last level was only ever written to
+		barrier.subresourceRange.baseMipLevel = generation.mipLevels - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = generation.finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = generation.dstAccessMask;
+		vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, generation.dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	mipmapGenerations.clear();
+}
+
+
+
+bool BufferFactory::IsUploadComplete(UploadTicket _ticket) const
+{
+	std::uint64_t completedValue{ 0 };
+	vkGetSemaphoreCounterValue(device.GetDevice(), uploadSemaphore, &completedValue);
+	return completedValue >= _ticket;
+}
+
+
+
+void BufferFactory::WaitForUpload(UploadTicket _ticket)
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.pNext = nullptr;
+	waitInfo.flags = 0;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &uploadSemaphore;
+	waitInfo.pValues = &_ticket;
+	vkWaitSemaphores(device.GetDevice(), &waitInfo, UINT64_MAX);
+	CollectCompletedUploads();
+}
+
+
+
+void BufferFactory::WaitForUploads()
+{
+	if (pendingUploads.empty()) { return; }
+	WaitForUpload(lastUploadTicket);
+}
+
+
+
+VkSemaphore BufferFactory::GetUploadSemaphore() const
+{
+	return uploadSemaphore;
+}
+
+
+
+DefragmentationStats BufferFactory::DefragmentBuffers(VkDeviceSize _byteBudget)
+{
+	DefragmentationStats stats{};
+	CollectCompletedUploads();
+	stats.fragmentationBefore = memoryPool.GetFragmentationRatio(DEVICE_MEMORY_RESOURCE_TYPE::LINEAR);
+
+	//Buffers may still be being written to (or acquired by the graphics queue), and a previous pass's old regions haven't been released yet
+	if (!pendingUploads.empty()) { return stats; }
+
+	const std::uint32_t sourceBlock{ memoryPool.FindDefragmentationSourceBlock(DEVICE_MEMORY_RESOURCE_TYPE::LINEAR) };
+	if (sourceBlock == UINT32_MAX) { return stats; }
+
+	VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+	std::vector<RetiredBuffer> retiredBuffers;
+	for (std::uint32_t i{ 0 }; i<bufferHandles.GetCapacity(); ++i)
+	{
+		const BufferHandle handle{ bufferHandles.GetHandle(i) };
+		if (handle.IsNull() || handle == stagingBuffer) { continue; }
+		if (bufferAllocations[i].blockIndex != sourceBlock) { continue; }
+		if (bufferMetadata[i].flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) { continue; }
+		if (stats.movedBufferCount > 0 && stats.movedBytes + bufferAllocations[i].size > _byteBudget) { break; } //Always move at least one buffer so oversized buffers don't stall compaction
+
+		//Create the replacement buffer
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = bufferMetadata[i].size;
+		bufferInfo.usage = GetInternalUsage(bufferMetadata[i].usage, bufferMetadata[i].flags);
+		bufferInfo.sharingMode = bufferMetadata[i].sharingMode;
+		VkBuffer newBuffer;
+		VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &newBuffer) };
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to create relocation buffer (" + std::to_string(result) + ")\n");
+			throw std::runtime_error("");
+		}
+
+		//Sub-allocate from any other block - stop the pass if they're all full
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device.GetDevice(), newBuffer, &memRequirements);
+		DeviceMemoryAllocation newAllocation{};
+		if (!memoryPool.AllocateOutsideBlock(memRequirements, bufferAllocations[i].memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE::LINEAR, bufferAllocations[i].category, sourceBlock, newAllocation))
+		{
+			vkDestroyBuffer(device.GetDevice(), newBuffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			break;
+		}
+		result = vkBindBufferMemory(device.GetDevice(), newBuffer, newAllocation.memory, newAllocation.offset);
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to bind relocation buffer memory (" + std::to_string(result) + ")\n");
+			throw std::runtime_error("");
+		}
+
+		if (commandBuffer == VK_NULL_HANDLE)
+		{
+			commandBuffer = commandPool.AllocateCommandBuffer();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.pNext = nullptr;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+			//Earlier GPU writes to the source buffers (uploads, compute/shader writes) must land before they're copied from
+			VkMemoryBarrier sourceBarrier{};
+			sourceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			sourceBarrier.pNext = nullptr;
+			sourceBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			sourceBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &sourceBarrier, 0, nullptr, 0, nullptr);
+		}
+		VkBufferCopy region{};
+		region.size = bufferMetadata[i].size;
+		region.srcOffset = 0;
+		region.dstOffset = 0;
+		vkCmdCopyBuffer(commandBuffer, buffers[i], newBuffer, 1, &region);
+
+		//Swap the handle's slot over to the new buffer - the old one lives until the copy has completed
+		RetiredBuffer retired{};
+		retired.buffer = buffers[i];
+		retired.allocation = bufferAllocations[i];
+		retiredBuffers.push_back(retired);
+		buffers[i] = newBuffer;
+		bufferAllocations[i] = newAllocation;
+
+		++stats.movedBufferCount;
+		stats.movedBytes += bufferAllocations[i].size;
+	}
+
+	if (commandBuffer == VK_NULL_HANDLE) { return stats; }
+
+	//Make the copies visible to everything submitted after this pass
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(commandBuffer);
+
+	//Submitted on the graphics queue so that frames submitted earlier (still reading the old buffers) finish before the old buffers are destroyed
+	//The submission waits on the last upload ticket, so it can't overtake (or signal ahead of) a transfer-queue upload that hasn't executed yet
+	PendingUpload upload{};
+	upload.transferCommandBuffer = VK_NULL_HANDLE;
+	upload.acquireCommandBuffer = commandBuffer;
+	upload.ringMarker = 0; //No staging memory used
+	upload.retiredBuffers = std::move(retiredBuffers);
+	upload.ticket = SubmitToUploadTimeline(device.GetGraphicsQueue(), commandBuffer);
+	pendingUploads.push_back(std::move(upload));
+
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Defragmentation pass moved " + std::to_string(stats.movedBufferCount) + " buffer" + std::string(stats.movedBufferCount == 1 ? "" : "s") + " (" + GetFormattedSizeString(stats.movedBytes) + ") out of block " + std::to_string(sourceBlock) + " (fragmentation before: " + std::to_string(stats.fragmentationBefore * 100.0f) + "%)\n");
+	return stats;
+}
+
+
+
+bool BufferFactory::IsValid(BufferHandle _buffer) const
+{
+	return bufferHandles.IsValid(_buffer);
+}
+
+
+
+VkBuffer BufferFactory::GetBuffer(BufferHandle _buffer) const
 {
-	return bufferMemoryMap[_buffer];
+	return buffers[GetSlot(_buffer)];
 }
 
 
 
-VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags)
+const DeviceMemoryAllocation& BufferFactory::GetMemory(BufferHandle _buffer) const
+{
+	return bufferAllocations[GetSlot(_buffer)];
+}
+
+
+
+BufferHandle BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags, MEMORY_USAGE_INTENT _intent)
 {
 	VkBuffer buffer;
 	
@@ -148,7 +780,7 @@ VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBu
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.pNext = nullptr;
 	bufferInfo.size = _size; //1 MiB
-	bufferInfo.usage = _usage;
+	bufferInfo.usage = GetInternalUsage(_usage, _requiredMemFlags);
 	bufferInfo.sharingMode = _sharingMode;
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Creating buffer (size: " + GetFormattedSizeString(bufferInfo.size) + ")", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkResult result{ vkCreateBuffer(device.GetDevice(), &bufferInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &buffer) };
@@ -195,76 +827,194 @@ VkBuffer BufferFactory::AllocateBufferImpl(const VkDeviceSize& _size, const VkBu
 	}
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  - Memory flag bits: " + std::string(memTypePropFlagsString.empty() ? "NONE" : memTypePropFlagsString) + "\n");
 
-	//Find a memory type that fits the requirements
-	std::uint32_t memTypeIndex{ UINT32_MAX };
-	VkPhysicalDeviceMemoryProperties physicalDeviceMemProps;
-	vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &physicalDeviceMemProps);
-	for (std::uint32_t i{ 0 }; i < physicalDeviceMemProps.memoryTypeCount; ++i)
-	{
-		//Check if this memory type is allowed for our buffer
-		if (!(memRequirements.memoryTypeBits & (1 << i))) { continue; }
-		if ((physicalDeviceMemProps.memoryTypes[i].propertyFlags & _requiredMemFlags) != _requiredMemFlags) { continue; }
-		
-		//This memory type is allowed
-		memTypeIndex = i;
-		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Found compatible memory type at index " + std::to_string(i) + "\n");
-		break;
-	}
+	//Find the memory type that best fits the requirements and intended access pattern
+	const std::uint32_t memTypeIndex{ device.FindMemoryType(memRequirements.memoryTypeBits, _requiredMemFlags, _intent) };
 	if (memTypeIndex == UINT32_MAX)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  No available memory types were found\n");
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 		throw std::runtime_error("");
 	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Found compatible memory type at index " + std::to_string(memTypeIndex) + "\n");
 
-	//Allocate memory for the buffer
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = memTypeIndex;
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Allocating buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &bufferMemoryMap[buffer]);
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
+	//Sub-allocate memory for the buffer from the pool
+	//Memory is allocated and bound before a handle is taken so a failure only has the buffer (and memory) to clean up
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Sub-allocating buffer memory from device memory pool\n");
+	DeviceMemoryAllocation allocation;
+	try
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-		throw std::runtime_error("");
+		allocation = memoryPool.Allocate(memRequirements, memTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE::LINEAR, GetMemoryCategory(_usage, _requiredMemFlags));
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		throw;
 	}
 
 	//Bind the allocated memory region to the buffer
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Binding buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkBindBufferMemory(device.GetDevice(), buffer, bufferMemoryMap[buffer], 0);
+	result = vkBindBufferMemory(device.GetDevice(), buffer, allocation.memory, allocation.offset);
 	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
 	if (result != VK_SUCCESS)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		memoryPool.Free(allocation);
+		vkDestroyBuffer(device.GetDevice(), buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 		throw std::runtime_error("");
 	}
 
+	const BufferHandle handle{ bufferHandles.Allocate() };
+	if (handle.index >= buffers.size())
+	{
+		buffers.resize(bufferHandles.GetCapacity(), VK_NULL_HANDLE);
+		bufferAllocations.resize(bufferHandles.GetCapacity());
+		bufferMetadata.resize(bufferHandles.GetCapacity());
+	}
+	buffers[handle.index] = buffer;
+	bufferAllocations[handle.index] = allocation;
+
 	//Populate buffer-metadata entry
-	bufferMetadataMap[buffer].size = _size;
-	bufferMetadataMap[buffer].usage = _usage;
-	bufferMetadataMap[buffer].sharingMode = _sharingMode;
-	bufferMetadataMap[buffer].flags = _requiredMemFlags;
+	bufferMetadata[handle.index].size = _size;
+	bufferMetadata[handle.index].usage = _usage;
+	bufferMetadata[handle.index].sharingMode = _sharingMode;
+	bufferMetadata[handle.index].flags = _requiredMemFlags;
 	
-	return buffer;
+	return handle;
 }
 
 
 
-void BufferFactory::FreeBufferImpl(VkBuffer& _buffer)
+void BufferFactory::CollectCompletedUploads()
 {
-	bufferMetadataMap.erase(_buffer);
-	if (bufferMemoryMap[_buffer] != VK_NULL_HANDLE)
+	if (pendingUploads.empty()) { return; }
+
+	std::uint64_t completedValue{ 0 };
+	vkGetSemaphoreCounterValue(device.GetDevice(), uploadSemaphore, &completedValue);
+	while (!pendingUploads.empty() && pendingUploads.front().ticket <= completedValue)
 	{
-		vkFreeMemory(device.GetDevice(), bufferMemoryMap[_buffer], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		PendingUpload& upload{ pendingUploads.front() };
+		stagingRing.Release(upload.ringMarker);
+		for (BufferHandle& buffer : upload.buffersToFree)
+		{
+			FreeBufferImpl(buffer);
+		}
+		if (upload.transferCommandBuffer != VK_NULL_HANDLE)
+		{
+			transferCommandPool.FreeCommandBuffer(upload.transferCommandBuffer);
+		}
+		if (upload.acquireCommandBuffer != VK_NULL_HANDLE)
+		{
+			commandPool.FreeCommandBuffer(upload.acquireCommandBuffer);
+		}
+		if (!upload.retiredBuffers.empty())
+		{
+			for (RetiredBuffer& retired : upload.retiredBuffers)
+			{
+				vkDestroyBuffer(device.GetDevice(), retired.buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+				memoryPool.Free(retired.allocation);
+			}
+			logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::BUFFER_FACTORY, "Defragmentation pass retired " + std::to_string(upload.retiredBuffers.size()) + " buffer" + std::string(upload.retiredBuffers.size() == 1 ? "" : "s") + " (fragmentation after: " + std::to_string(memoryPool.GetFragmentationRatio(DEVICE_MEMORY_RESOURCE_TYPE::LINEAR) * 100.0f) + "%)\n");
+		}
+		pendingUploads.pop_front();
 	}
-	bufferMemoryMap.erase(_buffer);
-	if (_buffer != VK_NULL_HANDLE)
+}
+
+
+
+UploadTicket BufferFactory::SubmitToUploadTimeline(VkQueue _queue, VkCommandBuffer _commandBuffer)
+{
+	//Submissions to the transfer and graphics queues share the timeline, and signal values must strictly increase in execution order
+	//Chaining every submission on the last signalled value stops a later submission on one queue overtaking an earlier one on the other
+	const UploadTicket waitValue{ lastUploadTicket };
+	const UploadTicket signalValue{ lastUploadTicket + 1 };
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.waitSemaphoreValueCount = waitValue == 0 ? 0 : 1;
+	timelineInfo.pWaitSemaphoreValues = waitValue == 0 ? nullptr : &waitValue;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	const VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitValue == 0 ? 0 : 1;
+	submitInfo.pWaitSemaphores = waitValue == 0 ? nullptr : &uploadSemaphore;
+	submitInfo.pWaitDstStageMask = waitValue == 0 ? nullptr : &waitStage;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &_commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &uploadSemaphore;
+	const VkResult result{ vkQueueSubmit(_queue, 1, &submitInfo, VK_NULL_HANDLE) };
+	if (result != VK_SUCCESS)
 	{
-		vkDestroyBuffer(device.GetDevice(), _buffer, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Failed to submit upload command buffer (" + std::to_string(result) + ")\n");
+		throw std::runtime_error("");
+	}
+
+	lastUploadTicket = signalValue;
+	return signalValue;
+}
+
+
+
+std::uint32_t BufferFactory::GetSlot(BufferHandle _buffer) const
+{
+	if (!bufferHandles.IsValid(_buffer))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::BUFFER_FACTORY, "  Stale or null buffer handle (index: " + std::to_string(_buffer.index) + ", generation: " + std::to_string(_buffer.generation) + ")\n");
+		throw std::runtime_error("");
+	}
+	return _buffer.index;
+}
+
+
+
+VkBufferUsageFlags BufferFactory::GetInternalUsage(VkBufferUsageFlags _usage, VkMemoryPropertyFlags _requiredMemFlags)
+{
+	if ((_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+	{
+		return _usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	}
-	_buffer = VK_NULL_HANDLE;
+	return _usage;
+}
+
+
+
+MEMORY_USAGE_INTENT BufferFactory::GetDefaultIntent(VkMemoryPropertyFlags _requiredMemFlags)
+{
+	if (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) { return MEMORY_USAGE_INTENT::READBACK; }
+	if (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) { return MEMORY_USAGE_INTENT::UPLOAD; }
+	return MEMORY_USAGE_INTENT::GPU_ONLY;
+}
+
+
+
+DEVICE_MEMORY_CATEGORY BufferFactory::GetMemoryCategory(VkBufferUsageFlags _usage, VkMemoryPropertyFlags _requiredMemFlags)
+{
+	if (_usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) { return DEVICE_MEMORY_CATEGORY::VERTEX; }
+	if (_usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) { return DEVICE_MEMORY_CATEGORY::INDEX; }
+	if (_usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) { return DEVICE_MEMORY_CATEGORY::UNIFORM; }
+	if (_usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) { return DEVICE_MEMORY_CATEGORY::STORAGE; }
+	if ((_usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (_requiredMemFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) { return DEVICE_MEMORY_CATEGORY::STAGING; }
+	return DEVICE_MEMORY_CATEGORY::OTHER;
+}
+
+
+
+void BufferFactory::FreeBufferImpl(BufferHandle& _buffer)
+{
+	//Freeing a null handle is a no-op, but a stale one is a double free
+	if (_buffer.IsNull()) { return; }
+	const std::uint32_t slot{ GetSlot(_buffer) };
+	vkDestroyBuffer(device.GetDevice(), buffers[slot], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	buffers[slot] = VK_NULL_HANDLE;
+	memoryPool.Free(bufferAllocations[slot]);
+	bufferMetadata[slot] = BufferMetadata{};
+	bufferHandles.Free(_buffer);
+	_buffer = BufferHandle{};
 }
 
 
@@ -1,10 +1,15 @@
 #ifndef BUFFERFACTORY_H
 #define BUFFERFACTORY_H
 
+#include "DeviceMemoryPool.h"
+#include "StagingRingBuffer.h"
 #include "../Core/VulkanCommandPool.h"
 #include "../Core/VulkanDevice.h"
+#include "../../Utils/Templates/HandleTable.h"
 
-//Responsible for the initialisation, ownership, and clean shutdown of VkBuffers and accompanying VkDeviceMemorys
+#include <deque>
+
+//Responsible for the initialisation, ownership, and clean shutdown of VkBuffers and their sub-allocations of DeviceMemoryPool memory
 namespace Neki
 {
 
@@ -19,52 +24,298 @@ struct BufferMetadata
 };
 
 
+//Handle to a buffer owned by BufferFactory - resolve it to a VkBuffer with BufferFactory::GetBuffer()
+//Handles to freed buffers are detected as stale rather than aliasing whatever buffer reuses their slot
+struct BufferHandleTag;
+using BufferHandle = Handle<BufferHandleTag>;
+
+
+//Timeline value of BufferFactory's upload semaphore that is reached once an upload (including its handover to the graphics queue) has completed
+using UploadTicket = std::uint64_t;
+
+
+//A region of host-visible staging memory to write upload data into
+//Valid until the upload command buffer it is copied from has been submitted with SubmitUploadCommandBuffer() and has completed
+struct StagingAllocation
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void* mappedData;
+};
+
+
+//Result of a single BufferFactory::DefragmentBuffers() pass
+struct DefragmentationStats
+{
+	std::uint32_t movedBufferCount;
+	VkDeviceSize movedBytes;
+
+	//Fragmentation of linear device memory when the pass started (see DeviceMemoryPool::GetFragmentationRatio())
+	//The resulting ratio is logged once the pass's copies complete and the old regions are released
+	float fragmentationBefore;
+};
+
+
+//A set of uploads recorded into a single command buffer with grouped barriers and submitted once
+//Populate with BufferFactory::AddBufferUpload() / ImageFactory::AddImageUpload() and submit with BufferFactory::SubmitUploadBatch()
+//Only one batch should be populated at a time as staging memory must be submitted in the order it was allocated
+struct UploadBatch
+{
+	//For internal use only
+	struct BufferCopy
+	{
+		VkBuffer srcBuffer;
+		BufferHandle dstBuffer;
+		VkBufferCopy region;
+	};
+	struct ImageCopy
+	{
+		VkBuffer srcBuffer;
+		VkImage dstImage;
+		VkBufferImageCopy region;
+		VkImageLayout finalLayout;
+		VkAccessFlags dstAccessMask;
+		VkPipelineStageFlags dstStageMask;
+		std::uint32_t mipLevels;
+		std::vector<VkBufferImageCopy> additionalRegions; //Copied from srcBuffer alongside region (pre-built levels 1+, or the rest of an atlas's textures) - mipLevels is then 1 as nothing is generated
+	};
+	std::vector<BufferCopy> bufferCopies;
+	std::vector<ImageCopy> imageCopies;
+};
+
+
 class BufferFactory
 {
 public:
 	explicit BufferFactory(const VKLogger& _logger,
 						   VKDebugAllocator& _deviceDebugAllocator,
 						   const VulkanDevice& _device,
-						   VulkanCommandPool& _commandPool);
+						   DeviceMemoryPool& _memoryPool,
+						   VulkanCommandPool& _commandPool,
+						   VulkanCommandPool& _transferCommandPool,
+						   VkDeviceSize _stagingRingSize=32ull * 1024 * 1024);
 
 	~BufferFactory();
 
 	//Allocate a single buffer
-	[[nodiscard]] VkBuffer AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode=VK_SHARING_MODE_EXCLUSIVE, const VkMemoryPropertyFlags _requiredMemFlags=0);
+	[[nodiscard]] BufferHandle AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode=VK_SHARING_MODE_EXCLUSIVE, const VkMemoryPropertyFlags _requiredMemFlags=0);
+
+	//Allocate a single buffer, choosing its memory type by how it will be accessed rather than by flags alone
+	//HOST_VISIBLE is added to _requiredMemFlags for every intent other than GPU_ONLY
+	[[nodiscard]] BufferHandle AllocateBuffer(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, MEMORY_USAGE_INTENT _intent, const VkMemoryPropertyFlags _requiredMemFlags=0, const VkSharingMode& _sharingMode=VK_SHARING_MODE_EXCLUSIVE);
 
 	//Allocate multiple buffers from this pool
-	[[nodiscard]] std::vector<VkBuffer> AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes=nullptr, const VkMemoryPropertyFlags* _requiredMemFlags=nullptr);
+	[[nodiscard]] std::vector<BufferHandle> AllocateBuffers(std::uint32_t _count, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes=nullptr, const VkMemoryPropertyFlags* _requiredMemFlags=nullptr);
 
 	//Free a specific buffer
-	void FreeBuffer(VkBuffer& _buffer);
+	//_buffer is reset to a null handle
+	void FreeBuffer(BufferHandle& _buffer);
 
 	//Free a list of _count buffers
-	void FreeBuffers(std::uint32_t _count, VkBuffer* _buffers);
+	void FreeBuffers(std::uint32_t _count, BufferHandle* _buffers);
 
 	//Copies a host-visible buffer to a new device-local buffer and deletes the source buffer
 	//Buffer must have been allocated with BufferFactory
 	//The source buffer must have been created with the VK_BUFFER_USAGE_TRANSFER_SRC_BIT flag
 	//Optionally, set freeSourceBuffer=true to free the source buffer (note this will invalidate any currently active memory maps on the source buffer)
-	//Optionally, pass a (already begun) command buffer to this function and the barrier command will be recorded to it but not executed
+	//Optionally, pass a (already begun - see BeginUploadCommandBuffer()) command buffer to this function and the copy command will be recorded to it but not executed
+	//Leaving _commandBuffer as nullptr will cause the function to allocate its own command buffer and automatically submit it (the source buffer is then freed once the copy has completed)
+	BufferHandle TransferToDeviceLocalBuffer(BufferHandle& _buffer, bool _freeSourceBuffer=false, VkCommandBuffer* _commandBuffer=nullptr);
+
+	//Allocate a device-local buffer and populate it with _size bytes of _data through the staging ring
+	//VK_BUFFER_USAGE_TRANSFER_DST_BIT is added to _usage automatically
+	//Optionally, pass a (already begun - see BeginUploadCommandBuffer()) command buffer to this function and the copy command will be recorded to it but not executed
 	//Leaving _commandBuffer as nullptr will cause the function to allocate its own command buffer and automatically submit it
-	VkBuffer TransferToDeviceLocalBuffer(VkBuffer& _buffer, bool _freeSourceBuffer=false, VkCommandBuffer* _commandBuffer=nullptr);
+	//Optionally, pass an UploadTicket pointer to get the ticket of the submission (only set if _commandBuffer is nullptr)
+	[[nodiscard]] BufferHandle AllocateDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkSharingMode _sharingMode=VK_SHARING_MODE_EXCLUSIVE, VkCommandBuffer* _commandBuffer=nullptr, UploadTicket* _out_ticket=nullptr);
+
+	//Allocate _count device-local buffers populated with _datas, uploaded together in a single batch
+	//Optionally, pass an UploadTicket pointer to get the ticket of the batch's upload
+	[[nodiscard]] std::vector<BufferHandle> AllocateDeviceLocalBuffers(std::uint32_t _count, const void* const* _datas, const VkDeviceSize* _sizes, const VkBufferUsageFlags* _usages, const VkSharingMode* _sharingModes=nullptr, UploadTicket* _out_ticket=nullptr);
+
+
+	//----UPLOADS----//
+
+	//Allocate a device-local buffer and add the upload of _size bytes of _data to _batch (copied into staging memory immediately)
+	//VK_BUFFER_USAGE_TRANSFER_DST_BIT is added to _usage automatically
+	[[nodiscard]] BufferHandle AddBufferUpload(UploadBatch& _batch, const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkSharingMode _sharingMode=VK_SHARING_MODE_EXCLUSIVE);
+
+	//Add a copy from _staging to every texel of mip 0 / layer 0 of _image to _batch
+	//_image is transitioned from UNDEFINED to TRANSFER_DST_OPTIMAL before the copy and handed over to the graphics queue in _finalLayout afterwards
+	//If _mipLevels > 1, the rest of the mip chain is generated from mip 0 with linear blits on the graphics queue before the image reaches _finalLayout
+	//_image must then have been created with TRANSFER_SRC usage and a format that supports linear blitting
+	void AddImageCopy(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, VkExtent3D _extent, VkImageAspectFlags _aspectMask, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask, std::uint32_t _mipLevels=1);
+
+	//Add a copy of _levelCount pre-built mip levels of _image (e.g.: block-compressed data from a file) to _batch, where level i starts _levelOffsets[i] bytes into _staging
+	//Each level must be tightly packed and each offset a multiple of both the format's block size and 4
+	//_image is transitioned and handed over as with AddImageCopy()
+	void AddImageMipCopies(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, VkExtent3D _extent, std::uint32_t _levelCount, const VkDeviceSize* _levelOffsets, VkImageAspectFlags _aspectMask, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask);
+
+	//Add a copy of _regionCount sub-rectangles of _image (e.g.: textures packed into an atlas) to _batch, where each region's bufferOffset is relative to the start of _staging
+	//Every region is copied from the one staging allocation, and _image is transitioned (discarding its contents) and handed over as with AddImageCopy()
+	void AddImageRegionCopies(UploadBatch& _batch, const StagingAllocation& _staging, VkImage _image, std::uint32_t _regionCount, const VkBufferImageCopy* _regions, VkImageLayout _finalLayout, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask);
+
+	//Record every upload in _batch into one command buffer (one barrier before the copies, one handover after) and submit it
+	//_batch is emptied and can be reused
+	UploadTicket SubmitUploadBatch(UploadBatch& _batch);
+
+	//Reserve _size bytes of persistently mapped staging memory to copy from in an upload command buffer
+	//Staging memory must be submitted (SubmitUploadCommandBuffer()) in the order it was allocated
+	//Blocks on the oldest in-flight upload if the ring is full - requests larger than the ring are given a temporary buffer instead
+	[[nodiscard]] StagingAllocation AllocateStagingMemory(VkDeviceSize _size, VkDeviceSize _alignment=16);
+
+	//Size of the staging ring - batches that stay under this avoid falling back to temporary staging buffers
+	[[nodiscard]] VkDeviceSize GetStagingRingSize() const;
+
+	//Allocate and begin a one-time-submit command buffer to record upload commands into
+	//The command buffer is executed on the device's transfer queue - only record transfer commands to it
+	[[nodiscard]] VkCommandBuffer BeginUploadCommandBuffer();
 
+	//Hand a resource written by the upload command buffer over to the graphics queue when it is next submitted
+	//With a dedicated transfer queue this is a queue family ownership transfer (release on the transfer queue, acquire on the graphics queue), otherwise it is a plain barrier
+	//Images are additionally transitioned from _oldLayout to _newLayout
+	void HandOverBuffer(BufferHandle _buffer, VkAccessFlags _dstAccessMask=VK_ACCESS_MEMORY_READ_BIT, VkPipelineStageFlags _dstStageMask=VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	void HandOverImage(VkImage _image, VkImageLayout _oldLayout, VkImageLayout _newLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _dstStageMask);
 
-	[[nodiscard]] VkDeviceMemory GetMemory(VkBuffer _buffer);
+	//End and submit a command buffer from BeginUploadCommandBuffer() along with any resources handed over since the last submission
+	//Staging memory allocated before this call is recycled once the returned ticket is reached - this call does not block
+	UploadTicket SubmitUploadCommandBuffer(VkCommandBuffer _commandBuffer);
+
+	//Non-blocking check for whether the upload with _ticket has completed
+	[[nodiscard]] bool IsUploadComplete(UploadTicket _ticket) const;
+
+	//Block until the upload with _ticket has completed
+	void WaitForUpload(UploadTicket _ticket);
+
+	//Block until every submitted upload has completed
+	void WaitForUploads();
+
+	//Timeline semaphore signalled with each UploadTicket - wait on it in a queue submission to make GPU work depend on an upload without blocking the CPU
+	[[nodiscard]] VkSemaphore GetUploadSemaphore() const;
+
+
+	//----DEFRAGMENTATION----//
+
+	//Incrementally compact device-local buffer memory by moving up to _byteBudget bytes of buffers out of the least-used memory block with GPU copies
+	//Moved buffers keep their BufferHandle - only the VkBuffer returned by GetBuffer() changes, so resolve handles when recording rather than caching VkBuffers (or descriptor sets pointing to them)
+	//HOST_VISIBLE buffers are never moved as their mapped pointers may be held elsewhere
+	//Call once per frame before recording any commands that use buffers - the copies are submitted to the graphics queue and the old buffers are destroyed once they complete
+	//Does nothing while uploads (or a previous pass) are still in flight
+	DefragmentationStats DefragmentBuffers(VkDeviceSize _byteBudget=4ull * 1024 * 1024);
+
+	//--------//
+
+
+	//True if _buffer refers to a buffer that hasn't been freed
+	[[nodiscard]] bool IsValid(BufferHandle _buffer) const;
+
+	//Get the VkBuffer that _buffer refers to (throws if _buffer is stale)
+	[[nodiscard]] VkBuffer GetBuffer(BufferHandle _buffer) const;
+
+	//Get the block of memory (and offset into it) that _buffer is bound to
+	//For HOST_VISIBLE buffers, mappedData is a persistent map of the buffer's memory - do not call vkMapMemory on the block
+	[[nodiscard]] const DeviceMemoryAllocation& GetMemory(BufferHandle _buffer) const;
 
 	
 private:
-	[[nodiscard]] VkBuffer AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags);
-	void FreeBufferImpl(VkBuffer& _buffer);
+	[[nodiscard]] BufferHandle AllocateBufferImpl(const VkDeviceSize& _size, const VkBufferUsageFlags& _usage, const VkSharingMode& _sharingMode, const VkMemoryPropertyFlags _requiredMemFlags, MEMORY_USAGE_INTENT _intent);
+	void FreeBufferImpl(BufferHandle& _buffer);
+
+	//Get the slot index of _buffer, logging an error and throwing if it is stale
+	[[nodiscard]] std::uint32_t GetSlot(BufferHandle _buffer) const;
+
+	//The usage a buffer is actually created with - device-local buffers can always be copied from and to so that they can be relocated by DefragmentBuffers()
+	[[nodiscard]] static VkBufferUsageFlags GetInternalUsage(VkBufferUsageFlags _usage, VkMemoryPropertyFlags _requiredMemFlags);
+
+	//The intent assumed for buffers allocated by flags alone
+	[[nodiscard]] static MEMORY_USAGE_INTENT GetDefaultIntent(VkMemoryPropertyFlags _requiredMemFlags);
+
+	//The statistics category a buffer's memory is counted under
+	[[nodiscard]] static DEVICE_MEMORY_CATEGORY GetMemoryCategory(VkBufferUsageFlags _usage, VkMemoryPropertyFlags _requiredMemFlags);
+
+	//Retire every in-flight upload whose ticket has been reached
+	void CollectCompletedUploads();
+
+	//Submit _commandBuffer to _queue, waiting on the last upload semaphore value (if any) and signalling the next one
+	[[nodiscard]] UploadTicket SubmitToUploadTimeline(VkQueue _queue, VkCommandBuffer _commandBuffer);
+
+	//Record the blit chain of every queued mipmap generation to _commandBuffer (which must execute on the graphics queue)
+	void RecordMipmapGenerations(VkCommandBuffer _commandBuffer);
 	
 	//Dependency injections from VKApp
 	const VKLogger& logger;
 	VKDebugAllocator& deviceDebugAllocator;
 	const VulkanDevice& device;
+	DeviceMemoryPool& memoryPool;
 	VulkanCommandPool& commandPool;
+	VulkanCommandPool& transferCommandPool;
+
+	//Per-buffer data stored contiguously and indexed by BufferHandle::index
+	HandleTable<BufferHandleTag> bufferHandles;
+	std::vector<VkBuffer> buffers;
+	std::vector<DeviceMemoryAllocation> bufferAllocations;
+	std::vector<BufferMetadata> bufferMetadata;
+
+	//Persistently mapped staging ring that all uploads are copied through
+	BufferHandle stagingBuffer;
+	void* stagingData;
+	StagingRingBuffer stagingRing;
+
+	//Timeline semaphore signalled by every upload submission
+	VkSemaphore uploadSemaphore;
+	UploadTicket lastUploadTicket;
+
+	//A buffer that has been replaced by a relocated copy and is destroyed once the copy completes
+	struct RetiredBuffer
+	{
+		VkBuffer buffer;
+		DeviceMemoryAllocation allocation;
+	};
+
+	struct PendingUpload
+	{
+		UploadTicket ticket;
+
+		//Transfer queue command buffer (VK_NULL_HANDLE for graphics-queue-only submissions such as defragmentation)
+		VkCommandBuffer transferCommandBuffer;
+
+		//Graphics queue command buffer that acquires ownership of handed over resources or performs defragmentation copies (VK_NULL_HANDLE if not needed)
+		VkCommandBuffer acquireCommandBuffer;
+
+		//Ring marker taken at submission - the ring is released up to here once ticket is reached
+		std::uint64_t ringMarker;
+
+		//Buffers only needed until the upload completes (oversized staging buffers and transfer sources)
+		std::vector<BufferHandle> buffersToFree;
+
+		//Old copies of buffers moved by DefragmentBuffers()
+		std::vector<RetiredBuffer> retiredBuffers;
+	};
+
+	//In-flight uploads in submission order
+	std::deque<PendingUpload> pendingUploads;
+
+	//Barriers for resources handed over since the last submission
+	std::vector<VkBufferMemoryBarrier> bufferHandOvers;
+	std::vector<VkImageMemoryBarrier> imageHandOvers;
+	VkPipelineStageFlags handOverDstStageMask;
+
+	//Images handed over in TRANSFER_DST_OPTIMAL whose mip chains are generated on the graphics queue once they've been acquired
+	struct MipmapGeneration
+	{
+		VkImage image;
+		VkExtent3D extent;
+		std::uint32_t mipLevels;
+		VkImageAspectFlags aspectMask;
+		VkImageLayout finalLayout;
+		VkAccessFlags dstAccessMask;
+		VkPipelineStageFlags dstStageMask;
+	};
+	std::vector<MipmapGeneration> mipmapGenerations;
 
-	std::unordered_map<VkBuffer, VkDeviceMemory> bufferMemoryMap;
-	std::unordered_map<VkBuffer, BufferMetadata> bufferMetadataMap;
+	//Buffers to be attached to the next SubmitUploadCommandBuffer() call
+	std::vector<BufferHandle> unsubmittedBuffersToFree;
 };
 
 
@@ -0,0 +1,470 @@
+#include "DeviceMemoryPool.h"
+#include "../../Utils/Strings/format.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+DeviceMemoryPool::DeviceMemoryPool(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VkDeviceSize _preferredBlockSize)
+								  : logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), preferredBlockSize(_preferredBlockSize), memoryProperties(_device.GetMemoryProperties())
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::MEMORY_POOL, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::MEMORY_POOL, "Device Memory Pool Initialised\n");
+
+	memoryTypeUsage.fill(DeviceMemoryUsage{});
+	categoryUsage.fill(DeviceMemoryUsage{});
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Preferred block size: " + GetFormattedSizeString(preferredBlockSize) + "\n");
+}
+
+
+
+DeviceMemoryPool::~DeviceMemoryPool()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::MEMORY_POOL, "Shutting down DeviceMemoryPool\n");
+	for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE) { continue; }
+		if (blocks[i].isExclusive || !blocks[i].allocator->IsEmpty())
+		{
+			const std::size_t allocationCount{ blocks[i].isExclusive ? 1 : blocks[i].allocator->GetAllocationCount() };
+			logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::MEMORY_POOL, "  Block " + std::to_string(i) + " still has " + std::to_string(allocationCount) + " live allocation(s)\n");
+		}
+		FreeBlock(i);
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MEMORY_POOL, "  All device memory blocks freed\n");
+}
+
+
+
+DeviceMemoryAllocation DeviceMemoryPool::Allocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category)
+{
+	if (IsLargeAllocation(_requirements.size, _memoryTypeIndex))
+	{
+		//Too large to share a block without wasting most of it
+		//vkAllocateMemory() satisfies any resource's alignment, so the block is exactly the request's size and the allocation starts at offset 0
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Request of " + GetFormattedSizeString(_requirements.size) + " exceeds half the block size - giving it its own block\n");
+		const std::uint32_t blockIndex{ CreateBlock(_requirements.size, _memoryTypeIndex, _resourceType, true) };
+		return CreateAllocation(blockIndex, TLSFAllocator::INVALID_NODE, 0, _requirements.size, _category);
+	}
+
+	const VkDeviceSize blockSize{ GetBlockSize(_memoryTypeIndex) };
+	std::uint32_t blockIndex{ UINT32_MAX };
+	std::uint32_t node{ TLSFAllocator::INVALID_NODE };
+	VkDeviceSize offset{ 0 };
+
+	//Try to fit the request into an existing block
+	for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE || blocks[i].isExclusive) { continue; }
+		if (blocks[i].memoryTypeIndex != _memoryTypeIndex || blocks[i].resourceType != _resourceType) { continue; }
+		node = blocks[i].allocator->Allocate(_requirements.size, _requirements.alignment, offset);
+		if (node != TLSFAllocator::INVALID_NODE)
+		{
+			blockIndex = i;
+			break;
+		}
+	}
+
+	//All existing blocks are full (or there are none yet)
+	if (node == TLSFAllocator::INVALID_NODE)
+	{
+		blockIndex = CreateBlock(blockSize, _memoryTypeIndex, _resourceType, false);
+		node = blocks[blockIndex].allocator->Allocate(_requirements.size, _requirements.alignment, offset);
+	}
+
+	if (node == TLSFAllocator::INVALID_NODE)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MEMORY_POOL, "  Failed to sub-allocate " + GetFormattedSizeString(_requirements.size) + " from a fresh block\n");
+		throw std::runtime_error("");
+	}
+
+	const DeviceMemoryAllocation allocation{ CreateAllocation(blockIndex, node, offset, _requirements.size, _category) };
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::MEMORY_POOL, "  Sub-allocated " + GetFormattedSizeString(allocation.size) + " at offset " + std::to_string(offset) + " of block " + std::to_string(blockIndex) + "\n");
+
+	return allocation;
+}
+
+
+
+DeviceMemoryAllocation DeviceMemoryPool::AllocateDedicated(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category, VkImage _image, VkBuffer _buffer)
+{
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.pNext = nullptr;
+	dedicatedInfo.image = _image;
+	dedicatedInfo.buffer = _buffer;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Giving " + GetFormattedSizeString(_requirements.size) + " " + std::string(_image != VK_NULL_HANDLE ? "image" : "buffer") + " a dedicated block\n");
+	const std::uint32_t blockIndex{ CreateBlock(_requirements.size, _memoryTypeIndex, _resourceType, true, &dedicatedInfo) };
+
+	//The resource must be bound at offset 0 of its dedicated memory, which covers the whole block - there's nothing to sub-allocate
+	return CreateAllocation(blockIndex, TLSFAllocator::INVALID_NODE, 0, _requirements.size, _category);
+}
+
+
+
+bool DeviceMemoryPool::IsLargeAllocation(VkDeviceSize _size, std::uint32_t _memoryTypeIndex) const
+{
+	//Sharing a block with a request this large would waste most of it
+	return _size > GetBlockSize(_memoryTypeIndex) / 2;
+}
+
+
+
+void DeviceMemoryPool::Free(DeviceMemoryAllocation& _allocation)
+{
+	if (_allocation.blockIndex == UINT32_MAX) { return; }
+
+	MemoryBlock& block{ blocks[_allocation.blockIndex] };
+	RecordFree(_allocation);
+
+	//Exclusive blocks only ever hold this one allocation
+	if (block.isExclusive)
+	{
+		FreeBlock(_allocation.blockIndex);
+		_allocation = DeviceMemoryAllocation{};
+		return;
+	}
+
+	block.allocator->Free(_allocation.node);
+	if (block.allocator->IsEmpty())
+	{
+		//Keep one empty shared block around per memory type to avoid thrashing vkAllocateMemory/vkFreeMemory
+		bool keepBlock{ true };
+		for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+		{
+			if (i == _allocation.blockIndex || blocks[i].memory == VK_NULL_HANDLE || blocks[i].isExclusive) { continue; }
+			if (blocks[i].memoryTypeIndex == block.memoryTypeIndex && blocks[i].resourceType == block.resourceType)
+			{
+				keepBlock = false;
+				break;
+			}
+		}
+		if (!keepBlock)
+		{
+			FreeBlock(_allocation.blockIndex);
+		}
+	}
+
+	_allocation = DeviceMemoryAllocation{};
+}
+
+
+
+float DeviceMemoryPool::GetFragmentationRatio(DEVICE_MEMORY_RESOURCE_TYPE _resourceType) const
+{
+	VkDeviceSize totalFree{ 0 };
+	VkDeviceSize largestFree{ 0 };
+	for (const MemoryBlock& block : blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE || block.isExclusive || block.resourceType != _resourceType) { continue; }
+		totalFree += block.allocator->GetSize() - block.allocator->GetUsedSize();
+		largestFree = std::max(largestFree, block.allocator->GetLargestFreeRegion());
+	}
+	if (totalFree == 0) { return 0.0f; }
+	return 1.0f - static_cast<float>(static_cast<double>(largestFree) / static_cast<double>(totalFree));
+}
+
+
+
+std::uint32_t DeviceMemoryPool::FindDefragmentationSourceBlock(DEVICE_MEMORY_RESOURCE_TYPE _resourceType) const
+{
+	std::uint32_t sourceBlock{ UINT32_MAX };
+	for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+	{
+		const MemoryBlock& block{ blocks[i] };
+		if (block.memory == VK_NULL_HANDLE || block.isExclusive || block.resourceType != _resourceType || block.allocator->IsEmpty()) { continue; }
+		if (sourceBlock != UINT32_MAX && block.allocator->GetUsedSize() >= blocks[sourceBlock].allocator->GetUsedSize()) { continue; }
+
+		//Only worth emptying if the rest of the memory type's blocks could absorb its contents
+		VkDeviceSize freeElsewhere{ 0 };
+		for (std::uint32_t j{ 0 }; j<blocks.size(); ++j)
+		{
+			if (j == i || blocks[j].memory == VK_NULL_HANDLE || blocks[j].isExclusive) { continue; }
+			if (blocks[j].memoryTypeIndex != block.memoryTypeIndex || blocks[j].resourceType != _resourceType) { continue; }
+			freeElsewhere += blocks[j].allocator->GetSize() - blocks[j].allocator->GetUsedSize();
+		}
+		if (freeElsewhere >= block.allocator->GetUsedSize())
+		{
+			sourceBlock = i;
+		}
+	}
+	return sourceBlock;
+}
+
+
+
+bool DeviceMemoryPool::AllocateOutsideBlock(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category, std::uint32_t _excludedBlock, DeviceMemoryAllocation& _out_allocation)
+{
+	for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+	{
+		if (i == _excludedBlock || blocks[i].memory == VK_NULL_HANDLE || blocks[i].isExclusive) { continue; }
+		if (blocks[i].memoryTypeIndex != _memoryTypeIndex || blocks[i].resourceType != _resourceType) { continue; }
+		VkDeviceSize offset{ 0 };
+		const std::uint32_t node{ blocks[i].allocator->Allocate(_requirements.size, _requirements.alignment, offset) };
+		if (node == TLSFAllocator::INVALID_NODE) { continue; }
+
+		_out_allocation = CreateAllocation(i, node, offset, _requirements.size, _category);
+		return true;
+	}
+	return false;
+}
+
+
+
+DeviceMemoryStats DeviceMemoryPool::GetStats() const
+{
+	DeviceMemoryStats stats{};
+	stats.memoryTypes.assign(memoryTypeUsage.begin(), memoryTypeUsage.begin() + memoryProperties.memoryTypeCount);
+	stats.categories = categoryUsage;
+	stats.memoryHeaps.resize(memoryProperties.memoryHeapCount);
+	for (std::uint32_t i{ 0 }; i<memoryProperties.memoryHeapCount; ++i)
+	{
+		stats.memoryHeaps[i].size = memoryProperties.memoryHeaps[i].size;
+		stats.memoryHeaps[i].flags = memoryProperties.memoryHeaps[i].flags;
+	}
+
+	//Roll memory types up into their heaps and the total
+	for (std::uint32_t i{ 0 }; i<memoryProperties.memoryTypeCount; ++i)
+	{
+		DeviceMemoryUsage& heapUsage{ stats.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].usage };
+		for (DeviceMemoryUsage* usage : { &heapUsage, &stats.total })
+		{
+			usage->blockBytes += memoryTypeUsage[i].blockBytes;
+			usage->blockCount += memoryTypeUsage[i].blockCount;
+			usage->allocationBytes += memoryTypeUsage[i].allocationBytes;
+			usage->allocationCount += memoryTypeUsage[i].allocationCount;
+		}
+	}
+
+	//Query the driver's budget if possible - it accounts for everything else using the heap, which our own counters can't
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	stats.budgetFromDriver = device.IsMemoryBudgetEnabled();
+	if (stats.budgetFromDriver)
+	{
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		budgetProperties.pNext = nullptr;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(device.GetPhysicalDevice(), &memoryProperties2);
+	}
+
+	stats.overBudget = false;
+	for (std::uint32_t i{ 0 }; i<memoryProperties.memoryHeapCount; ++i)
+	{
+		DeviceMemoryHeapStats& heap{ stats.memoryHeaps[i] };
+		if (stats.budgetFromDriver)
+		{
+			heap.budget = budgetProperties.heapBudget[i];
+			heap.driverUsage = budgetProperties.heapUsage[i];
+		}
+		else
+		{
+			//Leave a fifth of the heap for the OS, compositor, and other processes
+			heap.budget = heap.size / 5 * 4;
+			heap.driverUsage = heap.usage.blockBytes;
+		}
+		heap.overBudget = heap.driverUsage > heap.budget;
+		stats.overBudget = stats.overBudget || heap.overBudget;
+	}
+
+	return stats;
+}
+
+
+
+std::string DeviceMemoryPool::GetStatsJSON() const
+{
+	const DeviceMemoryStats stats{ GetStats() };
+
+	auto usageToJSON{ [](const DeviceMemoryUsage& _usage)
+	{
+		return "\"blockBytes\":" + std::to_string(_usage.blockBytes) + ",\"blockCount\":" + std::to_string(_usage.blockCount) +
+			   ",\"allocationBytes\":" + std::to_string(_usage.allocationBytes) + ",\"allocationCount\":" + std::to_string(_usage.allocationCount);
+	} };
+
+	std::string json{ "{\"budgetFromDriver\":" + std::string(stats.budgetFromDriver ? "true" : "false") + ",\"overBudget\":" + std::string(stats.overBudget ? "true" : "false") };
+	json += ",\"total\":{" + usageToJSON(stats.total) + "}";
+
+	json += ",\"heaps\":[";
+	for (std::size_t i{ 0 }; i<stats.memoryHeaps.size(); ++i)
+	{
+		const DeviceMemoryHeapStats& heap{ stats.memoryHeaps[i] };
+		json += std::string(i == 0 ? "" : ",") + "{\"index\":" + std::to_string(i) + ",\"size\":" + std::to_string(heap.size) +
+				",\"deviceLocal\":" + std::string(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "true" : "false") +
+				",\"budget\":" + std::to_string(heap.budget) + ",\"driverUsage\":" + std::to_string(heap.driverUsage) +
+				",\"overBudget\":" + std::string(heap.overBudget ? "true" : "false") + "," + usageToJSON(heap.usage) + "}";
+	}
+	json += "]";
+
+	json += ",\"memoryTypes\":[";
+	for (std::size_t i{ 0 }; i<stats.memoryTypes.size(); ++i)
+	{
+		json += std::string(i == 0 ? "" : ",") + "{\"index\":" + std::to_string(i) + ",\"heapIndex\":" + std::to_string(memoryProperties.memoryTypes[i].heapIndex) +
+				",\"propertyFlags\":" + std::to_string(memoryProperties.memoryTypes[i].propertyFlags) + "," + usageToJSON(stats.memoryTypes[i]) + "}";
+	}
+	json += "]";
+
+	json += ",\"categories\":{";
+	for (std::size_t i{ 0 }; i<DEVICE_MEMORY_CATEGORY_COUNT; ++i)
+	{
+		json += std::string(i == 0 ? "" : ",") + "\"" + CategoryToString(static_cast<DEVICE_MEMORY_CATEGORY>(i)) + "\":{" +
+				"\"allocationBytes\":" + std::to_string(stats.categories[i].allocationBytes) + ",\"allocationCount\":" + std::to_string(stats.categories[i].allocationCount) + "}";
+	}
+	json += "}}";
+
+	return json;
+}
+
+
+
+std::uint32_t DeviceMemoryPool::CreateBlock(VkDeviceSize _size, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, bool _isExclusive, const VkMemoryDedicatedAllocateInfo* _dedicatedInfo)
+{
+	MemoryBlock block{};
+	block.size = _size;
+	block.memoryTypeIndex = _memoryTypeIndex;
+	block.resourceType = _resourceType;
+	block.isExclusive = _isExclusive;
+	block.mappedData = nullptr;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = _dedicatedInfo;
+	allocInfo.allocationSize = _size;
+	allocInfo.memoryTypeIndex = _memoryTypeIndex;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Allocating " + GetFormattedSizeString(_size) + " block from memory type " + std::to_string(_memoryTypeIndex), VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	VkResult result{ vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &block.memory) };
+	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MEMORY_POOL, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (result != VK_SUCCESS)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MEMORY_POOL, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+		throw std::runtime_error("");
+	}
+
+	//Host-visible blocks stay mapped for their whole lifetime - sub-allocations just offset into the mapping
+	if (memoryProperties.memoryTypes[_memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Persistently mapping block", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+		result = vkMapMemory(device.GetDevice(), block.memory, 0, VK_WHOLE_SIZE, 0, &block.mappedData);
+		logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MEMORY_POOL, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+		if (result != VK_SUCCESS)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::MEMORY_POOL, " (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
+			vkFreeMemory(device.GetDevice(), block.memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+			throw std::runtime_error("");
+		}
+	}
+
+	if (!_isExclusive)
+	{
+		block.allocator = std::make_unique<TLSFAllocator>(_size);
+	}
+	memoryTypeUsage[_memoryTypeIndex].blockBytes += _size;
+	++memoryTypeUsage[_memoryTypeIndex].blockCount;
+
+	//Reuse an empty slot if there is one
+	for (std::uint32_t i{ 0 }; i<blocks.size(); ++i)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE)
+		{
+			blocks[i] = std::move(block);
+			return i;
+		}
+	}
+	blocks.push_back(std::move(block));
+	return static_cast<std::uint32_t>(blocks.size() - 1);
+}
+
+
+
+void DeviceMemoryPool::FreeBlock(std::uint32_t _blockIndex)
+{
+	MemoryBlock& block{ blocks[_blockIndex] };
+	if (block.mappedData != nullptr)
+	{
+		vkUnmapMemory(device.GetDevice(), block.memory);
+		block.mappedData = nullptr;
+	}
+	if (block.memory != VK_NULL_HANDLE)
+	{
+		vkFreeMemory(device.GetDevice(), block.memory, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		block.memory = VK_NULL_HANDLE;
+		memoryTypeUsage[block.memoryTypeIndex].blockBytes -= block.size;
+		--memoryTypeUsage[block.memoryTypeIndex].blockCount;
+	}
+	block.allocator.reset();
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::MEMORY_POOL, "  Freed block " + std::to_string(_blockIndex) + "\n");
+}
+
+
+
+VkDeviceSize DeviceMemoryPool::GetBlockSize(std::uint32_t _memoryTypeIndex) const
+{
+	//Don't let a single block take up more than an eighth of its heap (e.g.: small 256MiB BAR heaps)
+	const VkDeviceSize heapSize{ memoryProperties.memoryHeaps[memoryProperties.memoryTypes[_memoryTypeIndex].heapIndex].size };
+	return std::min(preferredBlockSize, heapSize / 8);
+}
+
+
+
+DeviceMemoryAllocation DeviceMemoryPool::CreateAllocation(std::uint32_t _blockIndex, std::uint32_t _node, VkDeviceSize _offset, VkDeviceSize _size, DEVICE_MEMORY_CATEGORY _category)
+{
+	DeviceMemoryAllocation allocation{};
+	allocation.memory = blocks[_blockIndex].memory;
+	allocation.offset = _offset;
+	allocation.size = _size;
+	allocation.mappedData = blocks[_blockIndex].mappedData == nullptr ? nullptr : static_cast<char*>(blocks[_blockIndex].mappedData) + _offset;
+	allocation.memoryTypeIndex = blocks[_blockIndex].memoryTypeIndex;
+	allocation.category = _category;
+	allocation.blockIndex = _blockIndex;
+	allocation.node = _node;
+	RecordAllocation(allocation);
+	return allocation;
+}
+
+
+
+void DeviceMemoryPool::RecordAllocation(const DeviceMemoryAllocation& _allocation)
+{
+	memoryTypeUsage[_allocation.memoryTypeIndex].allocationBytes += _allocation.size;
+	++memoryTypeUsage[_allocation.memoryTypeIndex].allocationCount;
+	categoryUsage[static_cast<std::size_t>(_allocation.category)].allocationBytes += _allocation.size;
+	++categoryUsage[static_cast<std::size_t>(_allocation.category)].allocationCount;
+}
+
+
+
+void DeviceMemoryPool::RecordFree(const DeviceMemoryAllocation& _allocation)
+{
+	memoryTypeUsage[_allocation.memoryTypeIndex].allocationBytes -= _allocation.size;
+	--memoryTypeUsage[_allocation.memoryTypeIndex].allocationCount;
+	categoryUsage[static_cast<std::size_t>(_allocation.category)].allocationBytes -= _allocation.size;
+	--categoryUsage[static_cast<std::size_t>(_allocation.category)].allocationCount;
+}
+
+
+
+const char* DeviceMemoryPool::CategoryToString(DEVICE_MEMORY_CATEGORY _category)
+{
+	switch (_category)
+	{
+	case DEVICE_MEMORY_CATEGORY::VERTEX: return "vertex";
+	case DEVICE_MEMORY_CATEGORY::INDEX: return "index";
+	case DEVICE_MEMORY_CATEGORY::UNIFORM: return "uniform";
+	case DEVICE_MEMORY_CATEGORY::STORAGE: return "storage";
+	case DEVICE_MEMORY_CATEGORY::STAGING: return "staging";
+	case DEVICE_MEMORY_CATEGORY::TEXTURE: return "texture";
+	case DEVICE_MEMORY_CATEGORY::ATTACHMENT: return "attachment";
+	case DEVICE_MEMORY_CATEGORY::OTHER: return "other";
+	}
+	return "other";
+}
+
+
+
+}
\ No newline at end of file
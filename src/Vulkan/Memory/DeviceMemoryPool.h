@@ -0,0 +1,201 @@
+#ifndef DEVICEMEMORYPOOL_H
+#define DEVICEMEMORYPOOL_H
+
+#include "TLSFAllocator.h"
+#include "../Core/VulkanDevice.h"
+
+#include <memory>
+#include <array>
+#include <string>
+
+//Responsible for the initialisation, ownership, and clean shutdown of large VkDeviceMemory blocks that BufferFactory and ImageFactory sub-allocate from
+//Keeps the number of live vkAllocateMemory calls to a handful per memory type rather than one per resource
+namespace Neki
+{
+
+
+//Linear resources (buffers) and optimal-tiling resources (images) are sub-allocated from separate blocks so that bufferImageGranularity never needs to be considered
+enum class DEVICE_MEMORY_RESOURCE_TYPE : std::uint32_t
+{
+	LINEAR,
+	OPTIMAL,
+};
+
+
+//What an allocation is used for - only used to break down memory statistics
+enum class DEVICE_MEMORY_CATEGORY : std::uint32_t
+{
+	VERTEX,
+	INDEX,
+	UNIFORM,
+	STORAGE,
+	STAGING,
+	TEXTURE,
+	ATTACHMENT,
+	OTHER,
+};
+constexpr std::size_t DEVICE_MEMORY_CATEGORY_COUNT{ static_cast<std::size_t>(DEVICE_MEMORY_CATEGORY::OTHER) + 1 };
+
+
+//A sub-allocated region of a VkDeviceMemory block
+struct DeviceMemoryAllocation
+{
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+
+	//Persistently mapped pointer to the start of this allocation (nullptr if the memory type isn't HOST_VISIBLE)
+	void* mappedData{ nullptr };
+
+	std::uint32_t memoryTypeIndex{ UINT32_MAX };
+	DEVICE_MEMORY_CATEGORY category{ DEVICE_MEMORY_CATEGORY::OTHER };
+
+	//For internal use only
+	std::uint32_t blockIndex{ UINT32_MAX };
+	std::uint32_t node{ TLSFAllocator::INVALID_NODE };
+};
+
+
+//Bytes and counts for a subset of the pool's memory
+struct DeviceMemoryUsage
+{
+	VkDeviceSize blockBytes{ 0 }; //VkDeviceMemory allocated from the driver
+	std::uint32_t blockCount{ 0 };
+	VkDeviceSize allocationBytes{ 0 }; //Sub-allocated to resources
+	std::uint32_t allocationCount{ 0 };
+};
+
+
+struct DeviceMemoryHeapStats
+{
+	DeviceMemoryUsage usage;
+	VkDeviceSize size;
+	VkMemoryHeapFlags flags;
+
+	//With VK_EXT_memory_budget these come from the driver - driverUsage then also includes memory allocated outside the pool (e.g.: swapchain images, other processes' share of the heap)
+	//Without it, budget is estimated as a fixed fraction of the heap's size and driverUsage is the pool's own blockBytes
+	VkDeviceSize budget;
+	VkDeviceSize driverUsage;
+	bool overBudget;
+};
+
+
+struct DeviceMemoryStats
+{
+	std::vector<DeviceMemoryUsage> memoryTypes; //Indexed by memory type index
+	std::vector<DeviceMemoryHeapStats> memoryHeaps; //Indexed by heap index
+	std::array<DeviceMemoryUsage, DEVICE_MEMORY_CATEGORY_COUNT> categories; //Blocks are shared between categories, so only allocationBytes and allocationCount are filled in
+	DeviceMemoryUsage total;
+
+	bool budgetFromDriver; //True if VK_EXT_memory_budget was used
+	bool overBudget; //True if any heap is over budget
+};
+
+
+class DeviceMemoryPool
+{
+public:
+	explicit DeviceMemoryPool(const VKLogger& _logger,
+							  VKDebugAllocator& _deviceDebugAllocator,
+							  const VulkanDevice& _device,
+							  VkDeviceSize _preferredBlockSize=64ull * 1024 * 1024);
+
+	~DeviceMemoryPool();
+
+	//Sub-allocate a region satisfying _requirements from a block of memory type _memoryTypeIndex
+	//Requests too large to share a block are given a block of their own
+	[[nodiscard]] DeviceMemoryAllocation Allocate(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category=DEVICE_MEMORY_CATEGORY::OTHER);
+
+	//Give _image or _buffer (the other must be VK_NULL_HANDLE) a VkDeviceMemory of its own, created with VkMemoryDedicatedAllocateInfo so the driver can place it optimally
+	//Requires Vulkan 1.1 - use for resources whose VkMemoryDedicatedRequirements require or prefer it
+	[[nodiscard]] DeviceMemoryAllocation AllocateDedicated(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category, VkImage _image, VkBuffer _buffer);
+
+	//True if a request of _size bytes is too large to share a block of memory type _memoryTypeIndex
+	[[nodiscard]] bool IsLargeAllocation(VkDeviceSize _size, std::uint32_t _memoryTypeIndex) const;
+
+	//Return an allocation to its block - the block's VkDeviceMemory is freed if it is no longer needed
+	void Free(DeviceMemoryAllocation& _allocation);
+
+	//----DEFRAGMENTATION----//
+
+	//Fragmentation of the free space in shared _resourceType blocks: 1 - (largest free region / total free space)
+	//0 means all free space is contiguous, values approaching 1 mean it is scattered in small holes
+	[[nodiscard]] float GetFragmentationRatio(DEVICE_MEMORY_RESOURCE_TYPE _resourceType) const;
+
+	//Pick the shared _resourceType block that is cheapest to empty (least used space) and whose contents fit in the free space of other blocks of its memory type
+	//Returns UINT32_MAX if no block is worth emptying
+	[[nodiscard]] std::uint32_t FindDefragmentationSourceBlock(DEVICE_MEMORY_RESOURCE_TYPE _resourceType) const;
+
+	//Sub-allocate from an existing shared block other than _excludedBlock - never creates a new block
+	//Returns false if no other block has room
+	[[nodiscard]] bool AllocateOutsideBlock(const VkMemoryRequirements& _requirements, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, DEVICE_MEMORY_CATEGORY _category, std::uint32_t _excludedBlock, DeviceMemoryAllocation& _out_allocation);
+
+	//--------//
+
+
+	//----STATISTICS----//
+
+	//Snapshot of the pool's usage per memory type, heap, and category, along with each heap's budget
+	//Cheap enough to call every frame
+	[[nodiscard]] DeviceMemoryStats GetStats() const;
+
+	//GetStats() serialised as a single-line JSON object
+	[[nodiscard]] std::string GetStatsJSON() const;
+
+	//--------//
+
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		std::uint32_t memoryTypeIndex;
+		DEVICE_MEMORY_RESOURCE_TYPE resourceType;
+		void* mappedData;
+
+		//True if this block was created for a single oversized or dedicated allocation
+		//Exclusive blocks aren't sub-allocated - their one allocation covers the whole block from offset 0
+		bool isExclusive;
+
+		std::unique_ptr<TLSFAllocator> allocator; //nullptr for exclusive blocks
+	};
+
+	//Allocate a new VkDeviceMemory block of _size bytes and return its index into blocks
+	//Optionally, pass _dedicatedInfo to chain it to the VkMemoryAllocateInfo
+	[[nodiscard]] std::uint32_t CreateBlock(VkDeviceSize _size, std::uint32_t _memoryTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE _resourceType, bool _isExclusive, const VkMemoryDedicatedAllocateInfo* _dedicatedInfo=nullptr);
+	void FreeBlock(std::uint32_t _blockIndex);
+
+	//The block size used for a given memory type (scaled down for small heaps)
+	[[nodiscard]] VkDeviceSize GetBlockSize(std::uint32_t _memoryTypeIndex) const;
+
+	//Fill out the allocation for _node of block _blockIndex and add it to the statistics (_node is INVALID_NODE for exclusive blocks)
+	[[nodiscard]] DeviceMemoryAllocation CreateAllocation(std::uint32_t _blockIndex, std::uint32_t _node, VkDeviceSize _offset, VkDeviceSize _size, DEVICE_MEMORY_CATEGORY _category);
+
+	//Add/remove a sub-allocation to/from the memory type and category counters
+	void RecordAllocation(const DeviceMemoryAllocation& _allocation);
+	void RecordFree(const DeviceMemoryAllocation& _allocation);
+
+	[[nodiscard]] static const char* CategoryToString(DEVICE_MEMORY_CATEGORY _category);
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	VKDebugAllocator& deviceDebugAllocator;
+	const VulkanDevice& device;
+
+	VkDeviceSize preferredBlockSize;
+	const VkPhysicalDeviceMemoryProperties& memoryProperties; //Cached by VulkanDevice
+
+	//Freed blocks leave an empty slot (memory == VK_NULL_HANDLE) so that block indices held by live allocations stay valid
+	std::vector<MemoryBlock> blocks;
+
+	//Running totals so that GetStats() doesn't have to walk every block
+	std::array<DeviceMemoryUsage, VK_MAX_MEMORY_TYPES> memoryTypeUsage;
+	std::array<DeviceMemoryUsage, DEVICE_MEMORY_CATEGORY_COUNT> categoryUsage;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
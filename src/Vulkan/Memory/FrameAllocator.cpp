@@ -0,0 +1,97 @@
+#include "FrameAllocator.h"
+#include "../../Utils/Strings/format.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+FrameAllocator::FrameAllocator(const VKLogger& _logger, const VulkanDevice& _device, BufferFactory& _bufferFactory, std::uint32_t _framesInFlight, VkDeviceSize _frameCapacity, VkBufferUsageFlags _usage)
+							  : logger(_logger), bufferFactory(_bufferFactory), framesInFlight(_framesInFlight), currentFrame(0), head(0)
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "Frame Allocator Initialised\n");
+
+	//Every offset handed out must satisfy the alignment requirement of each way the buffer can be bound
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_device.GetPhysicalDevice(), &properties);
+	alignment = 1;
+	if (_usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) { alignment = std::max(alignment, properties.limits.minUniformBufferOffsetAlignment); }
+	if (_usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) { alignment = std::max(alignment, properties.limits.minStorageBufferOffsetAlignment); }
+	frameCapacity = ((_frameCapacity + alignment - 1) / alignment) * alignment;
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "  " + std::to_string(framesInFlight) + " frame region" + std::string(framesInFlight == 1 ? "" : "s") + " of " + GetFormattedSizeString(frameCapacity) + " (" + std::to_string(alignment) + "-byte offset alignment)\n");
+
+	buffer = bufferFactory.AllocateBuffer(frameCapacity * framesInFlight, _usage, MEMORY_USAGE_INTENT::DYNAMIC, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	mappedData = static_cast<char*>(bufferFactory.GetMemory(buffer).mappedData);
+	if (mappedData == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "  Frame allocator buffer isn't persistently mapped\n");
+		throw std::runtime_error("");
+	}
+}
+
+
+
+FrameAllocator::~FrameAllocator()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "Shutting down FrameAllocator\n");
+	bufferFactory.FreeBuffer(buffer);
+}
+
+
+
+void FrameAllocator::BeginFrame(std::uint32_t _frameIndex)
+{
+	currentFrame = _frameIndex % framesInFlight;
+	head = 0;
+}
+
+
+
+FrameAllocation FrameAllocator::Allocate(VkDeviceSize _size)
+{
+	const VkDeviceSize alignedSize{ ((_size + alignment - 1) / alignment) * alignment };
+	if (head + alignedSize > frameCapacity)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::FRAME_ALLOCATOR, "  Frame region exhausted - requested " + GetFormattedSizeString(_size) + " with " + GetFormattedSizeString(frameCapacity - head) + " remaining\n");
+		throw std::runtime_error("");
+	}
+
+	const VkDeviceSize offset{ currentFrame * frameCapacity + head };
+	head += alignedSize;
+
+	FrameAllocation allocation{};
+	allocation.mappedData = mappedData + offset;
+	allocation.offset = static_cast<std::uint32_t>(offset);
+	allocation.size = _size;
+	return allocation;
+}
+
+
+
+VkBuffer FrameAllocator::GetBuffer() const
+{
+	return bufferFactory.GetBuffer(buffer);
+}
+
+
+
+VkDeviceSize FrameAllocator::GetFrameCapacity() const
+{
+	return frameCapacity;
+}
+
+
+
+VkDeviceSize FrameAllocator::GetUsedSize() const
+{
+	return head;
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include "BufferFactory.h"
+
+//Responsible for handing out transient per-frame data (e.g.: per-object uniforms) from one persistently mapped buffer
+//The buffer is split into one region per frame in flight - each region is a linear (bump) allocator that is reset wholesale once its frame's fence has signalled
+namespace Neki
+{
+
+
+//A slice of the current frame's region
+//Write to mappedData, then bind FrameAllocator::GetBuffer() with offset as a dynamic offset (or as a plain buffer offset)
+struct FrameAllocation
+{
+	void* mappedData;
+	std::uint32_t offset;
+	VkDeviceSize size;
+};
+
+
+class FrameAllocator
+{
+public:
+	explicit FrameAllocator(const VKLogger& _logger,
+							const VulkanDevice& _device,
+							BufferFactory& _bufferFactory,
+							std::uint32_t _framesInFlight,
+							VkDeviceSize _frameCapacity,
+							VkBufferUsageFlags _usage=VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+	~FrameAllocator();
+
+	//Reset _frameIndex's region and make it the target of subsequent Allocate() calls
+	//Only call once the fence of the frame that last used _frameIndex has signalled (i.e.: after VulkanRenderManager::StartFrame())
+	void BeginFrame(std::uint32_t _frameIndex);
+
+	//Bump-allocate _size bytes from the current frame's region
+	//Offsets are aligned to the device's minimum uniform/storage buffer offset alignment
+	[[nodiscard]] FrameAllocation Allocate(VkDeviceSize _size);
+
+	//Allocate sizeof(T) bytes and copy _data into them
+	template<typename T>
+	[[nodiscard]] FrameAllocation Push(const T& _data)
+	{
+		const FrameAllocation allocation{ Allocate(sizeof(T)) };
+		*static_cast<T*>(allocation.mappedData) = _data;
+		return allocation;
+	}
+
+	[[nodiscard]] VkBuffer GetBuffer() const;
+	[[nodiscard]] VkDeviceSize GetFrameCapacity() const;
+	[[nodiscard]] VkDeviceSize GetUsedSize() const;
+
+
+private:
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	BufferFactory& bufferFactory;
+
+	BufferHandle buffer;
+	char* mappedData;
+
+	std::uint32_t framesInFlight;
+	VkDeviceSize frameCapacity; //Rounded up to alignment so every frame's region starts aligned
+	VkDeviceSize alignment;
+
+	std::uint32_t currentFrame;
+	VkDeviceSize head; //Bytes used in the current frame's region
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
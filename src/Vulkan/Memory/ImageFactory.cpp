@@ -5,6 +5,12 @@
 #include <climits>
 #include <stdexcept>
 #include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
 
 
 namespace Neki
@@ -12,11 +18,14 @@ namespace Neki
 
 
 
-ImageFactory::ImageFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, VulkanCommandPool& _commandPool, BufferFactory& _bufferFactory)
-						  : logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), commandPool(_commandPool), bufferFactory(_bufferFactory)
+ImageFactory::ImageFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDebugAllocator, const VulkanDevice& _device, DeviceMemoryPool& _memoryPool, VulkanCommandPool& _commandPool, BufferFactory& _bufferFactory, const std::string& _textureCacheDirectory)
+						  : logger(_logger), deviceDebugAllocator(_deviceDebugAllocator), device(_device), memoryPool(_memoryPool), commandPool(_commandPool), bufferFactory(_bufferFactory), textureCache(_textureCacheDirectory)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::IMAGE_FACTORY, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::IMAGE_FACTORY, "Image Factory Initialised\n");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + std::to_string(decodePool.GetThreadCount()) + " image decode thread" + std::string(decodePool.GetThreadCount() == 1 ? "" : "s") + "\n");
+	if (textureCache.IsEnabled()) { logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture cache in " + _textureCacheDirectory + "\n"); }
+	else if (!_textureCacheDirectory.empty()) { logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to create texture cache directory " + _textureCacheDirectory + " - texture cache disabled\n"); }
 }
 
 
@@ -24,37 +33,71 @@ ImageFactory::ImageFactory(const VKLogger& _logger, VKDebugAllocator& _deviceDeb
 ImageFactory::~ImageFactory()
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::IMAGE_FACTORY,"Shutting down ImageFactory\n");
-	while (!imageViewImageMap.empty())
+	for (std::uint32_t i{ 0 }; i<imageViewHandles.GetCapacity(); ++i)
 	{
-		VkImageView imgView{ imageViewImageMap.begin()->first };
+		ImageViewHandle imgView{ imageViewHandles.GetHandle(i) };
+		if (imgView.IsNull()) { continue; }
+		imageViewReferenceCounts[i] = 1; //Destroy the view regardless of any outstanding references
 		FreeImageViewImpl(imgView);
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  All image views freed\n");
-	while (!imageMemoryMap.empty())
+	for (std::uint32_t i{ 0 }; i<imageHandles.GetCapacity(); ++i)
 	{
-		VkImage img{ imageMemoryMap.begin()->first };
-		FreeImageImpl(img);
+		ImageHandle img{ imageHandles.GetHandle(i) };
+		if (!img.IsNull()) { FreeImageImpl(img); }
 	}
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  All images and underlying memory freed\n");
-	while (!samplers.empty()) {
-		//Get sampler from back for efficient removal from vector
-		VkSampler sampler = samplers.back();
-		FreeSamplerImpl(sampler);
+	for (const std::pair<const VkSampler, SamplerEntry>& sampler : samplers)
+	{
+		vkDestroySampler(device.GetDevice(), sampler.first, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 	}
+	samplers.clear();
+	samplerCache.clear();
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  All images and underlying memory freed\n");
 }
 
 
 
-VkImage ImageFactory::AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata)
+ImageHandle ImageFactory::AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket, bool _generateMipmaps)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating 1 Image And Associated Memory\n");
-	return AllocateImageImpl(_filepath, _flags, _out_metadata);
+	return AllocateImageImpl(_filepath, _flags, _out_metadata, _out_ticket, _generateMipmaps);
+}
+
+
+
+ImageHandle ImageFactory::AddImageUpload(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Adding 1 Image Upload To Batch\n");
+	return AddImageUploadImpl(_batch, _filepath, _flags, _out_metadata, _generateMipmaps);
+}
+
+
+
+ImageHandle ImageFactory::AllocateImage(const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating 1 Packed Image And Associated Memory\n");
+	UploadBatch batch;
+	VkDeviceSize stagingSize;
+	ImageHandle image{ AddPackedImageUploadImpl(batch, _pack, _name, _flags, _out_metadata, 0, stagingSize) };
+	const UploadTicket ticket{ bufferFactory.SubmitUploadBatch(batch) };
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture upload to device local memory submitted\n");
+	return image;
+}
+
+
+
+ImageHandle ImageFactory::AddImageUpload(UploadBatch& _batch, const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, std::uint32_t _baseMipLevel)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Adding 1 Packed Image Upload To Batch\n");
+	VkDeviceSize stagingSize;
+	return AddPackedImageUploadImpl(_batch, _pack, _name, _flags, _out_metadata, _baseMipLevel, stagingSize);
 }
 
 
 
-VkImage ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags)
+ImageHandle ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating 1 Empty Image And Associated Memory\n");
 	return AllocateImageImpl(_size, _format, _flags);
@@ -62,33 +105,158 @@ VkImage ImageFactory::AllocateImage(VkExtent2D _size, VkFormat _format, const Vk
 
 
 
-std::vector<VkImage> ImageFactory::AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata)
+std::vector<ImageHandle> ImageFactory::AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket, bool _generateMipmaps)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating " + std::to_string(_count) + " Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkImage> images;
-	for (std::size_t i{ 0 }; i<_count; ++i)
+
+	//Images are processed in chunks of up to half the staging ring - each chunk's files are decoded in parallel on the decode pool straight into staging memory
+	//A chunk is submitted as soon as its last decode finishes, so its GPU copies overlap the decoding of the next chunk
+	const VkDeviceSize chunkSizeThreshold{ bufferFactory.GetStagingRingSize() / 2 };
+	std::vector<ImageHandle> allocatedImages(_count);
+	std::exception_ptr firstException{ nullptr };
+	UploadTicket ticket{ 0 };
+	std::uint32_t nextImage{ 0 };
+	while (nextImage < _count)
+	{
+		//Allocate the chunk's images and staging memory and start decoding into it
+		const std::shared_ptr<DecodeBatch> chunk{ std::make_shared<DecodeBatch>() };
+		UploadBatch batch;
+		std::vector<ImageFile> files;
+		std::vector<CachedTexture> cachedTextures;
+		VkDeviceSize chunkSize{ 0 };
+		while (nextImage < _count && chunkSize < chunkSizeThreshold)
+		{
+			const std::uint32_t i{ nextImage++ };
+
+			//Compressed files need no decoding - their blocks are copied straight to staging memory on this thread
+			if (CompressedImageLoader::IsCompressedImageFile(_filepaths[i]))
+			{
+				VkDeviceSize stagingSize{ 0 };
+				try { allocatedImages[i] = AddCompressedImageUploadImpl(batch, _filepaths[i], _flags[i], _out_metadata == nullptr ? nullptr : &(_out_metadata[i]), _generateMipmaps, stagingSize); }
+				catch (...)
+				{
+					logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to load " + std::string(_filepaths[i]) + "\n");
+					if (firstException == nullptr) { firstException = std::current_exception(); }
+				}
+				chunkSize += stagingSize;
+				continue;
+			}
+
+			//Cache hits skip decoding - their pixels are copied from the mapped cache entry to staging memory on the decode pool
+			CachedTexture cachedTexture{};
+			if (textureCache.Find(_filepaths[i], cachedTexture))
+			{
+				logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Found decoded " + std::string(_filepaths[i]) + " in texture cache\n");
+				void* stagingData;
+				try { allocatedImages[i] = AddImageFileUploadImpl(batch, cachedTexture.metadata, _filepaths[i], _flags[i], _out_metadata == nullptr ? nullptr : &(_out_metadata[i]), _generateMipmaps, stagingData); }
+				catch (...)
+				{
+					logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to allocate " + std::string(_filepaths[i]) + "\n");
+					if (firstException == nullptr) { firstException = std::current_exception(); }
+					TextureCache::Close(cachedTexture);
+					continue;
+				}
+				const std::size_t imageSize{ static_cast<std::size_t>(cachedTexture.metadata.width) * cachedTexture.metadata.height * cachedTexture.metadata.channels };
+				chunkSize += static_cast<VkDeviceSize>(imageSize);
+				cachedTextures.push_back(cachedTexture);
+				SubmitDecode(chunk, [pixels = cachedTexture.pixels, stagingData, imageSize]() { memcpy(stagingData, pixels, imageSize); }, _filepaths[i]);
+				continue;
+			}
+
+			//Keep going after a failure so that every started decode is waited on and every collected file is closed, then rethrow the first failure once the rest have been uploaded
+			ImageFile file{};
+			try { file = ImageLoader::Open(_filepaths[i]); }
+			catch (...)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to open " + std::string(_filepaths[i]) + "\n");
+				if (firstException == nullptr) { firstException = std::current_exception(); }
+				continue;
+			}
+
+			void* stagingData;
+			try { allocatedImages[i] = AddImageFileUploadImpl(batch, file.metadata, _filepaths[i], _flags[i], _out_metadata == nullptr ? nullptr : &(_out_metadata[i]), _generateMipmaps, stagingData); }
+			catch (...)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to allocate " + std::string(_filepaths[i]) + "\n");
+				if (firstException == nullptr) { firstException = std::current_exception(); }
+				ImageLoader::Close(file);
+				continue;
+			}
+			chunkSize += static_cast<VkDeviceSize>(file.metadata.width) * file.metadata.height * file.metadata.channels;
+			files.push_back(file);
+			SubmitDecode(chunk, [this, file, stagingData, filepath = std::string(_filepaths[i])]() { DecodeImageFile(file, filepath, stagingData); }, _filepaths[i]);
+		}
+
+		//Wait for the chunk's decodes to land in staging memory and submit its uploads
+		//An image whose decode failed is still uploaded (with undefined contents) as its copy is already part of the batch
+		WaitForDecodes(*chunk);
+		for (ImageFile& file : files) { ImageLoader::Close(file); }
+		for (CachedTexture& cachedTexture : cachedTextures) { TextureCache::Close(cachedTexture); }
+		if (chunk->exception != nullptr)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to decode " + chunk->failedFilepath + "\n");
+			if (firstException == nullptr) { firstException = chunk->exception; }
+		}
+		if (!batch.imageCopies.empty()) { ticket = bufferFactory.SubmitUploadBatch(batch); }
+	}
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+
+	if (firstException != nullptr) { std::rethrow_exception(firstException); }
+	return allocatedImages;
+}
+
+
+
+ImageHandle ImageFactory::AllocateAtlas(std::uint32_t _count, const char** _filepaths, VkExtent2D _layerSize, const VkImageUsageFlags _flags, AtlasRegion* _out_regions, UploadTicket* _out_ticket)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating 1 Atlas Of " + std::to_string(_count) + " Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	return AllocateAtlasImpl(_count, _filepaths, _layerSize, _flags, _out_regions, _out_ticket);
+}
+
+
+
+std::vector<ImageHandle> ImageFactory::AllocateImages(std::uint32_t _count, const AssetPack& _pack, const char** _names, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating " + std::to_string(_count) + " Packed Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
+
+	//Nothing needs decoding, so this is just a sequential walk through the pack - submit whenever the batch holds half the staging ring so the GPU copies overlap the rest of the walk
+	const VkDeviceSize batchSizeThreshold{ bufferFactory.GetStagingRingSize() / 2 };
+	UploadBatch batch;
+	VkDeviceSize batchSize{ 0 };
+	UploadTicket ticket{ 0 };
+	std::vector<ImageHandle> allocatedImages;
+	for (std::uint32_t i{ 0 }; i<_count; ++i)
 	{
-		images.push_back(AllocateImageImpl(_filepaths[i], _flags[i], &(_out_metadata[i])));
+		VkDeviceSize stagingSize;
+		allocatedImages.push_back(AddPackedImageUploadImpl(batch, _pack, _names[i], _flags[i], _out_metadata == nullptr ? nullptr : &(_out_metadata[i]), 0, stagingSize));
+		batchSize += stagingSize;
+		if (batchSize >= batchSizeThreshold)
+		{
+			ticket = bufferFactory.SubmitUploadBatch(batch);
+			batchSize = 0;
+		}
 	}
-	return images;
+	if (!batch.imageCopies.empty()) { ticket = bufferFactory.SubmitUploadBatch(batch); }
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+	return allocatedImages;
 }
 
 
 
-std::vector<VkImage> ImageFactory::AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags)
+std::vector<ImageHandle> ImageFactory::AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Allocating " + std::to_string(_count) + " Empty Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkImage> images;
+	std::vector<ImageHandle> allocatedImages;
 	for (std::size_t i{ 0 }; i<_count; ++i)
 	{
-		images.push_back(AllocateImageImpl(_sizes[i], _formats[i], _flags[i]));
+		allocatedImages.push_back(AllocateImageImpl(_sizes[i], _formats[i], _flags[i]));
 	}
-	return images;
+	return allocatedImages;
 }
 
 
 
-void ImageFactory::FreeImage(VkImage& _image)
+void ImageFactory::FreeImage(ImageHandle& _image)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Freeing 1 Image And Associated Memory\n");
 	FreeImageImpl(_image);
@@ -96,7 +264,7 @@ void ImageFactory::FreeImage(VkImage& _image)
 
 
 
-void ImageFactory::FreeImages(std::uint32_t _count, VkImage* _images)
+void ImageFactory::FreeImages(std::uint32_t _count, ImageHandle* _images)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Freeing " + std::to_string(_count) + " Image" + std::string(_count == 1 ? "" : "s") + " And Associated Memory\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	for (std::size_t i{ 0 }; i<_count; ++i)
@@ -107,8 +275,9 @@ void ImageFactory::FreeImages(std::uint32_t _count, VkImage* _images)
 
 
 
-void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask, VkImage& _image, VkCommandBuffer* _commandBuffer)
+void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout, VkImageAspectFlags _aspectMask, VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask, VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask, ImageHandle _image, VkCommandBuffer* _commandBuffer)
 {
+	const VkImage image{ GetImage(_image) };
 	VkCommandBuffer commandBuffer{ _commandBuffer == nullptr ? commandPool.AllocateCommandBuffer() : *_commandBuffer };
 	if (_commandBuffer == nullptr)
 	{
@@ -126,15 +295,16 @@ void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstL
 	barrier.newLayout = _dstLayout;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = _image;
+	barrier.image = image;
 	barrier.subresourceRange.aspectMask = _aspectMask;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = 1;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.layerCount = imageArrayLayers[_image.index];
 	barrier.srcAccessMask = _srcAccessMask;
 	barrier.dstAccessMask = _dstAccessMask;
 	vkCmdPipelineBarrier(commandBuffer, _srcStageMask, _dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	imageStates[_image.index][0] = ImageState{ _dstLayout, _dstAccessMask, _dstStageMask };
 
 	if (_commandBuffer == nullptr)
 	{
@@ -154,7 +324,7 @@ void ImageFactory::TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstL
 
 
 
-VkImageView ImageFactory::CreateImageView(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags)
+ImageViewHandle ImageFactory::CreateImageView(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Creating 1 Image View\n");
 	return CreateImageViewImpl(_image, _format, _aspectFlags);
@@ -162,20 +332,20 @@ VkImageView ImageFactory::CreateImageView(const VkImage& _image, const VkFormat&
 
 
 
-std::vector<VkImageView> ImageFactory::CreateImageViews(std::uint32_t _count, const VkImage* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags)
+std::vector<ImageViewHandle> ImageFactory::CreateImageViews(std::uint32_t _count, const ImageHandle* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Creating " + std::to_string(_count) + " Image View" + std::string(_count == 1 ? "" : "s") + "\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	std::vector<VkImageView> imageViews;
+	std::vector<ImageViewHandle> createdImageViews;
 	for (std::size_t i{ 0 }; i<_count; ++i)
 	{
-		imageViews.push_back(CreateImageViewImpl(_images[i], _formats[i], _aspectFlags[i]));
+		createdImageViews.push_back(CreateImageViewImpl(_images[i], _formats[i], _aspectFlags[i]));
 	}
-	return imageViews;
+	return createdImageViews;
 }
 
 
 
-void ImageFactory::FreeImageView(VkImageView& _imageView)
+void ImageFactory::FreeImageView(ImageViewHandle& _imageView)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Freeing 1 Image View\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	FreeImageViewImpl(_imageView);
@@ -183,7 +353,7 @@ void ImageFactory::FreeImageView(VkImageView& _imageView)
 
 
 
-void ImageFactory::FreeImageViews(std::uint32_t _count, VkImageView* _imageViews)
+void ImageFactory::FreeImageViews(std::uint32_t _count, ImageViewHandle* _imageViews)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Freeing " + std::to_string(_count) + " Image View" + std::string(_count == 1 ? "" : "s") + "\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	for (std::size_t i{ 0 }; i<_count; ++i)
@@ -194,6 +364,170 @@ void ImageFactory::FreeImageViews(std::uint32_t _count, VkImageView* _imageViews
 
 
 
+void ImageFactory::RequireImageState(ImageBarrierBatch& _batch, ImageHandle _image, const ImageState& _state, std::uint32_t _baseMipLevel, std::uint32_t _levelCount, bool _discardContents)
+{
+	const std::uint32_t slot{ GetSlot(_image) };
+	const std::uint32_t levelCount{ _levelCount == VK_REMAINING_MIP_LEVELS ? imageMipLevels[slot] - _baseMipLevel : _levelCount };
+	if (_baseMipLevel + levelCount > imageMipLevels[slot])
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mip levels [" + std::to_string(_baseMipLevel) + ", " + std::to_string(_baseMipLevel + levelCount) + ") exceed the image's " + std::to_string(imageMipLevels[slot]) + " level" + std::string(imageMipLevels[slot] == 1 ? "" : "s") + "\n");
+		throw std::runtime_error("");
+	}
+
+	const VkFormat format{ imageFormats[slot] };
+	const bool isDepth{ format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+						format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT };
+	const bool isStencil{ format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT };
+	const VkImageAspectFlags aspectMask{ isDepth || isStencil ? static_cast<VkImageAspectFlags>((isDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : 0) | (isStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0)) : static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_COLOR_BIT) };
+
+	//Every access flag that writes memory - only these need making available by a barrier
+	constexpr VkAccessFlags writeAccessMask{ VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+											 VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT };
+
+	for (std::uint32_t level{ _baseMipLevel }; level < _baseMipLevel + levelCount; ++level)
+	{
+		ImageState& current{ imageStates[slot][level] };
+		const VkAccessFlags currentWrites{ current.accessMask & writeAccessMask };
+		const bool isLayoutChange{ current.layout != _state.layout };
+		const bool isWrite{ (_state.accessMask & writeAccessMask) != 0 };
+
+		//Read-after-read in the same layout needs no barrier as long as an earlier barrier already made prior writes visible to these stages and accesses
+		if (!isLayoutChange && !isWrite && currentWrites == 0)
+		{
+			if ((_state.stageMask & ~current.stageMask) == 0 && (_state.accessMask & ~current.accessMask) == 0) { continue; }
+		}
+
+		//Only writes need making available - a write-after-read hazard is just an execution dependency on the readers
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.oldLayout = _discardContents ? VK_IMAGE_LAYOUT_UNDEFINED : current.layout;
+		barrier.newLayout = _state.layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = images[slot];
+		barrier.subresourceRange.aspectMask = aspectMask;
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = imageArrayLayers[slot];
+		barrier.srcAccessMask = currentWrites;
+		barrier.dstAccessMask = _state.accessMask;
+
+		//Merge with the previous level's barrier if it's otherwise identical
+		VkImageMemoryBarrier* previous{ _batch.barriers.empty() ? nullptr : &_batch.barriers.back() };
+		if (previous != nullptr && previous->image == barrier.image && previous->oldLayout == barrier.oldLayout && previous->newLayout == barrier.newLayout &&
+			previous->srcAccessMask == barrier.srcAccessMask && previous->dstAccessMask == barrier.dstAccessMask &&
+			previous->subresourceRange.baseMipLevel + previous->subresourceRange.levelCount == level)
+		{
+			++previous->subresourceRange.levelCount;
+		}
+		else
+		{
+			_batch.barriers.push_back(barrier);
+		}
+		_batch.srcStageMask |= current.stageMask;
+		_batch.dstStageMask |= _state.stageMask;
+
+		//Readers accumulate so that the next write waits on all of them
+		if (!isLayoutChange && !isWrite && currentWrites == 0)
+		{
+			current.accessMask |= _state.accessMask;
+			current.stageMask |= _state.stageMask;
+		}
+		else
+		{
+			current = _state;
+		}
+	}
+}
+
+
+
+void ImageFactory::RecordBarrierBatch(ImageBarrierBatch& _batch, VkCommandBuffer _commandBuffer) const
+{
+	if (!_batch.barriers.empty())
+	{
+		//A source stage mask of 0 (nothing has touched the image yet) isn't valid without synchronization2
+		const VkPipelineStageFlags srcStageMask{ _batch.srcStageMask == 0 ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) : _batch.srcStageMask };
+		vkCmdPipelineBarrier(_commandBuffer, srcStageMask, _batch.dstStageMask, 0, 0, nullptr, 0, nullptr, static_cast<std::uint32_t>(_batch.barriers.size()), _batch.barriers.data());
+	}
+	_batch.barriers.clear();
+	_batch.srcStageMask = 0;
+	_batch.dstStageMask = 0;
+}
+
+
+
+void ImageFactory::SetImageState(ImageHandle _image, const ImageState& _state, std::uint32_t _baseMipLevel, std::uint32_t _levelCount)
+{
+	const std::uint32_t slot{ GetSlot(_image) };
+	const std::uint32_t levelCount{ _levelCount == VK_REMAINING_MIP_LEVELS ? imageMipLevels[slot] - _baseMipLevel : _levelCount };
+	if (_baseMipLevel + levelCount > imageMipLevels[slot])
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mip levels [" + std::to_string(_baseMipLevel) + ", " + std::to_string(_baseMipLevel + levelCount) + ") exceed the image's " + std::to_string(imageMipLevels[slot]) + " level" + std::string(imageMipLevels[slot] == 1 ? "" : "s") + "\n");
+		throw std::runtime_error("");
+	}
+	std::fill_n(imageStates[slot].begin() + _baseMipLevel, levelCount, _state);
+}
+
+
+
+ImageState ImageFactory::GetImageState(ImageHandle _image, std::uint32_t _mipLevel) const
+{
+	const std::uint32_t slot{ GetSlot(_image) };
+	if (_mipLevel >= imageMipLevels[slot])
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mip level " + std::to_string(_mipLevel) + " out of range (image has " + std::to_string(imageMipLevels[slot]) + ")\n");
+		throw std::runtime_error("");
+	}
+	return imageStates[slot][_mipLevel];
+}
+
+
+
+bool ImageFactory::IsValid(ImageHandle _image) const
+{
+	return imageHandles.IsValid(_image);
+}
+
+
+
+VkImage ImageFactory::GetImage(ImageHandle _image) const
+{
+	return images[GetSlot(_image)];
+}
+
+
+
+VkFormat ImageFactory::GetFormat(ImageHandle _image) const
+{
+	return imageFormats[GetSlot(_image)];
+}
+
+
+
+std::uint32_t ImageFactory::GetMipLevels(ImageHandle _image) const
+{
+	return imageMipLevels[GetSlot(_image)];
+}
+
+
+
+bool ImageFactory::IsValid(ImageViewHandle _imageView) const
+{
+	return imageViewHandles.IsValid(_imageView);
+}
+
+
+
+VkImageView ImageFactory::GetImageView(ImageViewHandle _imageView) const
+{
+	return imageViews[GetSlot(_imageView)];
+}
+
+
+
 VkSampler ImageFactory::CreateSampler(const VkSamplerCreateInfo& _createInfo)
 {
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY,"Creating 1 Sampler\n");
@@ -234,80 +568,271 @@ void ImageFactory::FreeSampler(std::uint32_t _count, VkSampler* _samplers)
 
 
 
-VkImage ImageFactory::AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata)
+ImageHandle ImageFactory::AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket, bool _generateMipmaps)
 {
-	//Load the data to disk
-	ImageData imgData{ ImageLoader::Load(_filepath) };
-	if (_out_metadata != nullptr) { *_out_metadata = imgData.metadata; }
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Loaded " + std::string(_filepath) + " from disk (" + std::to_string(imgData.metadata.width) + "x" + std::to_string(imgData.metadata.height) + ", " + std::to_string(imgData.metadata.channels) + " channels)\n");
+	//A single image is just a batch of one
+	UploadBatch batch;
+	ImageHandle image{ AddImageUploadImpl(batch, _filepath, _flags, _out_metadata, _generateMipmaps) };
+	const UploadTicket ticket{ bufferFactory.SubmitUploadBatch(batch) };
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture upload to device local memory submitted\n");
 
-	//Create temporary staging buffer
-	const VkDeviceSize imgSize{ static_cast<VkDeviceSize>(imgData.metadata.width * imgData.metadata.height * imgData.metadata.channels) }; //Assume 1 byte per channel
-	VkBuffer stagingBuffer{ bufferFactory.AllocateBuffer(imgSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Created temporary staging buffer of size " + GetFormattedSizeString(imgSize) + "\n");
-	
-	//Copy pixel data to staging buffer
-	void* mappedMemory;
-	vkMapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer), 0, imgSize, 0, &mappedMemory);
-	memcpy(mappedMemory, imgData.pixels, imgSize);
-	vkUnmapMemory(device.GetDevice(), bufferFactory.GetMemory(stagingBuffer));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel Data copied to staging buffer\n");
+	return image;
+}
+
+
+
+ImageHandle ImageFactory::AddImageUploadImpl(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps)
+{
+	if (CompressedImageLoader::IsCompressedImageFile(_filepath))
+	{
+		VkDeviceSize stagingSize;
+		return AddCompressedImageUploadImpl(_batch, _filepath, _flags, _out_metadata, _generateMipmaps, stagingSize);
+	}
+
+	void* stagingData;
+	ImageHandle image;
+
+	//Cache hits skip decoding - copy the pixels straight from the mapped cache entry to staging memory
+	CachedTexture cachedTexture{};
+	if (textureCache.Find(_filepath, cachedTexture))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Found decoded " + std::string(_filepath) + " in texture cache\n");
+		try
+		{
+			image = AddImageFileUploadImpl(_batch, cachedTexture.metadata, _filepath, _flags, _out_metadata, _generateMipmaps, stagingData);
+			memcpy(stagingData, cachedTexture.pixels, static_cast<std::size_t>(cachedTexture.metadata.width) * cachedTexture.metadata.height * cachedTexture.metadata.channels);
+		}
+		catch (...)
+		{
+			TextureCache::Close(cachedTexture);
+			throw;
+		}
+		TextureCache::Close(cachedTexture);
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel data copied into staging memory\n");
+		return image;
+	}
 
-	//Free the host-side image data as it's on the device now
-	ImageLoader::Free(imgData.pixels);
+	//Map the file and read its header, then decode it straight into the staging memory it's uploaded from
+	ImageFile file{ ImageLoader::Open(_filepath) };
+	try
+	{
+		image = AddImageFileUploadImpl(_batch, file.metadata, _filepath, _flags, _out_metadata, _generateMipmaps, stagingData);
+		DecodeImageFile(file, _filepath, stagingData);
+	}
+	catch (...)
+	{
+		ImageLoader::Close(file);
+		throw;
+	}
+	ImageLoader::Close(file);
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Pixel data decoded into staging memory\n");
+
+	return image;
+}
+
+
+
+ImageHandle ImageFactory::AddImageFileUploadImpl(UploadBatch& _batch, const ImageMetadata& _imageMetadata, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps, void*& _out_stagingData)
+{
+	if (_out_metadata != nullptr) { *_out_metadata = _imageMetadata; }
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mapped " + std::string(_filepath) + " (" + std::to_string(_imageMetadata.width) + "x" + std::to_string(_imageMetadata.height) + ", " + std::to_string(_imageMetadata.channels) + " channels)\n");
+
+	//Reserve room in the staging ring for the decoded pixels - the caller decodes into it before the batch is submitted
+	//Offset must be a multiple of both the texel size and 4 for vkCmdCopyBufferToImage
+	const VkDeviceSize imgSize{ static_cast<VkDeviceSize>(_imageMetadata.width) * _imageMetadata.height * _imageMetadata.channels }; //Assume 1 byte per channel
+	const StagingAllocation staging{ bufferFactory.AllocateStagingMemory(imgSize, static_cast<VkDeviceSize>(_imageMetadata.channels) * 4) };
+	_out_stagingData = staging.mappedData;
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Reserved " + GetFormattedSizeString(imgSize) + " of staging memory at offset " + std::to_string(staging.offset) + "\n");
 
 	//Create destination image in device local memory
-	VkImage image{ AllocateImageImpl(VkExtent2D(imgData.metadata.width, imgData.metadata.height), imgData.metadata.channels == 4 ? VK_FORMAT_R8G8B8A8_SRGB : (imgData.metadata.channels == 3 ? VK_FORMAT_R8G8B8_SRGB : (imgData.metadata.channels == 2 ? VK_FORMAT_R8G8_SRGB : VK_FORMAT_R8_SRGB)), _flags) };
-	
-	//Record command buffer for copy command
-	VkCommandBuffer commandBuffer{ commandPool.AllocateCommandBuffer() };
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.pNext = nullptr;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	TransitionImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,  image, &commandBuffer);
-
-	//Copy the staging buffer to the image
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { static_cast<std::uint32_t>(imgData.metadata.width), static_cast<std::uint32_t>(imgData.metadata.height), 1 };
-	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	TransitionImage(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,  image, &commandBuffer);
-
-	vkEndCommandBuffer(commandBuffer);
-
-	//Execute the command buffer
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-	vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(device.GetGraphicsQueue());
-
-
-	//Cleanup
-	commandPool.FreeCommandBuffer(commandBuffer);
-	bufferFactory.FreeBuffer(stagingBuffer);
-
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Texture data successfully transferred to device local memory\n");
+	const VkExtent2D size{ static_cast<std::uint32_t>(_imageMetadata.width), static_cast<std::uint32_t>(_imageMetadata.height) };
+	const VkFormat format{ _imageMetadata.channels == 4 ? VK_FORMAT_R8G8B8A8_SRGB : (_imageMetadata.channels == 3 ? VK_FORMAT_R8G8B8_SRGB : (_imageMetadata.channels == 2 ? VK_FORMAT_R8G8_SRGB : VK_FORMAT_R8_SRGB)) };
+	const std::uint32_t mipLevels{ _generateMipmaps ? GetMipmapLevelCount(size, format) : 1 };
+	ImageHandle image{ AllocateImageImpl(size, format, _flags, mipLevels) };
+
+	//The copy (and mip chain generation) is recorded when the batch is submitted, after which the image is handed over to the graphics queue as SHADER_READ_ONLY_OPTIMAL
+	const VkExtent3D extent{ size.width, size.height, 1 };
+	bufferFactory.AddImageCopy(_batch, staging, images[image.index], extent, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, mipLevels);
+	imageStates[image.index].assign(mipLevels, ImageState{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
 
 	return image;
 }
 
 
 
-VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags)
+void ImageFactory::SubmitDecode(const std::shared_ptr<DecodeBatch>& _decodeBatch, std::function<void()> _decode, const char* _filepath)
+{
+	{
+		std::lock_guard<std::mutex> lock(_decodeBatch->mutex);
+		++_decodeBatch->remainingDecodes;
+	}
+	decodePool.Submit([decodeBatch = _decodeBatch, decode = std::move(_decode), filepath = std::string(_filepath)]()
+	{
+		std::exception_ptr exception{ nullptr };
+		try { decode(); }
+		catch (...) { exception = std::current_exception(); }
+		std::lock_guard<std::mutex> lock(decodeBatch->mutex);
+		if (exception != nullptr && decodeBatch->exception == nullptr)
+		{
+			decodeBatch->exception = exception;
+			decodeBatch->failedFilepath = filepath;
+		}
+		--decodeBatch->remainingDecodes;
+		decodeBatch->condition.notify_one();
+	});
+}
+
+
+
+void ImageFactory::WaitForDecodes(DecodeBatch& _decodeBatch)
+{
+	std::unique_lock<std::mutex> lock(_decodeBatch.mutex);
+	_decodeBatch.condition.wait(lock, [&_decodeBatch]{ return _decodeBatch.remainingDecodes == 0; });
+}
+
+
+
+void ImageFactory::DecodeImageFile(const ImageFile& _file, const std::string& _filepath, void* _stagingData) const
+{
+	const std::size_t rowPitch{ static_cast<std::size_t>(_file.metadata.width) * _file.metadata.channels };
+	if (!textureCache.IsEnabled())
+	{
+		ImageLoader::LoadInto(_file, _stagingData, rowPitch);
+		return;
+	}
+
+	//Decode into system memory rather than staging memory so the cache entry isn't written by reading back from (possibly write-combined) mapped device memory
+	std::vector<unsigned char> pixels(rowPitch * _file.metadata.height);
+	ImageLoader::LoadInto(_file, pixels.data(), rowPitch);
+	textureCache.Store(_filepath, _file.metadata, pixels.data());
+	memcpy(_stagingData, pixels.data(), pixels.size());
+}
+
+
+
+ImageHandle ImageFactory::AddCompressedImageUploadImpl(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps, VkDeviceSize& _out_stagingSize)
+{
+	//Map the file and locate its mip levels - the blocks are uploaded as-is with no decoding
+	CompressedImageFile file{ CompressedImageLoader::Open(_filepath) };
+	try
+	{
+		const std::uint32_t levelCount{ static_cast<std::uint32_t>(file.levels.size()) };
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mapped " + std::string(_filepath) + " (" + std::to_string(file.width) + "x" + std::to_string(file.height) + ", format " + std::to_string(file.format) + ", " + std::to_string(levelCount) + " mip level" + std::string(levelCount == 1 ? "" : "s") + ")\n");
+		if (_generateMipmaps && levelCount == 1)
+		{
+			logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Block-compressed images can't be blitted - only the stored mip level is uploaded\n");
+		}
+
+		const ImageHandle image{ AddPrebuiltImageUploadImpl(_batch, file.mappedFile.data, file.format, file.width, file.height, levelCount, file.levels.data(), _flags, _out_metadata, _out_stagingSize) };
+		CompressedImageLoader::Close(file);
+		return image;
+	}
+	catch (...)
+	{
+		CompressedImageLoader::Close(file);
+		throw;
+	}
+}
+
+
+
+ImageHandle ImageFactory::AddPackedImageUploadImpl(UploadBatch& _batch, const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, std::uint32_t _baseMipLevel, VkDeviceSize& _out_stagingSize)
+{
+	const AssetPackEntry* entry{ AssetPackReader::Find(_pack, _name) };
+	if (entry == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  No entry called " + std::string(_name) + " in asset pack\n");
+		throw std::runtime_error("");
+	}
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Found " + std::string(_name) + " in asset pack (" + std::to_string(entry->width) + "x" + std::to_string(entry->height) + ", format " + std::to_string(entry->format) + ", " + std::to_string(entry->levelCount) + " mip level" + std::string(entry->levelCount == 1 ? "" : "s") + ")\n");
+
+	//The cooked blobs are byte ranges of the mapped pack
+	const std::uint32_t baseMipLevel{ std::min(_baseMipLevel, entry->levelCount - 1) };
+	const std::uint32_t levelCount{ entry->levelCount - baseMipLevel };
+	std::vector<CompressedImageLevel> levels(levelCount);
+	for (std::uint32_t i{ 0 }; i<levelCount; ++i)
+	{
+		levels[i].offset = static_cast<std::size_t>(_pack.levels[entry->firstLevel + baseMipLevel + i].offset);
+		levels[i].size = static_cast<std::size_t>(_pack.levels[entry->firstLevel + baseMipLevel + i].size);
+	}
+	return AddPrebuiltImageUploadImpl(_batch, _pack.mappedFile.data, static_cast<VkFormat>(entry->format), std::max(entry->width >> baseMipLevel, 1u), std::max(entry->height >> baseMipLevel, 1u), levelCount, levels.data(), _flags, _out_metadata, _out_stagingSize);
+}
+
+
+
+ImageHandle ImageFactory::AddPrebuiltImageUploadImpl(UploadBatch& _batch, const unsigned char* _data, VkFormat _format, std::uint32_t _width, std::uint32_t _height, std::uint32_t _levelCount, const CompressedImageLevel* _levels, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, VkDeviceSize& _out_stagingSize)
+{
+	//The device has to be able to sample the format directly (BCn is mostly desktop-only, ETC2/ASTC mostly mobile-only)
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(device.GetPhysicalDevice(), _format, &formatProperties);
+	if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Format " + std::to_string(_format) + " can't be sampled on this device\n");
+		throw std::runtime_error("");
+	}
+
+	if (_out_metadata != nullptr)
+	{
+		_out_metadata->width = static_cast<int>(_width);
+		_out_metadata->height = static_cast<int>(_height);
+		_out_metadata->channels = (_format == VK_FORMAT_BC4_UNORM_BLOCK || _format == VK_FORMAT_BC4_SNORM_BLOCK) ? 1 : ((_format == VK_FORMAT_BC5_UNORM_BLOCK || _format == VK_FORMAT_BC5_SNORM_BLOCK) ? 2 : 4);
+	}
+
+	//Work out how many bytes vkCmdCopyBufferToImage will read for each level - the sizes stored in the file can't be trusted to cover them
+	const FormatBlockInfo block{ CompressedImageLoader::GetFormatBlockInfo(_format) };
+	if (block.size == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Format " + std::to_string(_format) + " isn't a supported single-plane colour format\n");
+		throw std::runtime_error("");
+	}
+	if (_levelCount > static_cast<std::uint32_t>(std::bit_width(std::max(_width, _height))))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  A " + std::to_string(_width) + "x" + std::to_string(_height) + " image can't have " + std::to_string(_levelCount) + " mip levels\n");
+		throw std::runtime_error("");
+	}
+	std::vector<VkDeviceSize> levelSizes(_levelCount);
+	for (std::uint32_t i{ 0 }; i<_levelCount; ++i)
+	{
+		const VkDeviceSize blocksWide{ (std::max(_width >> i, 1u) + block.width - 1) / block.width };
+		const VkDeviceSize blocksHigh{ (std::max(_height >> i, 1u) + block.height - 1) / block.height };
+		levelSizes[i] = blocksWide * blocksHigh * block.size;
+		if (_levels[i].size < levelSizes[i])
+		{
+			logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Mip level " + std::to_string(i) + " holds " + std::to_string(_levels[i].size) + " bytes but needs " + std::to_string(levelSizes[i]) + "\n");
+			throw std::runtime_error("");
+		}
+	}
+
+	//Pack every level into one staging allocation
+	//vkCmdCopyBufferToImage needs each offset to be a multiple of both the texel block size and 4 - texel blocks aren't always a power of 2 (e.g.: 3-byte RGB formats)
+	const VkDeviceSize levelAlignment{ std::lcm(static_cast<VkDeviceSize>(block.size), VkDeviceSize{ 4 }) };
+	std::vector<VkDeviceSize> levelOffsets(_levelCount);
+	_out_stagingSize = 0;
+	for (std::uint32_t i{ 0 }; i<_levelCount; ++i)
+	{
+		levelOffsets[i] = _out_stagingSize;
+		_out_stagingSize += ((levelSizes[i] + levelAlignment - 1) / levelAlignment) * levelAlignment;
+	}
+	const StagingAllocation staging{ bufferFactory.AllocateStagingMemory(_out_stagingSize, levelAlignment) };
+	for (std::uint32_t i{ 0 }; i<_levelCount; ++i)
+	{
+		memcpy(static_cast<char*>(staging.mappedData) + levelOffsets[i], _data + _levels[i].offset, static_cast<std::size_t>(levelSizes[i]));
+	}
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  GPU-ready data (" + GetFormattedSizeString(_out_stagingSize) + ") copied to staging ring at offset " + std::to_string(staging.offset) + "\n");
+
+	//Create destination image in device local memory and copy every level into it
+	ImageHandle image{ AllocateImageImpl({ _width, _height }, _format, _flags, _levelCount) };
+	const VkExtent3D extent{ _width, _height, 1 };
+	bufferFactory.AddImageMipCopies(_batch, staging, images[image.index], extent, _levelCount, levelOffsets.data(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	imageStates[image.index].assign(_levelCount, ImageState{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
+
+	return image;
+}
+
+
+
+ImageHandle ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::uint32_t _mipLevels, std::uint32_t _arrayLayers)
 {
 	VkImageCreateInfo imgInfo{};
 	imgInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -317,12 +842,12 @@ VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, cons
 	imgInfo.extent.width = _size.width;
 	imgInfo.extent.height = _size.height;
 	imgInfo.extent.depth = 1;
-	imgInfo.mipLevels = 1;
-	imgInfo.arrayLayers = 1;
+	imgInfo.mipLevels = _mipLevels;
+	imgInfo.arrayLayers = _arrayLayers;
 	imgInfo.format = _format;
 	imgInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imgInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imgInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | _flags;
+	imgInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | (_mipLevels > 1 ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0) | _flags; //Each mip level is blitted from the one above it
 	imgInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imgInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -339,67 +864,274 @@ VkImage ImageFactory::AllocateImageImpl(VkExtent2D _size, VkFormat _format, cons
 	//Find a memory type that is DEVICE_LOCAL
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Searching for compatible memory type for image that is DEVICE_LOCAL", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device.GetDevice(), image, &memRequirements);
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &memProperties);
-	std::uint32_t memTypeIndex{ UINT_MAX };
-	for (std::uint32_t i{ 0 }; i<memProperties.memoryTypeCount; ++i)
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	if (device.GetApiVersion() >= VK_API_VERSION_1_1)
 	{
-		if ((memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
-		{
-	        memTypeIndex = i;
-	        break;
-		}
+		//Also ask whether the driver wants the image in a VkDeviceMemory of its own (e.g.: render targets with compression metadata)
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		dedicatedRequirements.pNext = nullptr;
+		VkMemoryRequirements2 memRequirements2{};
+		memRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		memRequirements2.pNext = &dedicatedRequirements;
+		VkImageMemoryRequirementsInfo2 memRequirementsInfo{};
+		memRequirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		memRequirementsInfo.pNext = nullptr;
+		memRequirementsInfo.image = image;
+		vkGetImageMemoryRequirements2(device.GetDevice(), &memRequirementsInfo, &memRequirements2);
+		memRequirements = memRequirements2.memoryRequirements;
+	}
+	else
+	{
+		vkGetImageMemoryRequirements(device.GetDevice(), image, &memRequirements);
 	}
-	logger.Log(memTypeIndex != UINT_MAX ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, memTypeIndex != UINT_MAX ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (memTypeIndex == UINT_MAX)
+	const std::uint32_t memTypeIndex{ device.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_USAGE_INTENT::GPU_ONLY) };
+	logger.Log(memTypeIndex != UINT32_MAX ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, memTypeIndex != UINT32_MAX ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (memTypeIndex == UINT32_MAX)
 	{
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
+		vkDestroyImage(device.GetDevice(), image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
 		throw std::runtime_error("");
 	}
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = memTypeIndex;
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Allocating DEVICE_LOCAL memory for image", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	result = vkAllocateMemory(device.GetDevice(), &allocInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &(imageMemoryMap[image]));
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
+	//Honour the driver's dedicated allocation hint for attachments and large textures, and pool everything else (a dedicated block per small texture would just waste allocations)
+	const bool isAttachment{ (_flags & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0 };
+	const bool isDedicated{ dedicatedRequirements.requiresDedicatedAllocation == VK_TRUE ||
+							(dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE && (isAttachment || memoryPool.IsLargeAllocation(memRequirements.size, memTypeIndex))) };
+	const DEVICE_MEMORY_CATEGORY category{ isAttachment ? DEVICE_MEMORY_CATEGORY::ATTACHMENT : DEVICE_MEMORY_CATEGORY::TEXTURE };
+
+	//Sub-allocate memory for the image from the pool
+	//Memory is allocated before a handle is taken so a failure only has the image to clean up
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + std::string(isDedicated ? "Allocating dedicated" : "Sub-allocating") + " DEVICE_LOCAL memory for image from device memory pool\n");
+	DeviceMemoryAllocation allocation;
+	try
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
-		throw std::runtime_error("");
+		allocation = isDedicated ? memoryPool.AllocateDedicated(memRequirements, memTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE::OPTIMAL, category, image, VK_NULL_HANDLE)
+								 : memoryPool.Allocate(memRequirements, memTypeIndex, DEVICE_MEMORY_RESOURCE_TYPE::OPTIMAL, category);
+	}
+	catch (...)
+	{
+		vkDestroyImage(device.GetDevice(), image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		throw;
+	}
+
+	const ImageHandle handle{ imageHandles.Allocate() };
+	if (handle.index >= images.size())
+	{
+		images.resize(imageHandles.GetCapacity(), VK_NULL_HANDLE);
+		imageAllocations.resize(imageHandles.GetCapacity());
+		imageExtents.resize(imageHandles.GetCapacity());
+		imageFormats.resize(imageHandles.GetCapacity(), VK_FORMAT_UNDEFINED);
+		imageMipLevels.resize(imageHandles.GetCapacity(), 1);
+		imageArrayLayers.resize(imageHandles.GetCapacity(), 1);
+		imageViewTypes.resize(imageHandles.GetCapacity(), VK_IMAGE_VIEW_TYPE_2D);
+		imageStates.resize(imageHandles.GetCapacity());
 	}
+	images[handle.index] = image;
+	imageAllocations[handle.index] = allocation;
+	imageExtents[handle.index] = imgInfo.extent;
+	imageFormats[handle.index] = _format;
+	imageMipLevels[handle.index] = _mipLevels;
+	imageArrayLayers[handle.index] = _arrayLayers;
+	imageViewTypes[handle.index] = _arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	imageStates[handle.index].assign(_mipLevels, ImageState{ VK_IMAGE_LAYOUT_UNDEFINED, 0, 0 });
 	
 	//Bind the allocated memory to the VkImage handle
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Binding allocated memory to image\n");
-	vkBindImageMemory(device.GetDevice(), image, imageMemoryMap[image], 0);
+	vkBindImageMemory(device.GetDevice(), image, imageAllocations[handle.index].memory, imageAllocations[handle.index].offset);
 
-	return image;
+	return handle;
 }
 
 
 
-void ImageFactory::FreeImageImpl(VkImage& _image)
+ImageHandle ImageFactory::AllocateAtlasImpl(std::uint32_t _count, const char** _filepaths, VkExtent2D _layerSize, const VkImageUsageFlags _flags, AtlasRegion* _out_regions, UploadTicket* _out_ticket)
 {
-	if (imageMemoryMap[_image] != VK_NULL_HANDLE)
+	if (_count == 0)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  An atlas needs at least one image\n");
+		throw std::runtime_error("");
+	}
+
+	//Every image's size is needed before anything can be packed, so read each file's header (or texture cache entry) up front
+	struct AtlasSource
+	{
+		ImageFile file;
+		CachedTexture cachedTexture;
+		ImageMetadata metadata;
+		VkDeviceSize stagingOffset;
+	};
+	std::vector<AtlasSource> sources(_count);
+	const auto closeSources{ [&sources]()
+	{
+		for (AtlasSource& source : sources)
+		{
+			if (source.cachedTexture.mappedFile.data != nullptr) { TextureCache::Close(source.cachedTexture); }
+			if (source.file.mappedFile.data != nullptr) { ImageLoader::Close(source.file); }
+		}
+	} };
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &properties);
+	std::vector<RectanglePacker> layers;
+	VkDeviceSize stagingSize{ 0 };
+	try
+	{
+		for (std::uint32_t i{ 0 }; i<_count; ++i)
+		{
+			if (CompressedImageLoader::IsCompressedImageFile(_filepaths[i]))
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + std::string(_filepaths[i]) + " is block-compressed and can't be packed into an atlas\n");
+				throw std::runtime_error("");
+			}
+			AtlasSource& source{ sources[i] };
+			if (textureCache.Find(_filepaths[i], source.cachedTexture)) { source.metadata = source.cachedTexture.metadata; }
+			else
+			{
+				source.file = ImageLoader::Open(_filepaths[i]);
+				source.metadata = source.file.metadata;
+			}
+			if (static_cast<std::uint32_t>(source.metadata.width) > _layerSize.width || static_cast<std::uint32_t>(source.metadata.height) > _layerSize.height)
+			{
+				logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  " + std::string(_filepaths[i]) + " (" + std::to_string(source.metadata.width) + "x" + std::to_string(source.metadata.height) + ") doesn't fit in a " + std::to_string(_layerSize.width) + "x" + std::to_string(_layerSize.height) + " atlas layer\n");
+				throw std::runtime_error("");
+			}
+
+			//Every image is decoded to RGBA8, so each one's staging offset is already a multiple of the texel size and 4
+			source.stagingOffset = stagingSize;
+			stagingSize += static_cast<VkDeviceSize>(source.metadata.width) * source.metadata.height * source.metadata.channels;
+		}
+
+		//Pack tallest first (the skyline packer wastes least that way), opening a new layer whenever an image doesn't fit in any existing one
+		std::vector<std::uint32_t> packOrder(_count);
+		for (std::uint32_t i{ 0 }; i<_count; ++i) { packOrder[i] = i; }
+		std::stable_sort(packOrder.begin(), packOrder.end(), [&sources](std::uint32_t _a, std::uint32_t _b)
+		{
+			return sources[_a].metadata.height != sources[_b].metadata.height ? sources[_a].metadata.height > sources[_b].metadata.height : sources[_a].metadata.width > sources[_b].metadata.width;
+		});
+		for (const std::uint32_t i : packOrder)
+		{
+			const std::uint32_t width{ static_cast<std::uint32_t>(sources[i].metadata.width) };
+			const std::uint32_t height{ static_cast<std::uint32_t>(sources[i].metadata.height) };
+			std::uint32_t x, y;
+			std::uint32_t layer{ 0 };
+			while (layer < layers.size() && !layers[layer].Pack(width, height, x, y)) { ++layer; }
+			if (layer == layers.size())
+			{
+				if (layers.size() == properties.limits.maxImageArrayLayers)
+				{
+					logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Atlas needs more than the device's " + std::to_string(properties.limits.maxImageArrayLayers) + " array layers - use a larger layer size\n");
+					throw std::runtime_error("");
+				}
+				layers.emplace_back(_layerSize.width, _layerSize.height);
+				static_cast<void>(layers.back().Pack(width, height, x, y)); //Always fits in an empty layer
+			}
+			AtlasRegion& region{ _out_regions[i] };
+			region.layer = layer;
+			region.texelRect = { { static_cast<std::int32_t>(x), static_cast<std::int32_t>(y) }, { width, height } };
+			region.minU = static_cast<float>(x) / static_cast<float>(_layerSize.width);
+			region.minV = static_cast<float>(y) / static_cast<float>(_layerSize.height);
+			region.maxU = static_cast<float>(x + width) / static_cast<float>(_layerSize.width);
+			region.maxV = static_cast<float>(y + height) / static_cast<float>(_layerSize.height);
+		}
+	}
+	catch (...)
+	{
+		closeSources();
+		throw;
+	}
+	float occupancy{ 0.0f };
+	for (const RectanglePacker& layer : layers) { occupancy += layer.GetOccupancy(); }
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Packed " + std::to_string(_count) + " image" + std::string(_count == 1 ? "" : "s") + " into " + std::to_string(layers.size()) + " " + std::to_string(_layerSize.width) + "x" + std::to_string(_layerSize.height) + " layer" + std::string(layers.size() == 1 ? "" : "s") + " (" + std::to_string(static_cast<int>(occupancy * 100.0f / static_cast<float>(layers.size()))) + "% occupancy)\n");
+
+	//Decode every image in parallel into its place in one staging allocation, then copy them all to their regions with one batch
+	ImageHandle atlas;
+	const std::shared_ptr<DecodeBatch> decodeBatch{ std::make_shared<DecodeBatch>() };
+	UploadBatch batch;
+	try
 	{
-		vkFreeMemory(device.GetDevice(), imageMemoryMap[_image], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
-		imageMemoryMap[_image] = VK_NULL_HANDLE;
+		const StagingAllocation staging{ bufferFactory.AllocateStagingMemory(stagingSize, 4) };
+		logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Reserved " + GetFormattedSizeString(stagingSize) + " of staging memory at offset " + std::to_string(staging.offset) + "\n");
+		atlas = AllocateImageImpl(_layerSize, VK_FORMAT_R8G8B8A8_SRGB, _flags, 1, static_cast<std::uint32_t>(layers.size()));
+		imageViewTypes[atlas.index] = VK_IMAGE_VIEW_TYPE_2D_ARRAY; //Even with a single layer so that shaders can always sample it as an array
+
+		std::vector<VkBufferImageCopy> regions(_count);
+		for (std::uint32_t i{ 0 }; i<_count; ++i)
+		{
+			const AtlasSource& source{ sources[i] };
+			regions[i].bufferOffset = source.stagingOffset;
+			regions[i].bufferRowLength = 0;
+			regions[i].bufferImageHeight = 0;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = 0;
+			regions[i].imageSubresource.baseArrayLayer = _out_regions[i].layer;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { _out_regions[i].texelRect.offset.x, _out_regions[i].texelRect.offset.y, 0 };
+			regions[i].imageExtent = { _out_regions[i].texelRect.extent.width, _out_regions[i].texelRect.extent.height, 1 };
+
+			unsigned char* stagingData{ static_cast<unsigned char*>(staging.mappedData) + source.stagingOffset };
+			if (source.cachedTexture.mappedFile.data != nullptr)
+			{
+				const std::size_t imageSize{ static_cast<std::size_t>(source.metadata.width) * source.metadata.height * source.metadata.channels };
+				SubmitDecode(decodeBatch, [pixels = source.cachedTexture.pixels, stagingData, imageSize]() { memcpy(stagingData, pixels, imageSize); }, _filepaths[i]);
+			}
+			else
+			{
+				SubmitDecode(decodeBatch, [this, file = source.file, stagingData, filepath = std::string(_filepaths[i])]() { DecodeImageFile(file, filepath, stagingData); }, _filepaths[i]);
+			}
+		}
+		bufferFactory.AddImageRegionCopies(batch, staging, images[atlas.index], _count, regions.data(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+	catch (...)
+	{
+		WaitForDecodes(*decodeBatch);
+		closeSources();
+		throw;
 	}
-	if (_image != VK_NULL_HANDLE)
+	WaitForDecodes(*decodeBatch);
+	closeSources();
+
+	//As with AllocateImages(), a region whose decode failed is still uploaded (with undefined contents) as its copy is already part of the batch
+	const UploadTicket ticket{ bufferFactory.SubmitUploadBatch(batch) };
+	imageStates[atlas.index].assign(1, ImageState{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
+	if (_out_ticket != nullptr) { *_out_ticket = ticket; }
+	if (decodeBatch->exception != nullptr)
 	{
-		vkDestroyImage(device.GetDevice(), _image, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Failed to decode " + decodeBatch->failedFilepath + "\n");
+		std::rethrow_exception(decodeBatch->exception);
 	}
-	imageMemoryMap.erase(_image);
-	_image = VK_NULL_HANDLE;
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Atlas upload to device local memory submitted\n");
+
+	return atlas;
+}
+
+
+
+void ImageFactory::FreeImageImpl(ImageHandle& _image)
+{
+	//Freeing a null handle is a no-op, but a stale one is a double free
+	if (_image.IsNull()) { return; }
+	const std::uint32_t slot{ GetSlot(_image) };
+	vkDestroyImage(device.GetDevice(), images[slot], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	images[slot] = VK_NULL_HANDLE;
+	memoryPool.Free(imageAllocations[slot]);
+	imageHandles.Free(_image);
+	_image = ImageHandle{};
 }
 
 
 
-VkImageView ImageFactory::CreateImageViewImpl(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags)
+ImageViewHandle ImageFactory::CreateImageViewImpl(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags)
 {
+	//Share an existing view of the same image, format, and aspect (the key's generation stops a view of a freed image matching its slot's new image)
+	const ImageViewKey key{ _image, _format, _aspectFlags };
+	const std::unordered_map<ImageViewKey, ImageViewHandle, ImageViewKeyHash>::const_iterator cachedView{ imageViewCache.find(key) };
+	if (cachedView != imageViewCache.end())
+	{
+		const std::uint32_t referenceCount{ ++imageViewReferenceCounts[cachedView->second.index] };
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Reusing existing image view (" + std::to_string(referenceCount) + " references)\n");
+		return cachedView->second;
+	}
+
 	//Create image view
 	VkImageView imageView;
 	
@@ -407,14 +1139,14 @@ VkImageView ImageFactory::CreateImageViewImpl(const VkImage& _image, const VkFor
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.pNext = nullptr;
 	viewInfo.flags = 0;
-	viewInfo.image = _image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; //Todo: add more image types
+	viewInfo.image = GetImage(_image);
+	viewInfo.viewType = imageViewTypes[GetSlot(_image)]; //Todo: add more image types
 	viewInfo.format = _format;
 	viewInfo.subresourceRange.aspectMask = _aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = imageMipLevels[GetSlot(_image)];
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.layerCount = imageArrayLayers[GetSlot(_image)];
 	viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 	viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 	viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -427,27 +1159,61 @@ VkImageView ImageFactory::CreateImageViewImpl(const VkImage& _image, const VkFor
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
 		throw std::runtime_error("");
 	}
-	imageViewImageMap[imageView] = _image;
 
-	return imageView;
+	const ImageViewHandle handle{ imageViewHandles.Allocate() };
+	if (handle.index >= imageViews.size())
+	{
+		imageViews.resize(imageViewHandles.GetCapacity(), VK_NULL_HANDLE);
+		imageViewKeys.resize(imageViewHandles.GetCapacity());
+		imageViewReferenceCounts.resize(imageViewHandles.GetCapacity(), 0);
+	}
+	imageViews[handle.index] = imageView;
+	imageViewKeys[handle.index] = key;
+	imageViewReferenceCounts[handle.index] = 1;
+	imageViewCache.emplace(key, handle);
+
+	return handle;
 }
 
 
 
-void ImageFactory::FreeImageViewImpl(VkImageView& _imageView)
+void ImageFactory::FreeImageViewImpl(ImageViewHandle& _imageView)
 {
-	if (_imageView != VK_NULL_HANDLE)
+	if (_imageView.IsNull()) { return; }
+	const std::uint32_t slot{ GetSlot(_imageView) };
+	if (--imageViewReferenceCounts[slot] > 0)
 	{
-		vkDestroyImageView(device.GetDevice(), _imageView, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		_imageView = ImageViewHandle{};
+		return;
 	}
-	imageViewImageMap.erase(_imageView);
-	_imageView = VK_NULL_HANDLE;
+	vkDestroyImageView(device.GetDevice(), imageViews[slot], static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+	imageViews[slot] = VK_NULL_HANDLE;
+	imageViewCache.erase(imageViewKeys[slot]);
+	imageViewKeys[slot] = ImageViewKey{};
+	imageViewHandles.Free(_imageView);
+	_imageView = ImageViewHandle{};
 }
 
 
 
 VkSampler ImageFactory::CreateSamplerImpl(const VkSamplerCreateInfo& _createInfo)
 {
+	//Share an existing sampler with an identical create info
+	static_assert(sizeof(VkSamplerCreateInfo) - offsetof(VkSamplerCreateInfo, flags) == sizeof(SamplerKey::fields));
+	SamplerKey key;
+	memcpy(key.fields.data(), &_createInfo.flags, sizeof(SamplerKey::fields));
+	const bool isCached{ _createInfo.pNext == nullptr };
+	if (isCached)
+	{
+		const std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash>::const_iterator cachedSampler{ samplerCache.find(key) };
+		if (cachedSampler != samplerCache.end())
+		{
+			const std::uint32_t referenceCount{ ++samplers[cachedSampler->second].referenceCount };
+			logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Reusing existing sampler (" + std::to_string(referenceCount) + " references)\n");
+			return cachedSampler->second;
+		}
+	}
+
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Creating sampler", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
 	VkSampler sampler;
 	VkResult result{ vkCreateSampler(device.GetDevice(), &_createInfo, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator), &sampler) };
@@ -457,7 +1223,8 @@ VkSampler ImageFactory::CreateSamplerImpl(const VkSamplerCreateInfo& _createInfo
 		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "(" + std::to_string(result) + ")", VK_LOGGER_WIDTH::DEFAULT, false);
 		throw std::runtime_error("");
 	}
-	samplers.push_back(sampler);
+	samplers.emplace(sampler, SamplerEntry{ key, 1, isCached });
+	if (isCached) { samplerCache.emplace(key, sampler); }
 
 	return sampler;
 }
@@ -466,14 +1233,83 @@ VkSampler ImageFactory::CreateSamplerImpl(const VkSamplerCreateInfo& _createInfo
 
 void ImageFactory::FreeSamplerImpl(VkSampler& _sampler)
 {
-	if (_sampler != VK_NULL_HANDLE)
+	if (_sampler == VK_NULL_HANDLE) { return; }
+	const std::unordered_map<VkSampler, SamplerEntry>::iterator entry{ samplers.find(_sampler) };
+	if (entry == samplers.end())
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Sampler wasn't created by this factory or has already been freed\n");
+		throw std::runtime_error("");
+	}
+	if (--entry->second.referenceCount == 0)
 	{
 		vkDestroySampler(device.GetDevice(), _sampler, static_cast<const VkAllocationCallbacks*>(deviceDebugAllocator));
+		if (entry->second.isCached) { samplerCache.erase(entry->second.key); }
+		samplers.erase(entry);
 	}
-	std::erase(samplers, _sampler);
 	_sampler = VK_NULL_HANDLE;
 }
 
 
 
+std::size_t ImageFactory::SamplerKeyHash::operator()(const SamplerKey& _key) const
+{
+	//FNV-1a over the key's words
+	std::uint64_t hash{ 0xCBF29CE484222325ull };
+	for (const std::uint32_t field : _key.fields) { hash = (hash ^ field) * 0x100000001B3ull; }
+	return static_cast<std::size_t>(hash);
+}
+
+
+
+std::size_t ImageFactory::ImageViewKeyHash::operator()(const ImageViewKey& _key) const
+{
+	std::uint64_t hash{ 0xCBF29CE484222325ull };
+	for (const std::uint32_t field : { _key.image.index, _key.image.generation, static_cast<std::uint32_t>(_key.format), static_cast<std::uint32_t>(_key.aspectMask) }) { hash = (hash ^ field) * 0x100000001B3ull; }
+	return static_cast<std::size_t>(hash);
+}
+
+
+
+std::uint32_t ImageFactory::GetSlot(ImageHandle _image) const
+{
+	if (!imageHandles.IsValid(_image))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Stale or null image handle (index: " + std::to_string(_image.index) + ", generation: " + std::to_string(_image.generation) + ")\n");
+		throw std::runtime_error("");
+	}
+	return _image.index;
+}
+
+
+
+std::uint32_t ImageFactory::GetMipmapLevelCount(VkExtent2D _size, VkFormat _format) const
+{
+	//Mip generation downsamples with linear blits, which not every format supports
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(device.GetPhysicalDevice(), _format, &formatProperties);
+	constexpr VkFormatFeatureFlags requiredFeatures{ VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT };
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Image format " + std::to_string(_format) + " doesn't support linear blitting - skipping mipmap generation\n");
+		return 1;
+	}
+
+	//floor(log2(largest dimension)) + 1
+	return static_cast<std::uint32_t>(std::bit_width(std::max(_size.width, _size.height)));
+}
+
+
+
+std::uint32_t ImageFactory::GetSlot(ImageViewHandle _imageView) const
+{
+	if (!imageViewHandles.IsValid(_imageView))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::IMAGE_FACTORY, "  Stale or null image view handle (index: " + std::to_string(_imageView.index) + ", generation: " + std::to_string(_imageView.generation) + ")\n");
+		throw std::runtime_error("");
+	}
+	return _imageView.index;
+}
+
+
+
 }
\ No newline at end of file
@@ -2,14 +2,62 @@
 #define IMAGEFACTORY_H
 #include "BufferFactory.h"
 #include "../../Utils/Loaders/ImageLoader.h"
+#include "../../Utils/Loaders/CompressedImageLoader.h"
+#include "../../Utils/Loaders/AssetPackReader.h"
+#include "../../Utils/Loaders/TextureCache.h"
+#include "../../Utils/Threading/ThreadPool.h"
+#include "../../Utils/Packing/RectanglePacker.h"
 #include "../Core/VulkanCommandPool.h"
 
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
-//Responsible for the initialisation, ownership, and clean shutdown of VkImages and accompanying VkDeviceMemorys, VkImageViews, and VkSamplers
+
+//Responsible for the initialisation, ownership, and clean shutdown of VkImages and their sub-allocations of DeviceMemoryPool memory, VkImageViews, and VkSamplers
 namespace Neki
 {
 
 
+//Handles to images and image views owned by ImageFactory - resolve them with ImageFactory::GetImage() / ImageFactory::GetImageView()
+//Handles to freed resources are detected as stale rather than aliasing whatever resource reuses their slot
+struct ImageHandleTag;
+struct ImageViewHandleTag;
+using ImageHandle = Handle<ImageHandleTag>;
+using ImageViewHandle = Handle<ImageViewHandleTag>;
+
+
+//The layout an image subresource is in along with how it was last accessed - see ImageFactory::RequireImageState()
+struct ImageState
+{
+	VkImageLayout layout;
+	VkAccessFlags accessMask; //Every access since the last barrier (reads are accumulated until the next write)
+	VkPipelineStageFlags stageMask;
+};
+
+
+//Where an image packed by ImageFactory::AllocateAtlas() lives within its atlas
+struct AtlasRegion
+{
+	std::uint32_t layer;
+	VkRect2D texelRect;
+	float minU, minV, maxU, maxV; //texelRect normalised to the atlas's layer size
+};
+
+
+//A set of image barriers recorded with a single vkCmdPipelineBarrier
+//Populate with ImageFactory::RequireImageState() and record with ImageFactory::RecordBarrierBatch()
+struct ImageBarrierBatch
+{
+	std::vector<VkImageMemoryBarrier> barriers;
+	VkPipelineStageFlags srcStageMask{ 0 };
+	VkPipelineStageFlags dstStageMask{ 0 };
+};
+
+
 
 class ImageFactory
 {
@@ -17,8 +65,10 @@ public:
 	explicit ImageFactory(const VKLogger& _logger,
 						  VKDebugAllocator& _deviceDebugAllocator,
 						  const VulkanDevice& _device,
+						  DeviceMemoryPool& _memoryPool,
 						  VulkanCommandPool& _commandPool,
-						  BufferFactory& _bufferFactory);
+						  BufferFactory& _bufferFactory,
+						  const std::string& _textureCacheDirectory="");
 
 	~ImageFactory();
 
@@ -26,55 +76,125 @@ public:
 	//----IMAGES----//
 	
 	//Allocate a single image populated by data from _filepath on a device local heap (passed through a intermediate staging buffer)
+	//.ktx2 and .dds files are uploaded as-is in their block-compressed format with every mip level they contain (see GetFormat()) - anything else is decoded to RGBA8
+	//Decoded pixels are read from the texture cache if it holds an up-to-date entry for _filepath, otherwise the file is decoded and its entry rebuilt
 	//Optionally, pass an ImageData pointer to get metadata about the image
-	[[nodiscard]] VkImage AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata=nullptr);
+	//Optionally, pass an UploadTicket pointer to get the ticket of the upload (see BufferFactory::IsUploadComplete()) - the upload is not waited on
+	//Optionally, set _generateMipmaps=true to build a full mip chain on the GPU after the upload (see GetMipLevels())
+	[[nodiscard]] ImageHandle AllocateImage(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata=nullptr, UploadTicket* _out_ticket=nullptr, bool _generateMipmaps=false);
+
+	//Allocate a single image populated by the cooked entry _name of _pack (see AssetPackReader) on a device local heap
+	//Cooked entries are GPU-ready with their whole mip chain, so their blobs are copied straight from the mapped pack to staging memory with no decoding
+	//_pack only needs to stay open for the duration of the call
+	[[nodiscard]] ImageHandle AllocateImage(const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata=nullptr, UploadTicket* _out_ticket=nullptr);
 
 	//Allocate a single empty image on a device local heap (passed through a intermediate staging buffer)
 	//Note: initial state is UNDEFINED - needs to be transitioned
-	[[nodiscard]] VkImage AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags);
+	[[nodiscard]] ImageHandle AllocateImage(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags);
 
-	//Allocate a vector of _count images populated by data from _filepaths on a device local heap (passed through intermediate staging buffers)
+	//Allocate a vector of _count images populated by data from _filepaths on a device local heap
+	//Files are decoded in parallel on the factory's decode thread pool straight into staging memory (or copied there from the texture cache)
+	//Uploads are submitted in batches of up to half the staging ring so that GPU copies overlap the remaining decodes
 	//Optionally, pass a list of _count ImageDatas to get metadata about the images
-	[[nodiscard]] std::vector<VkImage> AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata=nullptr);
+	//Optionally, pass an UploadTicket pointer to get the ticket of the final batch's upload (reached once every image has been uploaded)
+	[[nodiscard]] std::vector<ImageHandle> AllocateImages(std::uint32_t _count, const char** _filepaths, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata=nullptr, UploadTicket* _out_ticket=nullptr, bool _generateMipmaps=false);
+
+	//Allocate a single image on a device local heap and add the upload of data from _filepath to _batch (see BufferFactory::SubmitUploadBatch())
+	//The image is SHADER_READ_ONLY_OPTIMAL once the batch's upload has completed
+	[[nodiscard]] ImageHandle AddImageUpload(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata=nullptr, bool _generateMipmaps=false);
+
+	//Allocate a vector of _count images populated by the cooked entries _names of _pack on a device local heap (uploaded in batches of up to half the staging ring)
+	//Optionally, pass a list of _count ImageDatas to get metadata about the images
+	//Optionally, pass an UploadTicket pointer to get the ticket of the final batch's upload (reached once every image has been uploaded)
+	[[nodiscard]] std::vector<ImageHandle> AllocateImages(std::uint32_t _count, const AssetPack& _pack, const char** _names, const VkImageUsageFlags* _flags, ImageMetadata* _out_metadata=nullptr, UploadTicket* _out_ticket=nullptr);
+
+	//Allocate a single image on a device local heap and add the upload of the cooked entry _name of _pack to _batch
+	//The image is SHADER_READ_ONLY_OPTIMAL once the batch's upload has completed
+	//Optionally, set _baseMipLevel to leave out the entry's largest levels - the image is then the size of level _baseMipLevel (clamped to the smallest level) and holds the rest of the chain (see TextureStreamer)
+	[[nodiscard]] ImageHandle AddImageUpload(UploadBatch& _batch, const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata=nullptr, std::uint32_t _baseMipLevel=0);
+
+	//Pack _count small images from _filepaths into one 2D array image (an atlas) with layers of _layerSize, adding layers as they fill up
+	//Images are bin-packed tallest first, decoded in parallel straight into a single staging allocation, and uploaded with one batch - so UI, decals, sprites, etc. share one image and one descriptor
+	//Each image's layer and rectangle within it are written to _out_regions (_count long) - sample the atlas through a view from CreateImageView() (always VK_IMAGE_VIEW_TYPE_2D_ARRAY) at (uv, layer)
+	//Texels outside every region are undefined, so keep UVs half a texel inside a region when using linear filtering
+	//Block-compressed files can't be packed, and every image must fit within _layerSize
+	[[nodiscard]] ImageHandle AllocateAtlas(std::uint32_t _count, const char** _filepaths, VkExtent2D _layerSize, const VkImageUsageFlags _flags, AtlasRegion* _out_regions, UploadTicket* _out_ticket=nullptr);
 
 	//Allocate a vector of _count empty images on a device local heap (passed through intermediate staging buffers)
 	//Note: initial state is UNDEFINED - needs to be transitioned
-	[[nodiscard]] std::vector<VkImage> AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags);
+	[[nodiscard]] std::vector<ImageHandle> AllocateImages(std::uint32_t _count, const VkExtent2D* _sizes, const VkFormat* _formats, const VkImageUsageFlags* _flags);
 	
-	//Free a specific image
-	void FreeImage(VkImage& _image);
+	//Free a specific image (_image is reset to a null handle)
+	void FreeImage(ImageHandle& _image);
 
 	//Free a list of _count images
-	void FreeImages(std::uint32_t _count, VkImage* _images);
+	void FreeImages(std::uint32_t _count, ImageHandle* _images);
 
 
-	//Transition an image from one state to another
+	//Transition an image from one state to another (mip level 0 only - prefer RequireImageState(), which works the source state out itself)
 	//Optionally, pass a (already begun) command buffer to this function and the barrier command will be recorded to it but not executed
 	//Leaving _commandBuffer as nullptr will cause the function to allocate its own command buffer and automatically submit it
 	void TransitionImage(VkImageLayout _srcLayout, VkImageLayout _dstLayout,
 						 VkImageAspectFlags _aspectMask,
 						 VkAccessFlags _srcAccessMask, VkAccessFlags _dstAccessMask,
 						 VkPipelineStageFlags _srcStageMask, VkPipelineStageFlags _dstStageMask,
-						 VkImage& _image,
+						 ImageHandle _image,
 						 VkCommandBuffer* _commandBuffer=nullptr);
 
+	//Add the barriers needed for mip levels [_baseMipLevel, _baseMipLevel + _levelCount) of _image to be accessed with _state to _batch, and track _state as their new state
+	//Barriers are only added for levels that need them (a layout change, a hazard involving a write, or reads at new stages/accesses) and only wait on prior writes
+	//Set _discardContents=true to transition from UNDEFINED (e.g.: a render target that is about to be cleared)
+	//Tracking assumes barriers are recorded and executed in the order they were required, and each level must only be required once per batch
+	//Uploaded images start as SHADER_READ_ONLY_OPTIMAL read by the fragment shader, and empty images as UNDEFINED
+	void RequireImageState(ImageBarrierBatch& _batch, ImageHandle _image, const ImageState& _state, std::uint32_t _baseMipLevel=0, std::uint32_t _levelCount=VK_REMAINING_MIP_LEVELS, bool _discardContents=false);
+
+	//Record every barrier in _batch into _commandBuffer with one vkCmdPipelineBarrier (nothing is recorded for an empty batch) and reset _batch
+	void RecordBarrierBatch(ImageBarrierBatch& _batch, VkCommandBuffer _commandBuffer) const;
+
+	//Overwrite the tracked state of mip levels [_baseMipLevel, _baseMipLevel + _levelCount) of _image without adding any barriers
+	//Use after anything ImageFactory can't see changes an image's layout (e.g.: a render pass's final layout)
+	void SetImageState(ImageHandle _image, const ImageState& _state, std::uint32_t _baseMipLevel=0, std::uint32_t _levelCount=VK_REMAINING_MIP_LEVELS);
+
+	//Get the tracked state of _mipLevel of _image (throws if _image is stale)
+	[[nodiscard]] ImageState GetImageState(ImageHandle _image, std::uint32_t _mipLevel=0) const;
+
+	//True if _image refers to an image that hasn't been freed
+	[[nodiscard]] bool IsValid(ImageHandle _image) const;
+
+	//Get the VkImage that _image refers to (throws if _image is stale)
+	[[nodiscard]] VkImage GetImage(ImageHandle _image) const;
+
+	//Get the format _image was created with (throws if _image is stale) - e.g.: to create a view of a block-compressed image
+	[[nodiscard]] VkFormat GetFormat(ImageHandle _image) const;
+
+	//Get the number of mip levels _image was created with (throws if _image is stale)
+	//Image views created with CreateImageView() cover every level - set VkSamplerCreateInfo::maxLod to at least this to sample the whole chain
+	[[nodiscard]] std::uint32_t GetMipLevels(ImageHandle _image) const;
+
 	//--------//
 
 
 	
 	//----IMAGE VIEWS----//
 	
-	//Create a single image view for _image of format _format
-	[[nodiscard]] VkImageView CreateImageView(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags);
+	//Create a single image view for _image of format _format covering every mip level and array layer
+	//Views of the same image, format, and aspect are shared - each call adds a reference to the existing view and returns its handle, and the view is only destroyed once every reference has been freed
+	[[nodiscard]] ImageViewHandle CreateImageView(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _aspectFlags);
 
 	//Create a vector of _count image views for _images of formats _formats
-	[[nodiscard]] std::vector<VkImageView> CreateImageViews(std::uint32_t _count, const VkImage* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags);
+	[[nodiscard]] std::vector<ImageViewHandle> CreateImageViews(std::uint32_t _count, const ImageHandle* _images, const VkFormat* _formats, const VkImageAspectFlags* _aspectFlags);
 	
-	//Free a specific image view
-	void FreeImageView(VkImageView& _imageView);
+	//Free a reference to a specific image view (_imageView is reset to a null handle)
+	void FreeImageView(ImageViewHandle& _imageView);
 
 	//Free a list of _count image views
-	void FreeImageViews(std::uint32_t _count, VkImageView* _imageViews);
+	void FreeImageViews(std::uint32_t _count, ImageViewHandle* _imageViews);
+
+	//True if _imageView refers to an image view that hasn't been freed
+	[[nodiscard]] bool IsValid(ImageViewHandle _imageView) const;
+
+	//Get the VkImageView that _imageView refers to (throws if _imageView is stale)
+	[[nodiscard]] VkImageView GetImageView(ImageViewHandle _imageView) const;
 
 	//--------//
 
@@ -83,12 +203,14 @@ public:
 	//----SAMPLERS----//
 	
 	//Create a single sampler
+	//Samplers with identical create infos are shared (see maxSamplerAllocationCount) - each call adds a reference to the existing sampler, and it's only destroyed once every reference has been freed
+	//Create infos with a pNext chain can't be compared, so they always create a new sampler
 	[[nodiscard]] VkSampler CreateSampler(const VkSamplerCreateInfo& _createInfo);
 
 	//Create a vector of _count samplers
 	[[nodiscard]] std::vector<VkSampler> CreateSamplers(std::uint32_t _count, const VkSamplerCreateInfo* _createInfos);
 	
-	//Free a specific sampler
+	//Free a reference to a specific sampler (_sampler is reset to VK_NULL_HANDLE)
 	void FreeSampler(VkSampler& _sampler);
 
 	//Free a list of _count samplers
@@ -98,26 +220,109 @@ public:
 
 
 private:
-	[[nodiscard]] VkImage AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata);
-	[[nodiscard]] VkImage AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags);
-	void FreeImageImpl(VkImage& _image);
-
-	[[nodiscard]] VkImageView CreateImageViewImpl(const VkImage& _image, const VkFormat& _format, const VkImageAspectFlags& _flags);
-	void FreeImageViewImpl(VkImageView& _imageView);
+	[[nodiscard]] ImageHandle AllocateImageImpl(const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, UploadTicket* _out_ticket, bool _generateMipmaps);
+	[[nodiscard]] ImageHandle AddImageUploadImpl(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps);
+	//Allocate an image for _filepath's decoded pixels (described by _imageMetadata) and the staging memory it's uploaded from, and add the copy to _batch
+	//The pixels must be written to _out_stagingData (see DecodeImageFile()) before _batch is submitted
+	[[nodiscard]] ImageHandle AddImageFileUploadImpl(UploadBatch& _batch, const ImageMetadata& _imageMetadata, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps, void*& _out_stagingData);
+	//Decodes running on decodePool that are waited on together - shared with the tasks so that it outlives any still running if the submitting function throws
+	struct DecodeBatch
+	{
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::uint32_t remainingDecodes{ 0 };
+		std::exception_ptr exception{ nullptr }; //The first failure
+		std::string failedFilepath;
+	};
+	//Run _decode on the decode pool as part of _decodeBatch
+	void SubmitDecode(const std::shared_ptr<DecodeBatch>& _decodeBatch, std::function<void()> _decode, const char* _filepath);
+	static void WaitForDecodes(DecodeBatch& _decodeBatch);
+	//Decode _file into _stagingData and store the pixels in the texture cache - safe to call from decode pool workers
+	void DecodeImageFile(const ImageFile& _file, const std::string& _filepath, void* _stagingData) const;
+	[[nodiscard]] ImageHandle AllocateImageImpl(VkExtent2D _size, VkFormat _format, const VkImageUsageFlags _flags, std::uint32_t _mipLevels=1, std::uint32_t _arrayLayers=1);
+	[[nodiscard]] ImageHandle AllocateAtlasImpl(std::uint32_t _count, const char** _filepaths, VkExtent2D _layerSize, const VkImageUsageFlags _flags, AtlasRegion* _out_regions, UploadTicket* _out_ticket);
+
+	//Allocate an image for the block-compressed file _filepath and add the upload of every mip level stored in it to _batch
+	//_generateMipmaps only produces a warning if the file has a single level - compressed formats can't be blitted
+	[[nodiscard]] ImageHandle AddCompressedImageUploadImpl(UploadBatch& _batch, const char* _filepath, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, bool _generateMipmaps, VkDeviceSize& _out_stagingSize);
+
+	//Allocate an image for the cooked entry _name of _pack and add the upload of its levels from _baseMipLevel onwards to _batch
+	[[nodiscard]] ImageHandle AddPackedImageUploadImpl(UploadBatch& _batch, const AssetPack& _pack, const char* _name, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, std::uint32_t _baseMipLevel, VkDeviceSize& _out_stagingSize);
+
+	//Allocate an image of _format and add the upload of _levelCount GPU-ready levels (byte ranges of _data, largest first) to _batch
+	[[nodiscard]] ImageHandle AddPrebuiltImageUploadImpl(UploadBatch& _batch, const unsigned char* _data, VkFormat _format, std::uint32_t _width, std::uint32_t _height, std::uint32_t _levelCount, const CompressedImageLevel* _levels, const VkImageUsageFlags _flags, ImageMetadata* _out_metadata, VkDeviceSize& _out_stagingSize);
+
+	//Number of levels in a full mip chain for _size, or 1 if _format can't be linearly blitted
+	[[nodiscard]] std::uint32_t GetMipmapLevelCount(VkExtent2D _size, VkFormat _format) const;
+	void FreeImageImpl(ImageHandle& _image);
+
+	[[nodiscard]] ImageViewHandle CreateImageViewImpl(ImageHandle _image, const VkFormat& _format, const VkImageAspectFlags& _flags);
+	void FreeImageViewImpl(ImageViewHandle& _imageView);
+
+	//Get the slot index of a handle, logging an error and throwing if it is stale
+	[[nodiscard]] std::uint32_t GetSlot(ImageHandle _image) const;
+	[[nodiscard]] std::uint32_t GetSlot(ImageViewHandle _imageView) const;
 
 	[[nodiscard]] VkSampler CreateSamplerImpl(const VkSamplerCreateInfo& _createInfo);
 	void FreeSamplerImpl(VkSampler& _sampler);
 
+	//Every field of VkSamplerCreateInfo after pNext - they're all 32 bits wide, so they're compared and hashed as raw words
+	struct SamplerKey
+	{
+		std::array<std::uint32_t, 16> fields;
+		bool operator==(const SamplerKey&) const = default;
+	};
+	struct SamplerKeyHash { std::size_t operator()(const SamplerKey& _key) const; };
+	struct SamplerEntry
+	{
+		SamplerKey key;
+		std::uint32_t referenceCount;
+		bool isCached; //False if the sampler was created from a create info with a pNext chain
+	};
+
+	struct ImageViewKey
+	{
+		ImageHandle image;
+		VkFormat format;
+		VkImageAspectFlags aspectMask;
+		bool operator==(const ImageViewKey&) const = default;
+	};
+	struct ImageViewKeyHash { std::size_t operator()(const ImageViewKey& _key) const; };
+
 	//Dependency injections from VKApp
 	const VKLogger& logger;
 	VKDebugAllocator& deviceDebugAllocator;
 	const VulkanDevice& device;
+	DeviceMemoryPool& memoryPool;
 	BufferFactory& bufferFactory;
 	VulkanCommandPool& commandPool;
 
-	std::unordered_map<VkImage, VkDeviceMemory> imageMemoryMap;
-	std::unordered_map<VkImageView, VkImage> imageViewImageMap;
-	std::vector<VkSampler> samplers;
+	//Per-image data stored contiguously and indexed by ImageHandle::index
+	HandleTable<ImageHandleTag> imageHandles;
+	std::vector<VkImage> images;
+	std::vector<DeviceMemoryAllocation> imageAllocations;
+	std::vector<VkExtent3D> imageExtents;
+	std::vector<VkFormat> imageFormats;
+	std::vector<std::uint32_t> imageMipLevels;
+	std::vector<std::uint32_t> imageArrayLayers;
+	std::vector<VkImageViewType> imageViewTypes; //The type of views created by CreateImageView()
+	std::vector<std::vector<ImageState>> imageStates; //One per mip level
+
+	//Per-image-view data stored contiguously and indexed by ImageViewHandle::index
+	HandleTable<ImageViewHandleTag> imageViewHandles;
+	std::vector<VkImageView> imageViews;
+	std::vector<ImageViewKey> imageViewKeys;
+	std::vector<std::uint32_t> imageViewReferenceCounts;
+	std::unordered_map<ImageViewKey, ImageViewHandle, ImageViewKeyHash> imageViewCache;
+
+	std::unordered_map<VkSampler, SamplerEntry> samplers;
+	std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> samplerCache;
+
+	//Workers that AllocateImages() decodes image files on
+	ThreadPool decodePool;
+
+	//Decoded pixels of previously loaded image files
+	TextureCache textureCache;
 };
 
 
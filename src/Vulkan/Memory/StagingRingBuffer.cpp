@@ -0,0 +1,74 @@
+#include "StagingRingBuffer.h"
+
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+StagingRingBuffer::StagingRingBuffer(VkDeviceSize _size) : size(_size), head(0), tail(0)
+{
+}
+
+
+
+bool StagingRingBuffer::Allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _out_offset)
+{
+	if (_size > size) { return false; }
+	if (_alignment == 0) { _alignment = 1; }
+
+	const VkDeviceSize offset{ head % size };
+	VkDeviceSize alignedOffset{ ((offset + _alignment - 1) / _alignment) * _alignment };
+	std::uint64_t newHead;
+	if (alignedOffset + _size > size)
+	{
+		//Not enough room before the end of the ring - skip the remainder and wrap around to the start
+		alignedOffset = 0;
+		newHead = head + (size - offset) + _size;
+	}
+	else
+	{
+		newHead = head + (alignedOffset - offset) + _size;
+	}
+
+	//Would overrun regions the GPU may still be reading from
+	if (newHead - tail > size) { return false; }
+
+	head = newHead;
+	_out_offset = alignedOffset;
+	return true;
+}
+
+
+
+std::uint64_t StagingRingBuffer::GetHeadMarker() const
+{
+	return head;
+}
+
+
+
+void StagingRingBuffer::Release(std::uint64_t _marker)
+{
+	tail = std::max(tail, std::min(_marker, head));
+}
+
+
+
+VkDeviceSize StagingRingBuffer::GetSize() const
+{
+	return size;
+}
+
+
+
+VkDeviceSize StagingRingBuffer::GetUsedSize() const
+{
+	return head - tail;
+}
+
+
+
+}
\ No newline at end of file
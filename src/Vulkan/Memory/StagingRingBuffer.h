@@ -0,0 +1,48 @@
+#ifndef STAGINGRINGBUFFER_H
+#define STAGINGRINGBUFFER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+//Bookkeeping for a ring of staging memory - regions are allocated at the head and released from the tail once the GPU has finished reading them
+//Does not own any memory itself - BufferFactory owns the persistently mapped VkBuffer this ring hands out offsets into
+namespace Neki
+{
+
+
+
+class StagingRingBuffer
+{
+public:
+	explicit StagingRingBuffer(VkDeviceSize _size);
+
+	~StagingRingBuffer() = default;
+
+	//Reserve _size bytes aligned to _alignment (doesn't need to be a power of 2 - e.g.: 12 for 3-channel image copies)
+	//Returns false if there isn't currently enough free space - release older regions and try again
+	[[nodiscard]] bool Allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _out_offset);
+
+	//Get a marker covering every region allocated so far
+	//Pass it to Release() once the GPU has finished reading from those regions
+	[[nodiscard]] std::uint64_t GetHeadMarker() const;
+
+	//Release every region allocated before _marker was taken
+	void Release(std::uint64_t _marker);
+
+	[[nodiscard]] VkDeviceSize GetSize() const;
+	[[nodiscard]] VkDeviceSize GetUsedSize() const;
+
+
+private:
+	VkDeviceSize size;
+
+	//Monotonically increasing byte counters - the physical offset of a counter is (counter % size)
+	std::uint64_t head;
+	std::uint64_t tail;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
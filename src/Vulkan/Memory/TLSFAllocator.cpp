@@ -0,0 +1,296 @@
+#include "TLSFAllocator.h"
+
+#include <bit>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+TLSFAllocator::TLSFAllocator(VkDeviceSize _size) : size(_size), usedSize(0), allocationCount(0), flBitmap(0)
+{
+	std::fill(std::begin(slBitmaps), std::end(slBitmaps), 0);
+	for (std::uint32_t fl{ 0 }; fl<FL_COUNT; ++fl)
+	{
+		std::fill(std::begin(freeLists[fl]), std::end(freeLists[fl]), INVALID_NODE);
+	}
+
+	//The whole range starts off as a single free node
+	const std::uint32_t root{ CreateNode() };
+	nodes[root].offset = 0;
+	nodes[root].size = _size;
+	InsertFreeNode(root);
+}
+
+
+
+std::uint32_t TLSFAllocator::Allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _out_offset)
+{
+	if (_size == 0) { return INVALID_NODE; }
+	if (_alignment == 0) { _alignment = 1; }
+
+	std::uint32_t node{ FindFreeNode(_size, _alignment) };
+	if (node == INVALID_NODE) { return INVALID_NODE; }
+	RemoveFreeNode(node);
+	nodes[node].isFree = false;
+
+	//Split off the front padding required for alignment as its own free node
+	//The previous physical node is never free (free neighbours are always coalesced), so the padding doesn't need merging
+	const VkDeviceSize alignedOffset{ (nodes[node].offset + _alignment - 1) & ~(_alignment - 1) };
+	const VkDeviceSize padding{ alignedOffset - nodes[node].offset };
+	if (padding > 0)
+	{
+		const std::uint32_t alignedNode{ SplitNode(node, padding) };
+		InsertFreeNode(node);
+		node = alignedNode;
+	}
+
+	//Return the unused tail to the free lists
+	if (nodes[node].size > _size)
+	{
+		InsertFreeNode(SplitNode(node, _size));
+	}
+
+	usedSize += nodes[node].size;
+	++allocationCount;
+	_out_offset = nodes[node].offset;
+	return node;
+}
+
+
+
+void TLSFAllocator::Free(std::uint32_t _node)
+{
+	usedSize -= nodes[_node].size;
+	--allocationCount;
+
+	//Coalesce with free physical neighbours
+	const std::uint32_t next{ nodes[_node].nextPhysical };
+	if (next != INVALID_NODE && nodes[next].isFree)
+	{
+		RemoveFreeNode(next);
+		MergeWithNext(_node);
+	}
+	const std::uint32_t prev{ nodes[_node].prevPhysical };
+	if (prev != INVALID_NODE && nodes[prev].isFree)
+	{
+		RemoveFreeNode(prev);
+		MergeWithNext(prev);
+		_node = prev;
+	}
+
+	InsertFreeNode(_node);
+}
+
+
+
+VkDeviceSize TLSFAllocator::GetSize() const
+{
+	return size;
+}
+
+
+
+VkDeviceSize TLSFAllocator::GetUsedSize() const
+{
+	return usedSize;
+}
+
+
+
+std::size_t TLSFAllocator::GetAllocationCount() const
+{
+	return allocationCount;
+}
+
+
+
+bool TLSFAllocator::IsEmpty() const
+{
+	return allocationCount == 0;
+}
+
+
+
+VkDeviceSize TLSFAllocator::GetLargestFreeRegion() const
+{
+	if (flBitmap == 0) { return 0; }
+
+	//The largest free node lives somewhere in the highest non-empty list
+	const std::uint32_t fl{ static_cast<std::uint32_t>(63 - std::countl_zero(flBitmap)) };
+	const std::uint32_t sl{ static_cast<std::uint32_t>(31 - std::countl_zero(slBitmaps[fl])) };
+	VkDeviceSize largest{ 0 };
+	for (std::uint32_t node{ freeLists[fl][sl] }; node != INVALID_NODE; node = nodes[node].nextFree)
+	{
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+
+
+void TLSFAllocator::Mapping(VkDeviceSize _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl)
+{
+	//Small sizes are binned linearly in the first list
+	if (_size < SL_COUNT)
+	{
+		_out_fl = 0;
+		_out_sl = static_cast<std::uint32_t>(_size);
+		return;
+	}
+
+	const std::uint32_t msb{ static_cast<std::uint32_t>(std::bit_width(_size) - 1) };
+	_out_fl = msb - SL_LOG2 + 1;
+	_out_sl = static_cast<std::uint32_t>(_size >> (msb - SL_LOG2)) - SL_COUNT;
+}
+
+
+
+std::uint32_t TLSFAllocator::FindFreeNode(VkDeviceSize _size, VkDeviceSize _alignment) const
+{
+	//Nodes in _size's own list may or may not be large enough, so check them individually first
+	//This is the only list that can hold a node that fits exactly (e.g.: a range sized for a single allocation)
+	std::uint32_t fl;
+	std::uint32_t sl;
+	Mapping(_size, fl, sl);
+	if (fl >= FL_COUNT) { return INVALID_NODE; }
+	for (std::uint32_t node{ freeLists[fl][sl] }; node != INVALID_NODE; node = nodes[node].nextFree)
+	{
+		const VkDeviceSize alignedOffset{ (nodes[node].offset + _alignment - 1) & ~(_alignment - 1) };
+		if (alignedOffset + _size <= nodes[node].offset + nodes[node].size) { return node; }
+	}
+
+	//Otherwise, search for enough space to be able to align the start of the node in the worst case
+	//Round that up to the next list boundary so that any node in the resulting list is guaranteed to fit
+	VkDeviceSize searchSize{ _size + _alignment - 1 };
+	if (searchSize >= SL_COUNT)
+	{
+		const std::uint32_t msb{ static_cast<std::uint32_t>(std::bit_width(searchSize) - 1) };
+		searchSize += (VkDeviceSize{ 1 } << (msb - SL_LOG2)) - 1;
+	}
+	Mapping(searchSize, fl, sl);
+	if (fl >= FL_COUNT) { return INVALID_NODE; }
+
+	//Look for a non-empty list in this first-level class, otherwise move up to the next non-empty first-level class
+	std::uint32_t slMap{ slBitmaps[fl] & (~0u << sl) };
+	if (slMap == 0)
+	{
+		const std::uint64_t flMap{ fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0 };
+		if (flMap == 0) { return INVALID_NODE; }
+		fl = static_cast<std::uint32_t>(std::countr_zero(flMap));
+		slMap = slBitmaps[fl];
+	}
+	sl = static_cast<std::uint32_t>(std::countr_zero(slMap));
+	return freeLists[fl][sl];
+}
+
+
+
+std::uint32_t TLSFAllocator::CreateNode()
+{
+	std::uint32_t node;
+	if (!releasedNodes.empty())
+	{
+		node = releasedNodes.back();
+		releasedNodes.pop_back();
+	}
+	else
+	{
+		node = static_cast<std::uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+	nodes[node] = Node{ 0, 0, INVALID_NODE, INVALID_NODE, INVALID_NODE, INVALID_NODE, false };
+	return node;
+}
+
+
+
+void TLSFAllocator::ReleaseNode(std::uint32_t _node)
+{
+	releasedNodes.push_back(_node);
+}
+
+
+
+void TLSFAllocator::InsertFreeNode(std::uint32_t _node)
+{
+	std::uint32_t fl;
+	std::uint32_t sl;
+	Mapping(nodes[_node].size, fl, sl);
+
+	nodes[_node].isFree = true;
+	nodes[_node].prevFree = INVALID_NODE;
+	nodes[_node].nextFree = freeLists[fl][sl];
+	if (freeLists[fl][sl] != INVALID_NODE)
+	{
+		nodes[freeLists[fl][sl]].prevFree = _node;
+	}
+	freeLists[fl][sl] = _node;
+
+	flBitmap |= (1ull << fl);
+	slBitmaps[fl] |= (1u << sl);
+}
+
+
+
+void TLSFAllocator::RemoveFreeNode(std::uint32_t _node)
+{
+	std::uint32_t fl;
+	std::uint32_t sl;
+	Mapping(nodes[_node].size, fl, sl);
+
+	const std::uint32_t prev{ nodes[_node].prevFree };
+	const std::uint32_t next{ nodes[_node].nextFree };
+	if (prev != INVALID_NODE) { nodes[prev].nextFree = next; }
+	if (next != INVALID_NODE) { nodes[next].prevFree = prev; }
+	if (freeLists[fl][sl] == _node)
+	{
+		freeLists[fl][sl] = next;
+		if (next == INVALID_NODE)
+		{
+			slBitmaps[fl] &= ~(1u << sl);
+			if (slBitmaps[fl] == 0) { flBitmap &= ~(1ull << fl); }
+		}
+	}
+	nodes[_node].prevFree = INVALID_NODE;
+	nodes[_node].nextFree = INVALID_NODE;
+}
+
+
+
+std::uint32_t TLSFAllocator::SplitNode(std::uint32_t _node, VkDeviceSize _size)
+{
+	//Note: CreateNode() may reallocate the node vector, so no references are held across it
+	const std::uint32_t remainder{ CreateNode() };
+	nodes[remainder].offset = nodes[_node].offset + _size;
+	nodes[remainder].size = nodes[_node].size - _size;
+	nodes[remainder].prevPhysical = _node;
+	nodes[remainder].nextPhysical = nodes[_node].nextPhysical;
+	if (nodes[_node].nextPhysical != INVALID_NODE)
+	{
+		nodes[nodes[_node].nextPhysical].prevPhysical = remainder;
+	}
+	nodes[_node].size = _size;
+	nodes[_node].nextPhysical = remainder;
+	return remainder;
+}
+
+
+
+void TLSFAllocator::MergeWithNext(std::uint32_t _node)
+{
+	const std::uint32_t next{ nodes[_node].nextPhysical };
+	nodes[_node].size += nodes[next].size;
+	nodes[_node].nextPhysical = nodes[next].nextPhysical;
+	if (nodes[next].nextPhysical != INVALID_NODE)
+	{
+		nodes[nodes[next].nextPhysical].prevPhysical = _node;
+	}
+	ReleaseNode(next);
+}
+
+
+
+}
\ No newline at end of file
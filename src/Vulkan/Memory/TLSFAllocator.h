@@ -0,0 +1,95 @@
+#ifndef TLSFALLOCATOR_H
+#define TLSFALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+//Two-Level Segregated Fit allocator for managing offsets within a single range (e.g.: a VkDeviceMemory block)
+//Does not touch any memory itself - it only hands out offsets, so it can be used for both host and device memory
+//Allocation and freeing are O(1) - free regions are binned by size into first-level (power of 2) and second-level (linear subdivision) lists
+namespace Neki
+{
+
+
+
+class TLSFAllocator
+{
+public:
+	explicit TLSFAllocator(VkDeviceSize _size);
+
+	~TLSFAllocator() = default;
+
+	//Allocate a region of _size bytes aligned to _alignment (must be a power of 2)
+	//Returns the id of the allocated node, or INVALID_NODE if there isn't a free region large enough
+	[[nodiscard]] std::uint32_t Allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _out_offset);
+
+	//Free a node previously returned by Allocate(), coalescing it with any free physical neighbours
+	void Free(std::uint32_t _node);
+
+	[[nodiscard]] VkDeviceSize GetSize() const;
+	[[nodiscard]] VkDeviceSize GetUsedSize() const;
+	[[nodiscard]] std::size_t GetAllocationCount() const;
+	[[nodiscard]] bool IsEmpty() const;
+
+	//Size of the largest contiguous free region - used to gauge fragmentation
+	[[nodiscard]] VkDeviceSize GetLargestFreeRegion() const;
+
+	static constexpr std::uint32_t INVALID_NODE{ UINT32_MAX };
+
+
+private:
+	struct Node
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+
+		//Neighbouring nodes in address order
+		std::uint32_t prevPhysical;
+		std::uint32_t nextPhysical;
+
+		//Neighbouring nodes in this node's free list (only valid if isFree)
+		std::uint32_t prevFree;
+		std::uint32_t nextFree;
+
+		bool isFree;
+	};
+
+	static constexpr std::uint32_t SL_LOG2{ 5 };
+	static constexpr std::uint32_t SL_COUNT{ 1u << SL_LOG2 };
+	static constexpr std::uint32_t FL_COUNT{ 64 - SL_LOG2 + 1 };
+
+	//Map a size to its (first-level, second-level) free list indices
+	static void Mapping(VkDeviceSize _size, std::uint32_t& _out_fl, std::uint32_t& _out_sl);
+
+	//Find a free node that can hold _size bytes once its start is aligned to _alignment - returns INVALID_NODE if none exist
+	[[nodiscard]] std::uint32_t FindFreeNode(VkDeviceSize _size, VkDeviceSize _alignment) const;
+
+	[[nodiscard]] std::uint32_t CreateNode();
+	void ReleaseNode(std::uint32_t _node);
+	void InsertFreeNode(std::uint32_t _node);
+	void RemoveFreeNode(std::uint32_t _node);
+
+	//Split _node so that it is exactly _size bytes, returning a new node for the remainder directly after it (not inserted into any free list)
+	[[nodiscard]] std::uint32_t SplitNode(std::uint32_t _node, VkDeviceSize _size);
+
+	//Merge _node with its next physical neighbour (which must be free and not in a free list)
+	void MergeWithNext(std::uint32_t _node);
+
+	VkDeviceSize size;
+	VkDeviceSize usedSize;
+	std::size_t allocationCount;
+
+	std::vector<Node> nodes;
+	std::vector<std::uint32_t> releasedNodes;
+
+	std::uint64_t flBitmap;
+	std::uint32_t slBitmaps[FL_COUNT];
+	std::uint32_t freeLists[FL_COUNT][SL_COUNT];
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "TextureStreamer.h"
+#include "../../Utils/Strings/format.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Neki
+{
+
+
+
+TextureStreamer::TextureStreamer(const VKLogger& _logger, ImageFactory& _imageFactory, BufferFactory& _bufferFactory, const AssetPack& _pack, std::uint32_t _framesInFlight, VkDeviceSize _budget, VkDeviceSize _uploadBytesPerFrame, std::uint32_t _tailSize)
+								: logger(_logger), imageFactory(_imageFactory), bufferFactory(_bufferFactory), pack(_pack), framesInFlight(_framesInFlight), budget(_budget),
+								  uploadBytesPerFrame(_uploadBytesPerFrame), tailSize(_tailSize), frameNumber(0), committedBytes(0)
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::TEXTURE_STREAMER, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::TEXTURE_STREAMER, "Texture Streamer Initialised\n");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  " + GetFormattedSizeString(budget) + " budget, " + GetFormattedSizeString(uploadBytesPerFrame) + " uploaded per frame at most, " + std::to_string(tailSize) + "x" + std::to_string(tailSize) + " mip tails\n");
+}
+
+
+
+TextureStreamer::~TextureStreamer()
+{
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::TEXTURE_STREAMER, "Shutting down TextureStreamer\n");
+	for (std::uint32_t i{ 0 }; i<textureHandles.GetCapacity(); ++i)
+	{
+		StreamedTextureHandle texture{ textureHandles.GetHandle(i) };
+		if (!texture.IsNull()) { Unload(texture); }
+	}
+
+	//The caller waits for the device to go idle before shutting down, so retired images can be freed straight away
+	for (RetiredImage& retired : retiredImages)
+	{
+		imageFactory.FreeImageView(retired.view);
+		imageFactory.FreeImage(retired.image);
+	}
+	retiredImages.clear();
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  All streamed textures freed\n");
+}
+
+
+
+StreamedTextureHandle TextureStreamer::Load(const char* _name, VkImageUsageFlags _flags)
+{
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::TEXTURE_STREAMER, "Loading 1 Streamed Texture\n");
+	const AssetPackEntry* entry{ AssetPackReader::Find(pack, _name) };
+	if (entry == nullptr)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  No entry called " + std::string(_name) + " in asset pack\n");
+		throw std::runtime_error("");
+	}
+
+	//The tail is every level no larger than tailSize in either dimension (or just the smallest level)
+	std::uint32_t tailMipLevel{ 0 };
+	while (tailMipLevel + 1 < entry->levelCount && std::max(entry->width >> tailMipLevel, entry->height >> tailMipLevel) > tailSize) { ++tailMipLevel; }
+
+	const StreamedTextureHandle handle{ textureHandles.Allocate() };
+	if (handle.index >= entries.size())
+	{
+		const std::uint32_t capacity{ textureHandles.GetCapacity() };
+		entries.resize(capacity, nullptr);
+		textureFlags.resize(capacity, 0);
+		tailMipLevels.resize(capacity, 0);
+		currentImages.resize(capacity);
+		currentViews.resize(capacity);
+		currentMipLevels.resize(capacity, 0);
+		pendingImages.resize(capacity);
+		pendingViews.resize(capacity);
+		pendingMipLevels.resize(capacity, 0);
+		pendingTickets.resize(capacity, 0);
+		requestedMipLevels.resize(capacity, UINT32_MAX);
+		lastUsedFrames.resize(capacity, 0);
+	}
+	entries[handle.index] = entry;
+	textureFlags[handle.index] = _flags;
+	tailMipLevels[handle.index] = tailMipLevel;
+	requestedMipLevels[handle.index] = UINT32_MAX;
+	lastUsedFrames[handle.index] = frameNumber;
+
+	//Upload the tail straight away so the texture can be sampled (at low detail) as soon as possible
+	UploadBatch batch;
+	currentImages[handle.index] = imageFactory.AddImageUpload(batch, pack, _name, _flags, nullptr, tailMipLevel);
+	currentViews[handle.index] = imageFactory.CreateImageView(currentImages[handle.index], imageFactory.GetFormat(currentImages[handle.index]), VK_IMAGE_ASPECT_COLOR_BIT);
+	currentMipLevels[handle.index] = tailMipLevel;
+	static_cast<void>(bufferFactory.SubmitUploadBatch(batch));
+	committedBytes += GetLevelBytes(handle.index, tailMipLevel);
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  Streaming " + std::string(_name) + " (" + std::to_string(entry->levelCount) + " mip level" + std::string(entry->levelCount == 1 ? "" : "s") + ", tail of " + GetFormattedSizeString(GetLevelBytes(handle.index, tailMipLevel)) + " from level " + std::to_string(tailMipLevel) + " resident)\n");
+
+	return handle;
+}
+
+
+
+void TextureStreamer::Unload(StreamedTextureHandle& _texture)
+{
+	if (_texture.IsNull()) { return; }
+	const std::uint32_t slot{ GetSlot(_texture) };
+
+	//A pending image is only used by its upload, so it can be freed as soon as that has completed
+	if (!pendingImages[slot].IsNull())
+	{
+		bufferFactory.WaitForUpload(pendingTickets[slot]);
+		imageFactory.FreeImageView(pendingViews[slot]);
+		imageFactory.FreeImage(pendingImages[slot]);
+		committedBytes -= GetLevelBytes(slot, pendingMipLevels[slot]);
+	}
+	else
+	{
+		committedBytes -= GetLevelBytes(slot, currentMipLevels[slot]);
+	}
+	Retire(currentImages[slot], currentViews[slot]);
+	entries[slot] = nullptr;
+	textureHandles.Free(_texture);
+	_texture = StreamedTextureHandle{};
+}
+
+
+
+void TextureStreamer::RequestMipLevel(StreamedTextureHandle _texture, std::uint32_t _mipLevel)
+{
+	const std::uint32_t slot{ GetSlot(_texture) };
+	requestedMipLevels[slot] = std::min(requestedMipLevels[slot], _mipLevel);
+}
+
+
+
+const std::vector<StreamedTextureHandle>& TextureStreamer::Update()
+{
+	++frameNumber;
+	changedTextures.clear();
+
+	//Free images that no frame in flight can still be using
+	std::erase_if(retiredImages, [this](RetiredImage& _retired)
+	{
+		if (_retired.retireFrame + framesInFlight > frameNumber) { return false; }
+		imageFactory.FreeImageView(_retired.view);
+		imageFactory.FreeImage(_retired.image);
+		return true;
+	});
+
+	//Swap in rebuilds whose uploads have completed, and gather this frame's upgrades (most levels missing first)
+	std::vector<std::uint32_t> upgrades;
+	for (std::uint32_t i{ 0 }; i<textureHandles.GetCapacity(); ++i)
+	{
+		const StreamedTextureHandle texture{ textureHandles.GetHandle(i) };
+		if (texture.IsNull()) { continue; }
+		if (!pendingImages[i].IsNull() && bufferFactory.IsUploadComplete(pendingTickets[i]))
+		{
+			Retire(currentImages[i], currentViews[i]);
+			currentImages[i] = pendingImages[i];
+			currentViews[i] = pendingViews[i];
+			currentMipLevels[i] = pendingMipLevels[i];
+			pendingImages[i] = ImageHandle{};
+			pendingViews[i] = ImageViewHandle{};
+			changedTextures.push_back(texture);
+		}
+
+		if (requestedMipLevels[i] == UINT32_MAX) { continue; }
+		lastUsedFrames[i] = frameNumber;
+		requestedMipLevels[i] = std::min(requestedMipLevels[i], tailMipLevels[i]);
+		if (pendingImages[i].IsNull() && requestedMipLevels[i] < currentMipLevels[i]) { upgrades.push_back(i); }
+	}
+	std::sort(upgrades.begin(), upgrades.end(), [this](std::uint32_t _a, std::uint32_t _b) { return currentMipLevels[_a] - requestedMipLevels[_a] > currentMipLevels[_b] - requestedMipLevels[_b]; });
+
+	//Start each upgrade at the most detailed level that fits in what's left of this frame's upload allowance and the budget (after evicting)
+	//Every rebuild this frame shares one batch
+	UploadBatch batch;
+	std::vector<std::uint32_t> rebuiltSlots;
+	VkDeviceSize uploadBytesRemaining{ uploadBytesPerFrame };
+	for (const std::uint32_t slot : upgrades)
+	{
+		const VkDeviceSize currentBytes{ GetLevelBytes(slot, currentMipLevels[slot]) };
+		for (std::uint32_t level{ requestedMipLevels[slot] }; level < currentMipLevels[slot]; ++level)
+		{
+			const VkDeviceSize bytes{ GetLevelBytes(slot, level) };
+			if (bytes > uploadBytesRemaining) { continue; }
+			const VkDeviceSize growth{ bytes - currentBytes };
+			if (committedBytes + growth > budget)
+			{
+				static_cast<void>(Evict(batch, committedBytes + growth - budget, uploadBytesRemaining));
+				if (committedBytes + growth > budget || bytes > uploadBytesRemaining) { continue; }
+			}
+			StartRebuild(batch, slot, level);
+			uploadBytesRemaining -= bytes;
+			break;
+		}
+	}
+	for (std::uint32_t i{ 0 }; i<textureHandles.GetCapacity(); ++i)
+	{
+		if (!pendingImages[i].IsNull() && pendingTickets[i] == 0) { rebuiltSlots.push_back(i); }
+		requestedMipLevels[i] = UINT32_MAX;
+	}
+	if (!batch.imageCopies.empty())
+	{
+		const UploadTicket ticket{ bufferFactory.SubmitUploadBatch(batch) };
+		for (const std::uint32_t slot : rebuiltSlots) { pendingTickets[slot] = ticket; }
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  " + std::to_string(rebuiltSlots.size()) + " texture rebuild" + std::string(rebuiltSlots.size() == 1 ? "" : "s") + " submitted (" + GetFormattedSizeString(committedBytes) + " / " + GetFormattedSizeString(budget) + " committed)\n");
+	}
+
+	return changedTextures;
+}
+
+
+
+VkImageView TextureStreamer::GetImageView(StreamedTextureHandle _texture) const
+{
+	return imageFactory.GetImageView(currentViews[GetSlot(_texture)]);
+}
+
+
+
+std::uint32_t TextureStreamer::GetResidentMipLevel(StreamedTextureHandle _texture) const
+{
+	return currentMipLevels[GetSlot(_texture)];
+}
+
+
+
+VkDeviceSize TextureStreamer::GetCommittedBytes() const
+{
+	return committedBytes;
+}
+
+
+
+std::uint32_t TextureStreamer::GetSlot(StreamedTextureHandle _texture) const
+{
+	if (!textureHandles.IsValid(_texture))
+	{
+		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  Stale or null streamed texture handle (index: " + std::to_string(_texture.index) + ", generation: " + std::to_string(_texture.generation) + ")\n");
+		throw std::runtime_error("");
+	}
+	return _texture.index;
+}
+
+
+
+VkDeviceSize TextureStreamer::GetLevelBytes(std::uint32_t _slot, std::uint32_t _baseMipLevel) const
+{
+	//Cooked levels are GPU-ready, so their blob sizes are what they take up on the device (give or take alignment)
+	const AssetPackEntry& entry{ *entries[_slot] };
+	VkDeviceSize bytes{ 0 };
+	for (std::uint32_t level{ _baseMipLevel }; level < entry.levelCount; ++level) { bytes += pack.levels[entry.firstLevel + level].size; }
+	return bytes;
+}
+
+
+
+void TextureStreamer::StartRebuild(UploadBatch& _batch, std::uint32_t _slot, std::uint32_t _baseMipLevel)
+{
+	//Budgeted as though the swap has already happened - the outgoing image is only counted while it's retired
+	committedBytes += GetLevelBytes(_slot, _baseMipLevel);
+	committedBytes -= GetLevelBytes(_slot, currentMipLevels[_slot]);
+
+	const std::string name{ AssetPackReader::GetName(pack, *entries[_slot]) };
+	pendingImages[_slot] = imageFactory.AddImageUpload(_batch, pack, name.c_str(), textureFlags[_slot], nullptr, _baseMipLevel);
+	pendingViews[_slot] = imageFactory.CreateImageView(pendingImages[_slot], imageFactory.GetFormat(pendingImages[_slot]), VK_IMAGE_ASPECT_COLOR_BIT);
+	pendingMipLevels[_slot] = _baseMipLevel;
+	pendingTickets[_slot] = 0; //Set once the batch is submitted
+}
+
+
+
+VkDeviceSize TextureStreamer::Evict(UploadBatch& _batch, VkDeviceSize _bytes, VkDeviceSize& _uploadBytesRemaining)
+{
+	//Least-recently-used first - textures used this frame, with a rebuild in flight, or down to their tail are left alone
+	std::vector<std::uint32_t> candidates;
+	for (std::uint32_t i{ 0 }; i<textureHandles.GetCapacity(); ++i)
+	{
+		if (textureHandles.GetHandle(i).IsNull() || lastUsedFrames[i] == frameNumber || !pendingImages[i].IsNull() || currentMipLevels[i] >= tailMipLevels[i]) { continue; }
+		candidates.push_back(i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](std::uint32_t _a, std::uint32_t _b) { return lastUsedFrames[_a] < lastUsedFrames[_b]; });
+
+	//Drop each texture's largest levels one at a time until enough has been freed, then rebuild it once without them
+	VkDeviceSize freedBytes{ 0 };
+	for (const std::uint32_t slot : candidates)
+	{
+		if (freedBytes >= _bytes) { break; }
+		const VkDeviceSize currentBytes{ GetLevelBytes(slot, currentMipLevels[slot]) };
+		std::uint32_t level{ currentMipLevels[slot] };
+		do { ++level; } while (level < tailMipLevels[slot] && freedBytes + currentBytes - GetLevelBytes(slot, level) < _bytes);
+		const VkDeviceSize keptBytes{ GetLevelBytes(slot, level) };
+		freedBytes += currentBytes - keptBytes;
+		StartRebuild(_batch, slot, level);
+		_uploadBytesRemaining -= std::min(_uploadBytesRemaining, keptBytes);
+	}
+	if (freedBytes > 0) { logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::TEXTURE_STREAMER, "  Evicted " + GetFormattedSizeString(freedBytes) + " of least-recently-used mip levels\n"); }
+	return freedBytes;
+}
+
+
+
+void TextureStreamer::Retire(ImageHandle& _image, ImageViewHandle& _view)
+{
+	retiredImages.push_back(RetiredImage{ _image, _view, frameNumber });
+	_image = ImageHandle{};
+	_view = ImageViewHandle{};
+}
+
+
+
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include "ImageFactory.h"
+
+//Responsible for keeping the cooked textures of an asset pack resident at the mip levels they're being sampled at, within a device memory budget
+//Each texture's mip tail (its levels no larger than the tail size) is loaded immediately and always stays resident - larger levels are streamed in when requested and evicted least-recently-used first when over budget
+//Without sparse residency a texture's levels live in one VkImage, so changing them swaps the texture to a new image holding the new set of levels (re-uploaded from the mapped pack) once its upload completes
+namespace Neki
+{
+
+
+//Handles to textures owned by TextureStreamer
+struct StreamedTextureHandleTag;
+using StreamedTextureHandle = Handle<StreamedTextureHandleTag>;
+
+
+class TextureStreamer
+{
+public:
+	//_pack must stay open for the lifetime of the streamer
+	//_budget limits the device memory of the levels every texture is (or is becoming) resident at - replaced images linger on top of that for up to _framesInFlight frames
+	//_uploadBytesPerFrame limits how much Update() uploads per call to avoid hitches
+	explicit TextureStreamer(const VKLogger& _logger,
+							 ImageFactory& _imageFactory,
+							 BufferFactory& _bufferFactory,
+							 const AssetPack& _pack,
+							 std::uint32_t _framesInFlight,
+							 VkDeviceSize _budget,
+							 VkDeviceSize _uploadBytesPerFrame=16ull * 1024 * 1024,
+							 std::uint32_t _tailSize=64);
+
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	//Start streaming the cooked entry _name of the pack - its mip tail is uploaded straight away (the upload is not waited on)
+	[[nodiscard]] StreamedTextureHandle Load(const char* _name, VkImageUsageFlags _flags=VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	//Stop streaming _texture (_texture is reset to a null handle) - its images are freed once no frame in flight can be using them
+	void Unload(StreamedTextureHandle& _texture);
+
+	//Mark _texture as used this frame at _mipLevel (0 being full resolution) - e.g.: from a shader-written feedback buffer, or a screen-space size estimate
+	//Call any number of times per frame - the most detailed level requested is kept
+	void RequestMipLevel(StreamedTextureHandle _texture, std::uint32_t _mipLevel);
+
+	//Call once per frame after the frame's fence has signalled (i.e.: after VulkanRenderManager::StartFrame())
+	//Swaps in textures whose uploads have completed, frees retired images, then starts upgrades for this frame's requests (evicting least-recently-used levels to stay within budget)
+	//Returns the textures whose image view changed - any descriptors referencing them must be rewritten before they're next used
+	const std::vector<StreamedTextureHandle>& Update();
+
+	//Get the image view of _texture's currently resident levels (throws if _texture is stale)
+	[[nodiscard]] VkImageView GetImageView(StreamedTextureHandle _texture) const;
+
+	//Get the most detailed resident mip level of _texture (throws if _texture is stale)
+	[[nodiscard]] std::uint32_t GetResidentMipLevel(StreamedTextureHandle _texture) const;
+
+	//Device memory counted against the budget
+	[[nodiscard]] VkDeviceSize GetCommittedBytes() const;
+
+
+private:
+	//An image that has been replaced but may still be in use by a frame in flight
+	struct RetiredImage
+	{
+		ImageHandle image;
+		ImageViewHandle view;
+		std::uint64_t retireFrame;
+	};
+
+	//Get the slot index of a handle, logging an error and throwing if it is stale
+	[[nodiscard]] std::uint32_t GetSlot(StreamedTextureHandle _texture) const;
+
+	//Bytes of _slot's levels from _baseMipLevel onwards
+	[[nodiscard]] VkDeviceSize GetLevelBytes(std::uint32_t _slot, std::uint32_t _baseMipLevel) const;
+
+	//Add the upload of _slot's levels from _baseMipLevel onwards to _batch as its pending image
+	void StartRebuild(UploadBatch& _batch, std::uint32_t _slot, std::uint32_t _baseMipLevel);
+
+	//Drop the largest levels of the least-recently-used textures (not used this frame) until _bytes are freed or nothing more can be evicted - returns the bytes freed
+	//The uploads this causes are taken from _uploadBytesRemaining
+	[[nodiscard]] VkDeviceSize Evict(UploadBatch& _batch, VkDeviceSize _bytes, VkDeviceSize& _uploadBytesRemaining);
+
+	//Free _image and _view once no frame in flight can be using them
+	void Retire(ImageHandle& _image, ImageViewHandle& _view);
+
+	//Dependency injections from VKApp
+	const VKLogger& logger;
+	ImageFactory& imageFactory;
+	BufferFactory& bufferFactory;
+	const AssetPack& pack;
+
+	std::uint32_t framesInFlight;
+	VkDeviceSize budget;
+	VkDeviceSize uploadBytesPerFrame;
+	std::uint32_t tailSize;
+
+	//Per-texture data stored contiguously and indexed by StreamedTextureHandle::index
+	HandleTable<StreamedTextureHandleTag> textureHandles;
+	std::vector<const AssetPackEntry*> entries;
+	std::vector<VkImageUsageFlags> textureFlags;
+	std::vector<std::uint32_t> tailMipLevels; //The first level of the mip tail (never evicted)
+	std::vector<ImageHandle> currentImages;
+	std::vector<ImageViewHandle> currentViews;
+	std::vector<std::uint32_t> currentMipLevels; //The first level held by currentImages
+	std::vector<ImageHandle> pendingImages; //Null if there is no rebuild in flight
+	std::vector<ImageViewHandle> pendingViews;
+	std::vector<std::uint32_t> pendingMipLevels;
+	std::vector<UploadTicket> pendingTickets;
+	std::vector<std::uint32_t> requestedMipLevels; //UINT32_MAX if not requested this frame
+	std::vector<std::uint64_t> lastUsedFrames;
+
+	std::vector<RetiredImage> retiredImages;
+	std::vector<StreamedTextureHandle> changedTextures;
+	std::uint64_t frameNumber;
+	VkDeviceSize committedBytes;
+};
+
+
+
+}
+
+#endif
\ No newline at end of file
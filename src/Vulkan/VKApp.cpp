@@ -3,6 +3,7 @@
 #include <glm/gtx/string_cast.hpp>
 #include <iomanip>
 #include <algorithm>
+#include <array>
 #include <vector>
 #include <cstring>
 #include <string>
@@ -19,25 +20,28 @@ namespace Neki
 VKApp::VKApp(VKAppCreationDescription _creationDescription)
 	: logger(*_creationDescription.loggerConfig), instDebugAllocator(_creationDescription.allocatorType), deviceDebugAllocator(_creationDescription.allocatorType),
 	  vulkanDevice(std::make_unique<VulkanDevice>(logger, instDebugAllocator, deviceDebugAllocator, _creationDescription.apiVer, _creationDescription.appName, _creationDescription.desiredInstanceLayerCount, _creationDescription.desiredInstanceLayers, _creationDescription.desiredInstanceExtensionCount, _creationDescription.desiredInstanceExtensions, _creationDescription.desiredDeviceLayerCount, _creationDescription.desiredDeviceLayers, _creationDescription.desiredDeviceExtensionCount, _creationDescription.desiredDeviceExtensions)),
-	  vulkanCommandPool(std::make_unique<VulkanCommandPool>(logger, deviceDebugAllocator, *vulkanDevice, VK_COMMAND_POOL_TYPE::GRAPHICS)),
+	  vulkanUploadCommandPool(std::make_unique<VulkanCommandPool>(logger, deviceDebugAllocator, *vulkanDevice, VK_COMMAND_POOL_TYPE::GRAPHICS, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)),
+	  vulkanTransferCommandPool(std::make_unique<VulkanCommandPool>(logger, deviceDebugAllocator, *vulkanDevice, VK_COMMAND_POOL_TYPE::TRANSFER, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)),
 	  vulkanDescriptorPool(std::make_unique<VulkanDescriptorPool>(logger, deviceDebugAllocator, *vulkanDevice, _creationDescription.descriptorPoolSizeCount, _creationDescription.descriptorPoolSizes)),
-	  bufferFactory(std::make_unique<BufferFactory>(logger, deviceDebugAllocator, *vulkanDevice, *vulkanCommandPool)),
-	  imageFactory(std::make_unique<ImageFactory>(logger, deviceDebugAllocator, *vulkanDevice, *vulkanCommandPool, *bufferFactory)),
-	  vulkanSwapchain(std::make_unique<VulkanSwapchain>(logger, deviceDebugAllocator, *vulkanDevice, *imageFactory, _creationDescription.windowSize)),
-	  vulkanRenderManager(std::make_unique<VulkanRenderManager>(logger, deviceDebugAllocator, *vulkanDevice, *vulkanSwapchain, *imageFactory, *vulkanCommandPool, 2, _creationDescription.renderPassDesc))
+	  deviceMemoryPool(std::make_unique<DeviceMemoryPool>(logger, deviceDebugAllocator, *vulkanDevice)),
+	  bufferFactory(std::make_unique<BufferFactory>(logger, deviceDebugAllocator, *vulkanDevice, *deviceMemoryPool, *vulkanUploadCommandPool, *vulkanTransferCommandPool)),
+	  imageFactory(std::make_unique<ImageFactory>(logger, deviceDebugAllocator, *vulkanDevice, *deviceMemoryPool, *vulkanUploadCommandPool, *bufferFactory, "Texture Cache")),
+	  vulkanSwapchain(std::make_unique<VulkanSwapchain>(logger, deviceDebugAllocator, *vulkanDevice, *imageFactory, _creationDescription.windowSize, _creationDescription.presentPolicy, _creationDescription.swapchainImageCount)),
+	  vulkanRenderManager(std::make_unique<VulkanRenderManager>(logger, deviceDebugAllocator, *vulkanDevice, *vulkanSwapchain, *imageFactory, 2, _creationDescription.renderPassDesc, _creationDescription.recordingThreadCount)),
+	  frameAllocator(std::make_unique<FrameAllocator>(logger, *vulkanDevice, *bufferFactory, static_cast<std::uint32_t>(vulkanRenderManager->GetFramesInFlight()), 64 * 1024))
 {
-	vertexBuffer = VK_NULL_HANDLE;
-	indexBuffer = VK_NULL_HANDLE;
-	ubo = VK_NULL_HANDLE;
-	image = VK_NULL_HANDLE;
-	imageView = VK_NULL_HANDLE;
 	descriptorSetLayout = VK_NULL_HANDLE;
 	descriptorSet = VK_NULL_HANDLE;
 	postprocessDescriptorSetLayout = VK_NULL_HANDLE;
-	postprocessDescriptorSet = VK_NULL_HANDLE;
 
 	clearValueCount = _creationDescription.clearValueCount;
 	clearValues = _creationDescription.clearValues;
+	memoryOverBudget = false;
+
+	if (vulkanRenderManager->GetRecordingThreadCount() > 1)
+	{
+		recordingThreadPool = std::make_unique<ThreadPool>(vulkanRenderManager->GetRecordingThreadCount() - 1);
+	}
 
 	//Define cube data
 	cubeModelMatrix = glm::mat4(1.0f);
@@ -54,7 +58,7 @@ VKApp::VKApp(VKAppCreationDescription _creationDescription)
 	CreateDescriptorSet();
 	BindDescriptorSet();
 	CreatePostprocessDescriptorSet();
-	BindPostprocessDescriptorSet();
+	for (std::size_t i{ 0 }; i<postprocessDescriptorSets.size(); ++i) { BindPostprocessDescriptorSet(i); }
 	CreatePipeline();
 	CreatePostprocessPipeline();
 }
@@ -66,10 +70,6 @@ VKApp::~VKApp()
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION,"Shutting down VKApp\n");
 
 	vkDeviceWaitIdle(vulkanDevice->GetDevice());
-	
-	//Unmap buffers
-	vkUnmapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(ubo));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  UBO memory unmapped\n");
 }
 
 
@@ -118,30 +118,10 @@ void VKApp::InitialiseCubeVertexBuffer()
 	
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Vertex Buffer\n");
-	vertexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Populating Vertex Buffer\n");
-
-	//Map buffer memory
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Mapping vertex buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), vertexBuffer, &memRequirements);
-	VkResult result{ vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(vertexBuffer), 0, memRequirements.size, 0, &vertexBufferMap) };
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
-	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-		throw std::runtime_error("");
-	}
-	
-	//Write to buffer
-	memcpy(vertexBufferMap, vertices, static_cast<std::size_t>(bufferSize));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Vertex buffer memory filled with quad vertex data\n");
-	vkUnmapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(vertexBuffer));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Vertex buffer memory unmapped\n");
-	
-	//Transfer to device-local buffer
-	vertexBuffer = bufferFactory->TransferToDeviceLocalBuffer(vertexBuffer, true);
+	//Upload through the staging ring into a device-local buffer
+	vertexBuffer = bufferFactory->AllocateDeviceLocalBuffer(vertices, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Vertex buffer upload submitted with cube vertex data\n");
 }
 
 
@@ -167,33 +147,10 @@ void VKApp::InitialiseCubeIndexBuffer()
 	
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Index Buffer\n");
-	indexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Populating Index Buffer\n");
 
-	//Map buffer memory
-	void* indexBufferMap;
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Mapping index buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), indexBuffer, &memRequirements);
-	VkResult result{ vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(indexBuffer), 0, memRequirements.size, 0, &indexBufferMap) };
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
-	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-		throw std::runtime_error("");
-	}
-	
-	//Write to buffer
-	memcpy(indexBufferMap, indices, static_cast<std::size_t>(bufferSize));
-	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Index buffer memory filled with quad index data\n");
-
-	//Unmap memory
-	vkUnmapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(indexBuffer));
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Index buffer memory unmapped\n");
-
-	//Transfer to device-local buffer
-	indexBuffer = bufferFactory->TransferToDeviceLocalBuffer(indexBuffer, true);
+	//Upload through the staging ring into a device-local buffer
+	indexBuffer = bufferFactory->AllocateDeviceLocalBuffer(indices, bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Index buffer upload submitted with cube index data\n");
 }
 
 
@@ -213,20 +170,17 @@ void VKApp::InitialiseQuadVertexBuffer()
 	
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Vertex Buffer\n");
-	quadVertexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	quadVertexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MEMORY_USAGE_INTENT::DYNAMIC, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Populating Vertex Buffer\n");
 
-	//Map buffer memory
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Mapping vertex buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), quadVertexBuffer, &memRequirements);
-	VkResult result{ vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(quadVertexBuffer), 0, memRequirements.size, 0, &quadVertexBufferMap) };
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
+	//Get persistent map of buffer memory
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Retrieving vertex buffer memory map", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	quadVertexBufferMap = bufferFactory->GetMemory(quadVertexBuffer).mappedData;
+	logger.Log(quadVertexBufferMap != nullptr ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, quadVertexBufferMap != nullptr ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (quadVertexBufferMap == nullptr)
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
 		throw std::runtime_error("");
 	}
 	
@@ -249,31 +203,24 @@ void VKApp::InitialiseQuadIndexBuffer()
 	
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Index Buffer\n");
-	quadIndexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	quadIndexBuffer = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MEMORY_USAGE_INTENT::DYNAMIC, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Populating Index Buffer\n");
 
-	//Map buffer memory
+	//Get persistent map of buffer memory
 	void* indexBufferMap;
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Mapping index buffer memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), quadIndexBuffer, &memRequirements);
-	VkResult result{ vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(quadIndexBuffer), 0, memRequirements.size, 0, &indexBufferMap) };
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Retrieving index buffer memory map", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
+	indexBufferMap = bufferFactory->GetMemory(quadIndexBuffer).mappedData;
+	logger.Log(indexBufferMap != nullptr ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, indexBufferMap != nullptr ? "success\n" : "failure\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	if (indexBufferMap == nullptr)
 	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
 		throw std::runtime_error("");
 	}
 	
 	//Write to buffer
 	memcpy(indexBufferMap, indices, static_cast<std::size_t>(bufferSize));
 	logger.Log(VK_LOGGER_CHANNEL::SUCCESS, VK_LOGGER_LAYER::APPLICATION, "  Index buffer memory filled with quad index data\n");
-
-	//Unmap memory
-	vkUnmapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(quadIndexBuffer));
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Index buffer memory unmapped\n");
 }
 
 
@@ -284,29 +231,11 @@ void VKApp::InitialiseUBO()
 	cameraData.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	const float aspectRatio{ static_cast<float>(vulkanSwapchain->GetSwapchainExtent().width) / static_cast<float>(vulkanSwapchain->GetSwapchainExtent().height) };
 	cameraData.proj = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
-	constexpr VkDeviceSize bufferSize{ sizeof(UBOData) };
-	
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating UBO\n");
-	ubo = bufferFactory->AllocateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Populating UBO\n");
-
-	//Map buffer memory
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Mapping UBO memory", VK_LOGGER_WIDTH::SUCCESS_FAILURE);
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), ubo, &memRequirements);
-	VkResult result{ vkMapMemory(vulkanDevice->GetDevice(), bufferFactory->GetMemory(ubo), 0, memRequirements.size, 0, &uboMap) };
-	logger.Log(result == VK_SUCCESS ? VK_LOGGER_CHANNEL::SUCCESS : VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION, result == VK_SUCCESS ? "success\n" : "failure", VK_LOGGER_WIDTH::DEFAULT, false);
-	if (result != VK_SUCCESS)
-	{
-		logger.Log(VK_LOGGER_CHANNEL::ERROR, VK_LOGGER_LAYER::APPLICATION," (" + std::to_string(result) + ")\n", VK_LOGGER_WIDTH::DEFAULT, false);
-		throw std::runtime_error("");
-	}
 
-	//Write to buffer
-	memcpy(uboMap, &cameraData, static_cast<std::size_t>(bufferSize));
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  UBO memory initialised with arbitrary camera data\n");
+	//UBO data lives in the frame allocator and is written fresh each frame (see UpdateUBO())
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Initialising UBO Data\n");
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  UBO data initialised with arbitrary camera data (" + std::to_string(sizeof(UBOData)) + " bytes per frame from the frame allocator)\n");
 }
 
 
@@ -334,7 +263,7 @@ void VKApp::InitialiseSampler()
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE; //Clamped to however many mip levels the bound image view has
 
 	sampler = imageFactory->CreateSampler(samplerInfo);
 }
@@ -346,11 +275,30 @@ void VKApp::InitialiseImage()
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Image\n");
 
+	//The texture is cooked at build time (see the AssetCooker target) with its mip chain, so it's uploaded without any decoding
+	//The default pack is BC3 compressed - fall back to the uncompressed RGBA8 pack on devices that can't sample BC formats
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Creating image\n");
-	image = imageFactory->AllocateImage("Resource Files/garfield.png", VK_IMAGE_USAGE_SAMPLED_BIT);
+	VkFormatProperties bcFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(vulkanDevice->GetPhysicalDevice(), VK_FORMAT_BC3_SRGB_BLOCK, &bcFormatProperties);
+	const bool canSampleBC{ (bcFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0 };
+	if (!canSampleBC)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  BC formats can't be sampled on this device - using the RGBA8 asset pack\n");
+	}
+	AssetPack assetPack{ AssetPackReader::Open(canSampleBC ? "Resource Files/assets.nkpack" : "Resource Files/assets_rgba8.nkpack") };
+	try
+	{
+		image = imageFactory->AllocateImage(assetPack, "garfield.png", VK_IMAGE_USAGE_SAMPLED_BIT);
+	}
+	catch (...)
+	{
+		AssetPackReader::Close(assetPack);
+		throw;
+	}
+	AssetPackReader::Close(assetPack);
 
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Creating image view\n");
-	imageView = imageFactory->CreateImageView(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+	imageView = imageFactory->CreateImageView(image, imageFactory->GetFormat(image), VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
 
@@ -360,11 +308,11 @@ void VKApp::CreateDescriptorSet()
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Creating Descriptor Set\n");
 
-	//Define descriptor binding 0 as a uniform buffer accessible from the fragment shader
-	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Defining UBO binding at binding point 0 accessible to the fragment stage\n");
+	//Define descriptor binding 0 as a dynamic uniform buffer (offset supplied at bind time) accessible from the vertex shader
+	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Defining dynamic UBO binding at binding point 0 accessible to the vertex stage\n");
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -407,12 +355,12 @@ void VKApp::BindDescriptorSet()
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Binding Descriptor Set\n");
 
-	//Bind descriptor set to make descriptor at binding 0 point to VKApp::buffer
+	//Bind descriptor set to make descriptor at binding 0 point to a UBOData-sized window of the frame allocator's buffer (positioned by the dynamic offset at bind time)
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Creating descriptor set write: bind binding point 0 to UBO\n");
 	VkDescriptorBufferInfo bufferInfo{};
-	bufferInfo.buffer = ubo;
+	bufferInfo.buffer = frameAllocator->GetBuffer();
 	bufferInfo.offset = 0;
-	bufferInfo.range = VK_WHOLE_SIZE;
+	bufferInfo.range = sizeof(UBOData);
 	VkWriteDescriptorSet descriptorWriteUBO;
 	descriptorWriteUBO.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWriteUBO.pNext = nullptr;
@@ -420,7 +368,7 @@ void VKApp::BindDescriptorSet()
 	descriptorWriteUBO.dstBinding = 0;
 	descriptorWriteUBO.dstArrayElement = 0;
 	descriptorWriteUBO.descriptorCount = 1;
-	descriptorWriteUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorWriteUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descriptorWriteUBO.pBufferInfo = &bufferInfo;
 	descriptorWriteUBO.pTexelBufferView = nullptr;
 	descriptorWriteUBO.pImageInfo = nullptr;
@@ -428,7 +376,7 @@ void VKApp::BindDescriptorSet()
 	//Bind descriptor set to make descriptor at binding 1 point to image view and sampler
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Creating descriptor set write: bind binding point 1 to image view and sampler\n");
 	VkDescriptorImageInfo imageSamplerInfo{};
-	imageSamplerInfo.imageView = imageView;
+	imageSamplerInfo.imageView = imageFactory->GetImageView(imageView);
 	imageSamplerInfo.sampler = sampler;
 	imageSamplerInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	VkWriteDescriptorSet descriptorWriteImageSampler;
@@ -480,15 +428,17 @@ void VKApp::CreatePostprocessDescriptorSet()
 		throw std::runtime_error("");
 	}
 
-	postprocessDescriptorSet = vulkanDescriptorPool->AllocateDescriptorSet(postprocessDescriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> layouts(vulkanRenderManager->GetFramesInFlight(), postprocessDescriptorSetLayout);
+	postprocessDescriptorSets = vulkanDescriptorPool->AllocateDescriptorSets(layouts.size(), layouts.data());
+	postprocessDescriptorSetGenerations.resize(postprocessDescriptorSets.size());
 }
 
 
 
-void VKApp::BindPostprocessDescriptorSet()
+void VKApp::BindPostprocessDescriptorSet(std::size_t _frameIndex)
 {
 	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "\n\n\n", VK_LOGGER_WIDTH::DEFAULT, false);
-	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Binding Postprocess Descriptor Set\n");
+	logger.Log(VK_LOGGER_CHANNEL::HEADING, VK_LOGGER_LAYER::APPLICATION, "Binding Postprocess Descriptor Set " + std::to_string(_frameIndex) + "\n");
 	
 	VkDescriptorImageInfo postprocessImageInfo{};
 	postprocessImageInfo.imageView = vulkanRenderManager->GetFramebufferImageView(1);
@@ -497,7 +447,7 @@ void VKApp::BindPostprocessDescriptorSet()
 	VkWriteDescriptorSet descriptorWriteImageSampler;
 	descriptorWriteImageSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWriteImageSampler.pNext = nullptr;
-	descriptorWriteImageSampler.dstSet = postprocessDescriptorSet;
+	descriptorWriteImageSampler.dstSet = postprocessDescriptorSets[_frameIndex];
 	descriptorWriteImageSampler.dstBinding = 0;
 	descriptorWriteImageSampler.dstArrayElement = 0;
 	descriptorWriteImageSampler.descriptorCount = 1;
@@ -508,6 +458,7 @@ void VKApp::BindPostprocessDescriptorSet()
 	
 	logger.Log(VK_LOGGER_CHANNEL::INFO, VK_LOGGER_LAYER::APPLICATION, "  Updating descriptor set\n");
 	vkUpdateDescriptorSets(vulkanDevice->GetDevice(), 1, &descriptorWriteImageSampler, 0, nullptr);
+	postprocessDescriptorSetGenerations[_frameIndex] = vulkanRenderManager->GetAttachmentGeneration();
 }
 
 
@@ -593,68 +544,149 @@ void VKApp::CreatePostprocessPipeline()
 
 
 
-void VKApp::UpdateUBO(PlayerCamera& _playerCamera)
+std::uint32_t VKApp::UpdateUBO(PlayerCamera& _playerCamera)
 {
 	cameraData.view = _playerCamera.GetViewMatrix();
 	cameraData.proj = _playerCamera.GetProjectionMatrix();
 
-	//Write to buffer
-	memcpy(uboMap, &cameraData, sizeof(UBOData));
+	//Write to this frame's region - frames still in flight keep reading their own copy
+	return frameAllocator->Push(cameraData).offset;
+}
+
+
+
+std::string VKApp::GetMemoryStatsJSON() const
+{
+	return deviceMemoryPool->GetStatsJSON();
+}
+
+
+
+void VKApp::CheckMemoryBudget()
+{
+	//Warn when a heap first goes over budget (before the driver starts paging it out) rather than every frame it stays there
+	const bool overBudget{ deviceMemoryPool->GetStats().overBudget };
+	if (overBudget && !memoryOverBudget)
+	{
+		logger.Log(VK_LOGGER_CHANNEL::WARNING, VK_LOGGER_LAYER::APPLICATION, "Device memory is over budget: " + GetMemoryStatsJSON() + "\n");
+	}
+	memoryOverBudget = overBudget;
 }
 
 
 
 void VKApp::DrawFrame(PlayerCamera& _playerCamera)
 {
+	//Compact buffer memory a few MiB at a time - must happen before any buffer handles are resolved for this frame
+	bufferFactory->DefragmentBuffers();
+	CheckMemoryBudget();
 
-	vulkanRenderManager->StartFrame(clearValueCount, clearValues);
+	if (!vulkanRenderManager->StartFrame(clearValueCount, clearValues, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS))
+	{
+		//Nothing to render to (i.e.: the window is minimised)
+		return;
+	}
 
-	UpdateUBO(_playerCamera);
-	
-	vkCmdBindPipeline(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipeline());
-	constexpr VkDeviceSize zeroOffset{ 0 };
-	vkCmdBindVertexBuffers(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &vertexBuffer, &zeroOffset);
-	vkCmdBindIndexBuffer(vulkanRenderManager->GetCurrentCommandBuffer(), indexBuffer, zeroOffset, VK_INDEX_TYPE_UINT16);
-	vkCmdBindDescriptorSets(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
+	//The framebuffer attachments have been recreated since this frame's postprocess set was written - StartFrame() has waited on this frame's fence, so it's no longer in use
+	const std::size_t frameIndex{ vulkanRenderManager->GetCurrentFrame() };
+	if (postprocessDescriptorSetGenerations[frameIndex] != vulkanRenderManager->GetAttachmentGeneration())
+	{
+		BindPostprocessDescriptorSet(frameIndex);
+	}
+
+	//StartFrame() has waited on this frame's fence, so its region of the frame allocator is free to be overwritten
+	frameAllocator->BeginFrame(static_cast<std::uint32_t>(frameIndex));
+	const std::uint32_t uboOffset{ UpdateUBO(_playerCamera) };
 
-	//Update cube data
+	//Update cube data - each model matrix builds on the last, so this stays on the main thread
 	float speed{ 50.0f };
+	std::array<glm::mat4, 2> drawModelMatrices;
 	cubeModelMatrix = glm::translate(cubeModelMatrix, glm::vec3(-3, 0, 0));
 	cubeModelMatrix = glm::rotate(cubeModelMatrix, glm::radians(speed * static_cast<float>(TimeManager::dt)), glm::vec3(1,0,0));
-	vkCmdPushConstants(vulkanRenderManager->GetCurrentCommandBuffer(), vulkanGraphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &cubeModelMatrix);
-	
-	//Define viewport
+	drawModelMatrices[0] = cubeModelMatrix;
+	cubeModelMatrix = glm::translate(cubeModelMatrix, glm::vec3(3, 0, 0));
+	drawModelMatrices[1] = cubeModelMatrix;
+
+	//Resolve everything the recording threads need up front so they only ever read shared state
+	constexpr VkDeviceSize zeroOffset{ 0 };
+	const VkBuffer cubeVertexBuffer{ bufferFactory->GetBuffer(vertexBuffer) };
+	const VkBuffer cubeIndexBuffer{ bufferFactory->GetBuffer(indexBuffer) };
+	const VkExtent2D extent{ vulkanSwapchain->GetSwapchainExtent() };
+
+	//Record the first pass's draws in parallel - each recording thread gets a contiguous range of draws in its own secondary command buffer
+	//The secondary command buffers are executed in thread order, so draw order is unchanged
+	const std::uint32_t drawCount{ static_cast<std::uint32_t>(drawModelMatrices.size()) };
+	const std::uint32_t threadCount{ std::min(drawCount, vulkanRenderManager->GetRecordingThreadCount()) };
+	std::vector<VkCommandBuffer> secondaryCommandBuffers(threadCount);
+	const auto recordDraws{ [&](std::uint32_t _threadIndex)
+	{
+		const VkCommandBuffer commandBuffer{ vulkanRenderManager->BeginSecondaryCommandBuffer(_threadIndex) };
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipeline());
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &cubeVertexBuffer, &zeroOffset);
+		vkCmdBindIndexBuffer(commandBuffer, cubeIndexBuffer, zeroOffset, VK_INDEX_TYPE_UINT16);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanGraphicsPipeline->GetPipelineLayout(), 0, 1, &descriptorSet, 1, &uboOffset);
+
+		//Dynamic state isn't inherited from the primary command buffer
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = {0,0};
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		//Draw the damn cubes
+		const std::uint32_t firstDraw{ drawCount * _threadIndex / threadCount };
+		const std::uint32_t lastDraw{ drawCount * (_threadIndex + 1) / threadCount };
+		for (std::uint32_t i{ firstDraw }; i<lastDraw; ++i)
+		{
+			vkCmdPushConstants(commandBuffer, vulkanGraphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &drawModelMatrices[i]);
+			vkCmdDrawIndexed(commandBuffer, 36, 1, 0, 0, 0);
+		}
+
+		vulkanRenderManager->EndSecondaryCommandBuffer(commandBuffer);
+		secondaryCommandBuffers[_threadIndex] = commandBuffer;
+	} };
+	if (recordingThreadPool)
+	{
+		recordingThreadPool->RunAndWait(threadCount, recordDraws);
+	}
+	else
+	{
+		for (std::uint32_t i{ 0 }; i<threadCount; ++i) { recordDraws(i); }
+	}
+	vulkanRenderManager->ExecuteSecondaryCommandBuffers(threadCount, secondaryCommandBuffers.data());
+
+
+	//Draw the second pass
+	vulkanRenderManager->NextSubpass();
+	vkCmdBindPipeline(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPostprocessPipeline->GetPipeline());
+
+	//The first pass's viewport and scissor were set in the secondary command buffers, so don't carry over to here
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(vulkanSwapchain->GetSwapchainExtent().width);
-	viewport.height = static_cast<float>(vulkanSwapchain->GetSwapchainExtent().height);
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &viewport);
 
-	//Define scissor
 	VkRect2D scissor{};
 	scissor.offset = {0,0};
-	scissor.extent = vulkanSwapchain->GetSwapchainExtent();
+	scissor.extent = extent;
 	vkCmdSetScissor(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &scissor);
-	
-	//Draw the damn cube
-	vkCmdDrawIndexed(vulkanRenderManager->GetCurrentCommandBuffer(), 36, 1, 0, 0, 0);
 
-	cubeModelMatrix = glm::translate(cubeModelMatrix, glm::vec3(3, 0, 0));
-	vkCmdPushConstants(vulkanRenderManager->GetCurrentCommandBuffer(), vulkanGraphicsPipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &cubeModelMatrix);
-	
-	//Draw the damn cube
-	vkCmdDrawIndexed(vulkanRenderManager->GetCurrentCommandBuffer(), 36, 1, 0, 0, 0);
-
-
-	//Draw the second pass
-	vkCmdNextSubpass(vulkanRenderManager->GetCurrentCommandBuffer(), VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPostprocessPipeline->GetPipeline());
-	vkCmdBindDescriptorSets(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPostprocessPipeline->GetPipelineLayout(), 0, 1, &postprocessDescriptorSet, 0, nullptr);
-	vkCmdBindVertexBuffers(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &quadVertexBuffer, &zeroOffset);
-	vkCmdBindIndexBuffer(vulkanRenderManager->GetCurrentCommandBuffer(), quadIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+	vkCmdBindDescriptorSets(vulkanRenderManager->GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanPostprocessPipeline->GetPipelineLayout(), 0, 1, &postprocessDescriptorSets[frameIndex], 0, nullptr);
+	const VkBuffer postprocessVertexBuffer{ bufferFactory->GetBuffer(quadVertexBuffer) };
+	vkCmdBindVertexBuffers(vulkanRenderManager->GetCurrentCommandBuffer(), 0, 1, &postprocessVertexBuffer, &zeroOffset);
+	vkCmdBindIndexBuffer(vulkanRenderManager->GetCurrentCommandBuffer(), bufferFactory->GetBuffer(quadIndexBuffer), 0, VK_INDEX_TYPE_UINT16);
 	vkCmdDrawIndexed(vulkanRenderManager->GetCurrentCommandBuffer(), 6, 1, 0, 0, 0);
 	
 	
@@ -18,8 +18,11 @@
 #include "Debug/VKLogger.h"
 #include "Debug/VKLoggerConfig.h"
 #include "Debug/VKDebugAllocator.h"
+#include "Memory/DeviceMemoryPool.h"
 #include "Memory/BufferFactory.h"
 #include "Memory/ImageFactory.h"
+#include "Memory/FrameAllocator.h"
+#include "../Utils/Threading/ThreadPool.h"
 
 namespace Neki
 {
@@ -50,6 +53,11 @@ struct GraphicsPipelineShaderFilepaths
 struct VKAppCreationDescription
 {
 	VkExtent2D windowSize;
+	PRESENT_POLICY presentPolicy;
+	std::uint32_t swapchainImageCount; //0 for one more than the surface's minimum
+	double targetFrameRate; //0 for unlimited
+	bool reduceLatency; //See FramePacer
+	std::uint32_t recordingThreadCount; //Threads (including the main thread) that record draws into secondary command buffers - 0 for one per hardware thread
 	VKRenderPassCleanDesc renderPassDesc;
 	GraphicsPipelineShaderFilepaths* subpassPipelines;
 	std::uint32_t clearValueCount;
@@ -88,12 +96,16 @@ private:
 
 	//Sub-classes
 	std::unique_ptr<VulkanDevice> vulkanDevice;
-	std::unique_ptr<VulkanCommandPool> vulkanCommandPool;
+	std::unique_ptr<VulkanCommandPool> vulkanUploadCommandPool; //One-shot upload command buffers only - per-frame command buffers come from VulkanRenderManager's own pools
+	std::unique_ptr<VulkanCommandPool> vulkanTransferCommandPool;
 	std::unique_ptr<VulkanDescriptorPool> vulkanDescriptorPool;
+	std::unique_ptr<DeviceMemoryPool> deviceMemoryPool;
 	std::unique_ptr<BufferFactory> bufferFactory;
 	std::unique_ptr<ImageFactory> imageFactory;
 	std::unique_ptr<VulkanSwapchain> vulkanSwapchain;
 	std::unique_ptr<VulkanRenderManager> vulkanRenderManager;
+	std::unique_ptr<FrameAllocator> frameAllocator;
+	std::unique_ptr<ThreadPool> recordingThreadPool; //Null if recording is single-threaded - the main thread records alongside the workers
 	std::unique_ptr<VulkanGraphicsPipeline> vulkanGraphicsPipeline;
 	std::unique_ptr<VulkanGraphicsPipeline> vulkanPostprocessPipeline;
 
@@ -108,38 +120,42 @@ private:
 	void CreateDescriptorSet();
 	void BindDescriptorSet();
 	void CreatePostprocessDescriptorSet();
-	void BindPostprocessDescriptorSet();
+	void BindPostprocessDescriptorSet(std::size_t _frameIndex);
 	void CreatePipeline();
 	void CreatePostprocessPipeline();
 
 	//Per-frame functions
-	void UpdateUBO(PlayerCamera& _playerCamera);
+	[[nodiscard]] std::uint32_t UpdateUBO(PlayerCamera& _playerCamera); //Returns the dynamic offset of this frame's UBO data
 	void DrawFrame(PlayerCamera& _playerCamera);
 
+	//Device memory statistics (see DeviceMemoryPool::GetStatsJSON()) - cheap enough to export every frame
+	[[nodiscard]] std::string GetMemoryStatsJSON() const;
+	void CheckMemoryBudget();
+
 	std::uint32_t clearValueCount;
 	VkClearValue* clearValues;
 	
 	//Raw vulkan resources
-	VkBuffer vertexBuffer;
-	VkBuffer indexBuffer;
-	VkBuffer quadVertexBuffer;
-	VkBuffer quadIndexBuffer;
-	VkBuffer ubo;
+	BufferHandle vertexBuffer;
+	BufferHandle indexBuffer;
+	BufferHandle quadVertexBuffer;
+	BufferHandle quadIndexBuffer;
 	VkSampler sampler;
-	VkImage image;
-	VkImageView imageView;
+	ImageHandle image;
+	ImageViewHandle imageView;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout postprocessDescriptorSetLayout;
-	VkDescriptorSet postprocessDescriptorSet;
+	std::vector<VkDescriptorSet> postprocessDescriptorSets; //One per frame in flight so a frame's set can be rewritten after a resize while other frames are still reading theirs
+	std::vector<std::uint64_t> postprocessDescriptorSetGenerations; //The render manager's attachment generation each set was last written with
 
 	//Persistent buffer maps
-	void* vertexBufferMap;
 	void* quadVertexBufferMap;
-	void* uboMap;
 
 	glm::mat4 cubeModelMatrix;
 	UBOData cameraData;
+
+	bool memoryOverBudget; //Whether any heap was over budget last frame - used to only warn when a heap goes over budget rather than every frame
 };
 
 }